@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "char_bitset.h"
+
+#if defined(__GNUC__)
+	#define char_bitset_ctz(w)      __builtin_ctzll(w)
+	#define char_bitset_popcount(w) __builtin_popcountll(w)
+#else
+static int char_bitset_ctz(uint64_t w)
+{
+	int n = 0;
+	while(!(w & 1)) {
+		w >>= 1;
+		n++;
+	}
+
+	return n;
+}
+
+static int char_bitset_popcount(uint64_t w)
+{
+	int n = 0;
+	for(; w != 0; w &= w - 1)
+		n++;
+
+	return n;
+}
+#endif
+
+void char_bitset_clear(char_bitset_t* set)
+{
+	memset(set->words, 0, sizeof(set->words));
+}
+
+void char_bitset_add_range(char_bitset_t* set, unsigned char start,
+	                       unsigned char end)
+{
+	unsigned int ch;
+
+	for(ch = start; ch <= end; ch++)
+		CHAR_BITSET_ADD(set, ch);
+}
+
+void char_bitset_union(char_bitset_t* dest, const char_bitset_t* src)
+{
+	size_t i;
+
+	for(i = 0; i < CHAR_BITSET_WORDS; i++)
+		dest->words[i] |= src->words[i];
+}
+
+void char_bitset_complement(char_bitset_t* dest, const char_bitset_t* src)
+{
+	size_t i;
+
+	for(i = 0; i < CHAR_BITSET_WORDS; i++)
+		dest->words[i] = ~src->words[i];
+}
+
+int char_bitset_count(const char_bitset_t* set)
+{
+	size_t i;
+	int count = 0;
+
+	for(i = 0; i < CHAR_BITSET_WORDS; i++)
+		count += char_bitset_popcount(set->words[i]);
+
+	return count;
+}
+
+int char_bitset_word_ctz(uint64_t word)
+{
+	return char_bitset_ctz(word);
+}
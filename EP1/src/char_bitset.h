@@ -0,0 +1,32 @@
+#ifndef TR_CHAR_BITSET_H
+#define TR_CHAR_BITSET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+
+#define CHAR_BITSET_WORDS ((UCHAR_MAX + 1) / 64)
+
+// Membership set over all byte values, one bit per character.
+typedef struct {
+	uint64_t words[CHAR_BITSET_WORDS];
+} char_bitset_t;
+
+#define CHAR_BITSET_TEST(set, ch) \
+	(((set)->words[(unsigned char)(ch) >> 6] >> ((unsigned char)(ch) & 63)) & 1)
+
+#define CHAR_BITSET_ADD(set, ch) \
+	((set)->words[(unsigned char)(ch) >> 6] |= \
+		(uint64_t)1 << ((unsigned char)(ch) & 63))
+
+void char_bitset_clear(char_bitset_t* set);
+void char_bitset_add_range(char_bitset_t* set, unsigned char start,
+	                       unsigned char end);
+void char_bitset_union(char_bitset_t* dest, const char_bitset_t* src);
+void char_bitset_complement(char_bitset_t* dest, const char_bitset_t* src);
+int char_bitset_count(const char_bitset_t* set);
+
+// Index of the lowest set bit of a non-zero bitset word.
+int char_bitset_word_ctz(uint64_t word);
+
+#endif // #ifndef TR_CHAR_BITSET_H
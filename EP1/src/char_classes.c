@@ -2,8 +2,11 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <locale.h>
+#include <stdlib.h>
 
 #include "utils.h"
+#include "strutils.h"
 #include "char_classes.h"
 
 #if (__STDC_VERSION__ < 199901L)
@@ -81,4 +84,39 @@ int char_class_check(int c, char_class_t char_class) {
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
+const char_bitset_t* char_class_members(char_class_t char_class)
+{
+	static char_bitset_t class_members[CC_XDIGIT + 1];
+	static char *class_members_locale = NULL;
+
+	const char *locale;
+
+	if(char_class == CC_INVALID || char_class > CC_XDIGIT)
+		return NULL;
+
+	locale = setlocale(LC_CTYPE, NULL);
+	if(locale == NULL)
+		locale = "";
+
+	if(class_members_locale == NULL
+	   || strcmp(class_members_locale, locale) != 0)
+	{
+		unsigned int c;
+		int cc;
+
+		free(class_members_locale);
+		class_members_locale = tr_strndup(locale, strlen(locale));
+
+		for(cc = CC_ALNUM; cc <= CC_XDIGIT; cc++) {
+			char_bitset_clear(&class_members[cc]);
+
+			for(c = 0; c <= UCHAR_MAX; c++) {
+				if(char_class_check(c, (char_class_t)cc))
+					CHAR_BITSET_ADD(&class_members[cc], c);
+			}
+		}
+	}
+
+	return &class_members[char_class];
+}
@@ -1,6 +1,8 @@
 #ifndef TR_CHAR_CLASSES_H
 #define TR_CHAR_CLASSES_H
 
+#include "char_bitset.h"
+
 #if (__STDC_VERSION__ < 199901L)
 
 int tr_isblank(int c);
@@ -21,4 +23,8 @@ typedef enum {
 char_class_t char_class_get(const char* class_name);
 int char_class_check(int c, char_class_t char_class);
 
+// Returns the set of all characters belonging to a class in the current
+// locale. The sets are built once and only rebuilt if LC_CTYPE changes.
+const char_bitset_t* char_class_members(char_class_t char_class);
+
 #endif // #ifndef TR_CHAR_CLASSES_H
\ No newline at end of file
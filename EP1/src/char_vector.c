@@ -13,6 +13,7 @@ char_vector_t* char_vector_new(size_t initial_size) {
 	vec->len = 0;
 	vec->size = 0;
 	vec->vector = NULL;
+	char_bitset_clear(&vec->members);
 
 	if(initial_size) {
 		if(!char_vector_expand(vec, initial_size)) {
@@ -29,6 +30,8 @@ size_t char_vector_append_char(char_vector_t* dest, const char ch) {
 }
 
 size_t char_vector_append(char_vector_t* dest, const char* src, size_t len) {
+	size_t i;
+
 	if(dest == NULL || src == NULL || !len)
 		return 0;
 
@@ -38,9 +41,53 @@ size_t char_vector_append(char_vector_t* dest, const char* src, size_t len) {
 	memcpy(dest->vector + dest->len, src, len);
 	dest->len += len;
 
+	for(i = 0; i < len; i++)
+		CHAR_BITSET_ADD(&dest->members, src[i]);
+
 	return len;
 }
 
+// Appends all members of the set in ascending order.
+size_t char_vector_append_bitset(char_vector_t* dest, const char_bitset_t* set)
+{
+	size_t i, count;
+
+	if(dest == NULL || set == NULL)
+		return 0;
+
+	count = char_bitset_count(set);
+	if(!count || !char_vector_expand(dest, dest->len + count))
+		return 0;
+
+	for(i = 0; i < CHAR_BITSET_WORDS; i++) {
+		uint64_t w;
+
+		// visit the set bits from the lowest to the highest
+		for(w = set->words[i]; w != 0; w &= w - 1) {
+			dest->vector[dest->len++] = (char)(i * 64 + char_bitset_word_ctz(w));
+		}
+	}
+
+	char_bitset_union(&dest->members, set);
+	return count;
+}
+
+void char_vector_truncate(char_vector_t* vec, size_t len)
+{
+	size_t i;
+
+	if(vec == NULL || len >= vec->len)
+		return;
+
+	vec->len = len;
+
+	// Characters may repeat in the vector, so the membership set has to be
+	// recomputed from what's left.
+	char_bitset_clear(&vec->members);
+	for(i = 0; i < len; i++)
+		CHAR_BITSET_ADD(&vec->members, vec->vector[i]);
+}
+
 int char_vector_expand(char_vector_t* vec, size_t desired_size) {
 	char *new_vec;
 	size_t new_size;
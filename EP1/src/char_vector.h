@@ -1,15 +1,25 @@
 #ifndef TR_CHAR_VECTOR_H
 #define TR_CHAR_VECTOR_H
 
+#include <stddef.h>
+
+#include "char_bitset.h"
+
 typedef struct {
 	char* vector;
 	size_t len;
 	size_t size;
+
+	// Every character present in vector[0..len), kept up to date by the
+	// functions that add characters to the vector.
+	char_bitset_t members;
 } char_vector_t;
 
 char_vector_t* char_vector_new(size_t initial_size);
 size_t char_vector_append(char_vector_t* dest, const char* src, size_t len);
 size_t char_vector_append_char(char_vector_t* dest, const char ch);
+size_t char_vector_append_bitset(char_vector_t* dest, const char_bitset_t* set);
+void char_vector_truncate(char_vector_t* vec, size_t len);
 int char_vector_expand(char_vector_t* vec, size_t desired_size);
 void char_vector_free(char_vector_t* vec);
 #endif //#ifndef TR_CHAR_VECTOR_H
\ No newline at end of file
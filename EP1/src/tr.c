@@ -12,6 +12,10 @@
 #include "char_vector.h"
 #include "tr_parser.h"
 #include "tr_funcs.h"
+#include "tr_process.h"
+#include "tr_pipeline.h"
+#include "tr_buffer_pool.h"
+#include "tr_io.h"
 #include "tr.h"
 
 // ========================================================================= //
@@ -20,7 +24,18 @@ static int opt_translate      = 0,
            opt_delete         = 0,
 	       opt_complement     = 0,
 	       opt_squeeze        = 0,
-		   opt_truncate_set1  = 0;
+		   opt_truncate_set1  = 0,
+		   opt_decompress     = 0,
+		   opt_compress       = 0,
+		   opt_buffer_info    = 0;
+
+// ========================================================================= //
+
+#define TR_IO_BUFFER_SIZE (2 * 1024 * 1024)
+
+// Terminals and pipes hand over at most a pipe's worth of input per read, so
+// plain streams from them don't need huge buffers.
+#define TR_STREAM_BUFFER_SIZE (64 * 1024)
 
 // ========================================================================= //
 
@@ -30,14 +45,6 @@ void print_usage(void);
 void print_version(void);
 void print_help(void);
 
-void tr_process_squeeze(const char_vector_t* set1,
-	                    int complement);
-void tr_process_delete(const char_vector_t* set1, const char_vector_t* set2,
-	                   int complement, int squeeze);
-void tr_process_translate(const char_vector_t* set1, const char_vector_t* set2,
-	                      int complement, int squeeze);
-
-// ========================================================================= //
 
 #define TR_VERSION_STRING "1.0"
 #define TR_AUTHOR         "Daniel Miranda"
@@ -71,6 +78,11 @@ writing to standard output.\n\
                             that is listed in SET1 with a single occurrence\n\
                             of that character\n\
   -t, --truncate-set1     first truncate SET1 to length of SET2\n\
+  -z, --gzip              same as --decompress --compress\n\
+      --decompress        read gzip-compressed input\n\
+      --compress          write gzip-compressed output\n\
+      --buffer-info       report the I/O buffers used, and whether they\n\
+                            are backed by huge pages, on standard error\n\
   --help                  show this help and exit\n\
   --version               show version and exit\n\
 "); p("\
@@ -132,76 +144,6 @@ p(TR_AUTHOR "\n");
 
 // ========================================================================= //
 
-void tr_process_translate(const char_vector_t* set1, const char_vector_t* set2,
-	                      int complement, int squeeze)
-{
-	int c, last = INVALID_CHAR;
-
-	if(set1 == NULL || set2 == NULL)
-		return;
-
-	while((c = getchar()) != EOF) {
-		c = tr_char_translate(c, set1, set2, complement);
-			
-		if(squeeze 
-		   && tr_char_find_in_set(c, set2, NULL)
-		   && last != INVALID_CHAR
-		   && last == c)
-		{
-			continue;
-		}
-
-		putchar(c);
-		last = c;
-	}
-}
-
-void tr_process_delete(const char_vector_t* set1, const char_vector_t* set2,
-	                   int complement, int squeeze)
-{
-	int c, last = INVALID_CHAR;
-
-	if(set1 == NULL || (squeeze && set2 == NULL))
-		return;
-
-	while((c = getchar()) != EOF) {
-		if(tr_char_find_in_set(c, set1, NULL) == (!complement ? 1 : 0))
-			continue;
-
-		if(squeeze
-		   && tr_char_find_in_set(c, set2, NULL)
-		   && last != INVALID_CHAR
-		   && last == c)
-		{
-			continue;
-		}
-	
-		putchar(c);
-		last = c;
-	}
-}
-
-void tr_process_squeeze(const char_vector_t* set1, int complement) {
-	int c, last = INVALID_CHAR;
-
-	if(set1 == NULL)
-		return;
-
-	while((c = getchar()) != EOF) {
-		if(tr_char_find_in_set(c, set1, NULL) == (!complement ? 1 : 0)
-		   && last != INVALID_CHAR
-		   && last == c)
-		{
-			continue;
-		}
-	
-		putchar(c);
-		last = c;
-	}
-}
-
-// ========================================================================= //
-
 void tr_fatal_error(const char* err_fmt, ...)
 {
 	va_list ap;
@@ -221,7 +163,11 @@ void tr_fatal_error(const char* err_fmt, ...)
 void get_options(int argc, char** argv, int *option_index)
 {
 	while(1) {
-		enum { GETOPT_HELP_VALUE = -2, GETOPT_VERSION_VALUE = -3 };
+		enum {
+			GETOPT_HELP_VALUE = -2, GETOPT_VERSION_VALUE = -3,
+			GETOPT_DECOMPRESS_VALUE = -4, GETOPT_COMPRESS_VALUE = -5,
+			GETOPT_BUFFER_INFO_VALUE = -6
+		};
 		
 		static struct option long_options[] = {
 			{"squeeze",         no_argument, NULL, 's'},
@@ -229,12 +175,16 @@ void get_options(int argc, char** argv, int *option_index)
 			{"delete",          no_argument, NULL, 'd'},
 			{"complement",      no_argument, NULL, 'c'},
 			{"truncate-set1",   no_argument, NULL, 't'},
+			{"gzip",            no_argument, NULL, 'z'},
+			{"decompress",      no_argument, NULL, GETOPT_DECOMPRESS_VALUE},
+			{"compress",        no_argument, NULL, GETOPT_COMPRESS_VALUE},
+			{"buffer-info",     no_argument, NULL, GETOPT_BUFFER_INFO_VALUE},
 			{"help",            no_argument, NULL, GETOPT_HELP_VALUE},
 			{"version",         no_argument, NULL, GETOPT_VERSION_VALUE},
 			{0, 0, 0, 0}
 		};
 
-		int c = getopt_long(argc, argv, "cCdst", long_options, NULL);
+		int c = getopt_long(argc, argv, "cCdstz", long_options, NULL);
 
 		if(c == -1)
 			break;
@@ -256,6 +206,23 @@ void get_options(int argc, char** argv, int *option_index)
 		case 't':
 			opt_truncate_set1 = 1;
 
+			break;
+		case 'z':
+			opt_decompress = 1;
+			opt_compress = 1;
+
+			break;
+		case GETOPT_DECOMPRESS_VALUE:
+			opt_decompress = 1;
+
+			break;
+		case GETOPT_COMPRESS_VALUE:
+			opt_compress = 1;
+
+			break;
+		case GETOPT_BUFFER_INFO_VALUE:
+			opt_buffer_info = 1;
+
 			break;
 		case GETOPT_HELP_VALUE:
 			print_help();
@@ -283,12 +250,15 @@ int main(int argc, char** argv)
 {
 	int last_option_index = 0,
 	    remaining_args = 0,
-	    set2_necessary = 0;
+	    set2_necessary = 0,
+	    ok;
 
 	const char* string1, *string2;
 	char_vector_t *set1 = NULL,
 		          *set2 = NULL;
 	tr_parser_error_t parser_error = {0, NULL, NULL, 0};
+	tr_process_state_t state;
+	tr_buffer_pool_t buffer_pool;
 
 	//	
 
@@ -353,7 +323,7 @@ int main(int argc, char** argv)
 		}
 
 		if(opt_truncate_set1) {
-			set1->len = set2->len;
+			char_vector_truncate(set1, set2->len);
 
 		} else if(set2->len < set1->len) {
 			char set2_last_char = set2->vector[set2->len - 1];
@@ -388,15 +358,40 @@ int main(int argc, char** argv)
 		}
 	}
 
-	// Set stdin to full buffering of 512 characters.
-	setvbuf(stdin, NULL, _IOFBF, 512);
-	
 	if(opt_translate) {
-		tr_process_translate(set1, set2, opt_complement, opt_squeeze);
+		tr_process_state_init(&state, TR_MODE_TRANSLATE, set1, set2,
+		                      opt_complement, opt_squeeze);
 	} else if(opt_delete) {
-		tr_process_delete(set1, set2, opt_complement, opt_squeeze);
+		tr_process_state_init(&state, TR_MODE_DELETE, set1, set2,
+		                      opt_complement, opt_squeeze);
 	} else { // squeeze only
-		tr_process_squeeze(set1, opt_complement);
+		tr_process_state_init(&state, TR_MODE_SQUEEZE, set1, set2,
+		                      opt_complement, opt_squeeze);
+	}
+
+	if(!opt_decompress && !opt_compress && tr_io_is_interactive(stdin))
+		tr_buffer_pool_init(&buffer_pool, TR_STREAM_BUFFER_SIZE);
+	else
+		tr_buffer_pool_init(&buffer_pool, TR_IO_BUFFER_SIZE);
+
+	if(opt_decompress || opt_compress) {
+#ifdef TR_WITH_ZLIB
+		ok = tr_pipeline_run(&state, &buffer_pool, stdin, stdout,
+		                     opt_decompress, opt_compress);
+#else
+		tr_fatal_error("compression support was not compiled in\n");
+#endif
+	} else {
+		ok = tr_process_stream(&state, &buffer_pool, stdin, stdout);
+	}
+
+	if(opt_buffer_info)
+		tr_buffer_pool_report(&buffer_pool, stderr);
+
+	tr_buffer_pool_destroy(&buffer_pool);
+
+	if(!ok || fflush(stdout) != 0) {
+		tr_fatal_error("error processing input\n");
 	}
 
 	return 0;
@@ -0,0 +1,209 @@
+#if defined(__linux__)
+	#define _GNU_SOURCE
+	#include <sys/mman.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "xmalloc.h"
+#include "tr_buffer_pool.h"
+
+// ========================================================================= //
+
+#define TR_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+// ========================================================================= //
+
+#if defined(__linux__)
+
+// Looks up the mapping containing `addr` in /proc/self/smaps and checks
+// whether any of it is backed by transparent huge pages.
+static int tr_buffer_pool_has_thp(const void* addr)
+{
+	FILE *smaps = fopen("/proc/self/smaps", "r");
+	char line[256];
+	int in_mapping = 0, found = 0;
+
+	if(smaps == NULL)
+		return 0;
+
+	while(fgets(line, sizeof(line), smaps) != NULL) {
+		unsigned long start, end, huge_kb;
+
+		if(sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+			in_mapping = (uintptr_t)addr >= start && (uintptr_t)addr < end;
+		} else if(in_mapping
+		          && sscanf(line, "AnonHugePages: %lu kB", &huge_kb) == 1)
+		{
+			found = huge_kb > 0;
+			break;
+		}
+	}
+
+	fclose(smaps);
+	return found;
+}
+
+static int tr_buffer_pool_map(tr_pool_block_t* block, size_t size)
+{
+	char *map, *aligned;
+	size_t map_size;
+
+#ifdef MAP_HUGETLB
+	// Explicit huge pages only succeed if the administrator reserved some.
+	map = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE,
+	                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(map != MAP_FAILED) {
+		block->data = map;
+		block->map_size = size;
+		block->pages = TR_PAGES_EXPLICIT_HUGE;
+		return 1;
+	}
+#endif
+
+	// Over-allocate so the buffer can start at a huge page boundary, then
+	// give the unaligned head and the tail back.
+	map_size = size + TR_HUGE_PAGE_SIZE;
+	map = (char*)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+	                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(map == MAP_FAILED)
+		return 0;
+
+	aligned = (char*)(((uintptr_t)map + TR_HUGE_PAGE_SIZE - 1)
+	                  & ~(uintptr_t)(TR_HUGE_PAGE_SIZE - 1));
+
+	if(aligned > map)
+		munmap(map, aligned - map);
+	if(aligned + size < map + map_size)
+		munmap(aligned + size, (map + map_size) - (aligned + size));
+
+	block->data = aligned;
+	block->map_size = size;
+	block->pages = TR_PAGES_NORMAL;
+
+#ifdef MADV_HUGEPAGE
+	if(madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+		// Fault the first page in so the kernel has a chance to back it with
+		// a huge page before we check.
+		aligned[0] = 0;
+
+		if(tr_buffer_pool_has_thp(aligned))
+			block->pages = TR_PAGES_TRANSPARENT_HUGE;
+	}
+#endif
+
+	return 1;
+}
+
+#endif // #if defined(__linux__)
+
+// ========================================================================= //
+
+void tr_buffer_pool_init(tr_buffer_pool_t* pool, size_t buffer_size)
+{
+	// Buffers smaller than a huge page stay as they are, without huge pages.
+	if(buffer_size >= TR_HUGE_PAGE_SIZE) {
+		pool->buffer_size = (buffer_size + TR_HUGE_PAGE_SIZE - 1)
+		                    & ~(TR_HUGE_PAGE_SIZE - 1);
+	} else {
+		pool->buffer_size = buffer_size;
+	}
+
+	pool->blocks = NULL;
+	pool->block_count = 0;
+	pool->block_capacity = 0;
+	pool->free_list = NULL;
+	pool->free_count = 0;
+}
+
+void tr_buffer_pool_destroy(tr_buffer_pool_t* pool)
+{
+	size_t i;
+
+	for(i = 0; i < pool->block_count; i++) {
+		tr_pool_block_t *block = &pool->blocks[i];
+
+#if defined(__linux__)
+		if(block->map_size != 0) {
+			munmap(block->data, block->map_size);
+			continue;
+		}
+#endif
+		free(block->data);
+	}
+
+	free(pool->blocks);
+	free(pool->free_list);
+
+	pool->blocks = NULL;
+	pool->free_list = NULL;
+	pool->block_count = pool->block_capacity = pool->free_count = 0;
+}
+
+char* tr_buffer_pool_get(tr_buffer_pool_t* pool)
+{
+	tr_pool_block_t block;
+
+	if(pool->free_count > 0)
+		return pool->free_list[--pool->free_count];
+
+	block.data = NULL;
+	block.map_size = 0;
+	block.pages = TR_PAGES_NORMAL;
+
+#if defined(__linux__)
+	if(pool->buffer_size >= TR_HUGE_PAGE_SIZE)
+		tr_buffer_pool_map(&block, pool->buffer_size);
+#endif
+
+	if(block.data == NULL)
+		block.data = (char*)xmalloc(pool->buffer_size);
+
+	if(pool->block_count == pool->block_capacity) {
+		size_t capacity = pool->block_capacity ? pool->block_capacity * 2 : 8;
+
+		pool->blocks = (tr_pool_block_t*)realloc(pool->blocks,
+		                                 capacity * sizeof(*pool->blocks));
+		pool->free_list = (char**)realloc(pool->free_list,
+		                                  capacity * sizeof(*pool->free_list));
+		if(pool->blocks == NULL || pool->free_list == NULL) {
+			fprintf(stderr, "memory allocation error\n");
+			exit(1);
+		}
+
+		pool->block_capacity = capacity;
+	}
+
+	pool->blocks[pool->block_count++] = block;
+	return block.data;
+}
+
+void tr_buffer_pool_put(tr_buffer_pool_t* pool, char* buffer)
+{
+	// The free list has room for every block the pool ever handed out.
+	if(buffer != NULL)
+		pool->free_list[pool->free_count++] = buffer;
+}
+
+void tr_buffer_pool_report(const tr_buffer_pool_t* pool, FILE* out)
+{
+	size_t i, explicit_count = 0, transparent_count = 0;
+
+	for(i = 0; i < pool->block_count; i++) {
+		if(pool->blocks[i].pages == TR_PAGES_EXPLICIT_HUGE)
+			explicit_count++;
+		else if(pool->blocks[i].pages == TR_PAGES_TRANSPARENT_HUGE)
+			transparent_count++;
+	}
+
+	fprintf(out, "tr: %lu I/O buffers of %lu KiB, huge pages: %lu explicit, "
+	             "%lu transparent, %lu without\n",
+	        (unsigned long)pool->block_count,
+	        (unsigned long)(pool->buffer_size / 1024),
+	        (unsigned long)explicit_count, (unsigned long)transparent_count,
+	        (unsigned long)(pool->block_count - explicit_count
+	                        - transparent_count));
+}
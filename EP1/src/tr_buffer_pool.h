@@ -0,0 +1,46 @@
+#ifndef TR_TR_BUFFER_POOL_H
+#define TR_TR_BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+	TR_PAGES_NORMAL = 0,
+	TR_PAGES_TRANSPARENT_HUGE,
+	TR_PAGES_EXPLICIT_HUGE
+} tr_page_kind_t;
+
+typedef struct {
+	char* data;
+	size_t map_size;	// 0 if the block came from malloc()
+	tr_page_kind_t pages;
+} tr_pool_block_t;
+
+// Pool of equally sized I/O buffers. Buffers are allocated on demand,
+// preferably backed by huge pages, and are kept around when put back so the
+// next request reuses them instead of going back to the kernel. The pool is
+// not thread-safe: get and put buffers from a single thread.
+typedef struct {
+	size_t buffer_size;
+
+	tr_pool_block_t* blocks;
+	size_t block_count;
+	size_t block_capacity;
+
+	char** free_list;
+	size_t free_count;
+} tr_buffer_pool_t;
+
+// Buffer sizes of at least a huge page are rounded up to a multiple of the
+// huge page size. Smaller buffers are plain malloc()'d memory.
+void tr_buffer_pool_init(tr_buffer_pool_t* pool, size_t buffer_size);
+void tr_buffer_pool_destroy(tr_buffer_pool_t* pool);
+
+char* tr_buffer_pool_get(tr_buffer_pool_t* pool);
+void tr_buffer_pool_put(tr_buffer_pool_t* pool, char* buffer);
+
+// Writes a one-line summary of the buffers allocated and of how many were
+// actually backed by huge pages.
+void tr_buffer_pool_report(const tr_buffer_pool_t* pool, FILE* out);
+
+#endif // #ifndef TR_TR_BUFFER_POOL_H
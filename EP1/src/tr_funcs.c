@@ -18,20 +18,16 @@
 
 int tr_char_class_expand(char_class_t char_class, char_vector_t* out)
 {
-	unsigned int ch;
-	size_t i = 0;
+	const char_bitset_t* members;
 
 	if(char_class == CC_INVALID || out == NULL)
 		return 0;
-	
-	for(ch = 0; ch <= UCHAR_MAX; ch++) {
-		if(char_class_check(ch, char_class)) {
-			char_vector_append_char(out, ch);
-			i++;
-		}
-	}
 
-	return i;
+	members = char_class_members(char_class);
+	if(members == NULL)
+		return 0;
+
+	return char_vector_append_bitset(out, members);
 }
 
 int tr_char_equiv_expand(char ch, char_vector_t* out)
@@ -58,6 +54,7 @@ int tr_char_range_expand(unsigned char start, unsigned char end,
 		out->vector[out->len++] = (start + i);
 	}
 
+	char_bitset_add_range(&out->members, start, end);
 	return i;
 }
 
@@ -70,6 +67,7 @@ int tr_char_repeat_expand(char ch, size_t count, char_vector_t* out) {
 
 	memset(out->vector + out->len, ch, count);
 	out->len += count;
+	CHAR_BITSET_ADD(&out->members, ch);
 
 	return count;
 }
@@ -94,6 +92,7 @@ int tr_char_indef_repeat_expand(char ch, size_t target_len, size_t start_index,
 
 	memset(out->vector + start_index, ch, count); 
 	out->len += count;
+	CHAR_BITSET_ADD(&out->members, ch);
 
 	return count;
 }
@@ -119,6 +118,13 @@ int tr_char_find_in_set(char ch, const char_vector_t* set, size_t *idx) {
 	if(set == NULL)
 		return 0;
 
+	// The membership set answers negative lookups, and positive ones when
+	// the position is not wanted, without scanning the vector.
+	if(!CHAR_BITSET_TEST(&set->members, ch))
+		return 0;
+	else if(idx == NULL)
+		return 1;
+
 	for(i = 0; i < set->len; i++) {
 		if(ch == set->vector[i]) {
 			if(idx != NULL)
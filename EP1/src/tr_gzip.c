@@ -0,0 +1,175 @@
+#ifdef TR_WITH_ZLIB
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xmalloc.h"
+#include "tr_io.h"
+#include "tr_gzip.h"
+
+// ========================================================================= //
+
+#define TR_GZ_CHUNK_SIZE (64 * 1024)
+
+// 15 bits of window, plus 32 to accept both gzip and zlib headers when
+// decoding, or plus 16 to emit a gzip header when encoding.
+#define TR_GZ_WINDOW_BITS_DECODE (15 + 32)
+#define TR_GZ_WINDOW_BITS_ENCODE (15 + 16)
+
+// ========================================================================= //
+
+int tr_gz_reader_init(tr_gz_reader_t* reader, FILE* file)
+{
+	memset(&reader->zs, 0, sizeof(reader->zs));
+
+	reader->file = file;
+	reader->eof = 0;
+	reader->error = 0;
+	reader->in_buffer = (unsigned char*)xmalloc(TR_GZ_CHUNK_SIZE);
+
+	if(inflateInit2(&reader->zs, TR_GZ_WINDOW_BITS_DECODE) != Z_OK) {
+		free(reader->in_buffer);
+		reader->in_buffer = NULL;
+		return 0;
+	}
+
+	return 1;
+}
+
+size_t tr_gz_read(tr_gz_reader_t* reader, char* buffer, size_t size)
+{
+	z_stream *zs = &reader->zs;
+
+	if(reader->error)
+		return 0;
+
+	zs->next_out = (unsigned char*)buffer;
+	zs->avail_out = size;
+
+	while(zs->avail_out > 0) {
+		int ret;
+
+		if(zs->avail_in == 0) {
+			// Hand back what was decoded so far rather than wait for more
+			// input to fill the buffer.
+			if(reader->eof || zs->avail_out < size)
+				break;
+
+			zs->next_in = reader->in_buffer;
+			zs->avail_in = tr_io_read(reader->file, (char*)reader->in_buffer,
+			                          TR_GZ_CHUNK_SIZE, &reader->error);
+
+			if(zs->avail_in == 0) {
+				reader->eof = 1;
+				break;
+			}
+		}
+
+		ret = inflate(zs, Z_NO_FLUSH);
+		if(ret == Z_STREAM_END) {
+			// Another gzip member may follow: start over with the remaining
+			// input.
+			if(inflateReset(zs) != Z_OK) {
+				reader->error = 1;
+				break;
+			}
+		} else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+			reader->error = 1;
+			break;
+		}
+	}
+
+	return size - zs->avail_out;
+}
+
+void tr_gz_reader_end(tr_gz_reader_t* reader)
+{
+	// Data left inside the decoder at EOF means the last member was cut
+	// short.
+	if(reader->eof && !reader->error && reader->zs.total_in != 0)
+		reader->error = 1;
+
+	inflateEnd(&reader->zs);
+
+	free(reader->in_buffer);
+	reader->in_buffer = NULL;
+}
+
+// ========================================================================= //
+
+int tr_gz_writer_init(tr_gz_writer_t* writer, FILE* file, int level)
+{
+	memset(&writer->zs, 0, sizeof(writer->zs));
+
+	writer->file = file;
+	writer->error = 0;
+	writer->out_buffer = (unsigned char*)xmalloc(TR_GZ_CHUNK_SIZE);
+
+	if(deflateInit2(&writer->zs, level, Z_DEFLATED, TR_GZ_WINDOW_BITS_ENCODE,
+	                8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		free(writer->out_buffer);
+		writer->out_buffer = NULL;
+		return 0;
+	}
+
+	return 1;
+}
+
+static int tr_gz_deflate(tr_gz_writer_t* writer, int flush)
+{
+	z_stream *zs = &writer->zs;
+	int ret;
+
+	do {
+		size_t len;
+
+		zs->next_out = writer->out_buffer;
+		zs->avail_out = TR_GZ_CHUNK_SIZE;
+
+		ret = deflate(zs, flush);
+		if(ret == Z_STREAM_ERROR) {
+			writer->error = 1;
+			return 0;
+		}
+
+		len = TR_GZ_CHUNK_SIZE - zs->avail_out;
+		if(fwrite(writer->out_buffer, 1, len, writer->file) != len) {
+			writer->error = 1;
+			return 0;
+		}
+	} while(zs->avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+
+	return 1;
+}
+
+int tr_gz_write(tr_gz_writer_t* writer, const char* buffer, size_t len)
+{
+	if(writer->error)
+		return 0;
+
+	writer->zs.next_in = (unsigned char*)buffer;
+	writer->zs.avail_in = len;
+
+	return tr_gz_deflate(writer, Z_NO_FLUSH);
+}
+
+int tr_gz_writer_end(tr_gz_writer_t* writer)
+{
+	if(!writer->error) {
+		writer->zs.next_in = NULL;
+		writer->zs.avail_in = 0;
+
+		tr_gz_deflate(writer, Z_FINISH);
+	}
+
+	deflateEnd(&writer->zs);
+
+	free(writer->out_buffer);
+	writer->out_buffer = NULL;
+
+	return !writer->error;
+}
+
+#endif // #ifdef TR_WITH_ZLIB
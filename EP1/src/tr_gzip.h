@@ -0,0 +1,42 @@
+#ifndef TR_TR_GZIP_H
+#define TR_TR_GZIP_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <zlib.h>
+
+// Incremental gzip decoder pulling compressed data from a FILE. Input made of
+// several concatenated gzip members is decoded as a whole, like zcat does.
+typedef struct {
+	z_stream zs;
+	FILE* file;
+	unsigned char* in_buffer;
+	int eof;
+	int error;
+} tr_gz_reader_t;
+
+// Incremental gzip encoder pushing compressed data to a FILE.
+typedef struct {
+	z_stream zs;
+	FILE* file;
+	unsigned char* out_buffer;
+	int error;
+} tr_gz_writer_t;
+
+int tr_gz_reader_init(tr_gz_reader_t* reader, FILE* file);
+
+// Fills `buffer` with up to `size` decompressed bytes, returning early once
+// some are ready and the input has no more available. Returns 0 at the end
+// of the stream or on errors, which are flagged in `reader->error`.
+size_t tr_gz_read(tr_gz_reader_t* reader, char* buffer, size_t size);
+
+void tr_gz_reader_end(tr_gz_reader_t* reader);
+
+int tr_gz_writer_init(tr_gz_writer_t* writer, FILE* file, int level);
+int tr_gz_write(tr_gz_writer_t* writer, const char* buffer, size_t len);
+
+// Flushes the remaining compressed data and the gzip trailer. Must be called
+// exactly once, even after errors, to release the encoder.
+int tr_gz_writer_end(tr_gz_writer_t* writer);
+
+#endif // #ifndef TR_TR_GZIP_H
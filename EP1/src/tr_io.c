@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+#include "utils.h"
+#include "tr_io.h"
+
+// ========================================================================= //
+
+size_t tr_io_read(FILE* in, char* buffer, size_t size, int* error)
+{
+	int fd = fileno(in);
+
+	for(;;) {
+#ifdef _WIN32
+		int len = _read(fd, buffer, (unsigned int)MIN(size, INT_MAX));
+#else
+		ssize_t len = read(fd, buffer, MIN(size, SSIZE_MAX));
+#endif
+
+		if(len >= 0)
+			return (size_t)len;
+
+		if(errno != EINTR) {
+			*error = 1;
+			return 0;
+		}
+	}
+}
+
+int tr_io_is_interactive(FILE* file)
+{
+	struct stat st;
+	int fd = fileno(file);
+
+	if(isatty(fd))
+		return 1;
+
+#ifdef _WIN32
+	return fstat(fd, &st) == 0 && (st.st_mode & _S_IFIFO) != 0;
+#else
+	return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+#endif
+}
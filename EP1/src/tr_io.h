@@ -0,0 +1,18 @@
+#ifndef TR_TR_IO_H
+#define TR_TR_IO_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Reads up to `size` bytes from `in`, returning as soon as any are available
+// instead of waiting for the whole buffer to fill up, so input arriving a bit
+// at a time from terminals and pipes is passed on right away. Returns 0 at
+// the end of the input or on errors, which set `*error`. Goes around stdio's
+// buffering, so `in` must not have been read through stdio before.
+size_t tr_io_read(FILE* in, char* buffer, size_t size, int* error);
+
+// Returns whether `file` is a terminal or a pipe, whose output should be
+// flushed after each block for whoever is waiting on the other end.
+int tr_io_is_interactive(FILE* file);
+
+#endif // #ifndef TR_TR_IO_H
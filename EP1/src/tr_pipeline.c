@@ -0,0 +1,198 @@
+#ifdef TR_WITH_ZLIB
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "tr_process.h"
+#include "tr_buffer_pool.h"
+#include "tr_queue.h"
+#include "tr_gzip.h"
+#include "tr_io.h"
+#include "tr.h"
+
+#include "tr_pipeline.h"
+
+// ========================================================================= //
+
+#define TR_PIPELINE_BUFFER_COUNT 8
+
+// ========================================================================= //
+
+typedef struct {
+	tr_process_state_t* state;
+	FILE* in;
+	FILE* out;
+	int decompress;
+	int compress;
+
+	// Buffers cycle from `free_buffers` to the reader, through `read_queue`
+	// to the translator, and through `write_queue` to the writer, which hands
+	// them back to `free_buffers`.
+	tr_queue_t free_buffers;
+	tr_queue_t read_queue;
+	tr_queue_t write_queue;
+
+	int read_error;
+} tr_pipeline_t;
+
+// ========================================================================= //
+
+static void* tr_pipeline_reader(void* arg)
+{
+	tr_pipeline_t* pipeline = (tr_pipeline_t*)arg;
+	tr_gz_reader_t reader;
+	tr_buffer_t* buffer;
+	int read_error = 0;
+
+	if(pipeline->decompress && !tr_gz_reader_init(&reader, pipeline->in)) {
+		pipeline->read_error = 1;
+		tr_queue_close(&pipeline->read_queue);
+		return NULL;
+	}
+
+	while((buffer = tr_queue_pop(&pipeline->free_buffers)) != NULL) {
+		if(pipeline->decompress) {
+			buffer->len = tr_gz_read(&reader, buffer->data, buffer->size);
+		} else {
+			buffer->len = tr_io_read(pipeline->in, buffer->data, buffer->size,
+			                         &read_error);
+		}
+
+		if(buffer->len == 0
+		   || !tr_queue_push(&pipeline->read_queue, buffer))
+		{
+			break;
+		}
+	}
+
+	if(pipeline->decompress) {
+		tr_gz_reader_end(&reader);
+		if(reader.error)
+			pipeline->read_error = 1;
+	} else if(read_error) {
+		pipeline->read_error = 1;
+	}
+
+	tr_queue_close(&pipeline->read_queue);
+	return NULL;
+}
+
+static void* tr_pipeline_translator(void* arg)
+{
+	tr_pipeline_t* pipeline = (tr_pipeline_t*)arg;
+	tr_buffer_t* buffer;
+
+	while((buffer = tr_queue_pop(&pipeline->read_queue)) != NULL) {
+		buffer->len = tr_process_block(pipeline->state, buffer->data,
+		                               buffer->len, buffer->data);
+
+		if(!tr_queue_push(&pipeline->write_queue, buffer))
+			break;
+	}
+
+	tr_queue_close(&pipeline->write_queue);
+	return NULL;
+}
+
+// Runs on the calling thread. Returns 0 on write errors.
+static int tr_pipeline_writer(tr_pipeline_t* pipeline)
+{
+	tr_gz_writer_t writer;
+	tr_buffer_t* buffer;
+	int ok = 1,
+	    interactive = !pipeline->compress && tr_io_is_interactive(pipeline->out);
+
+	if(pipeline->compress
+	   && !tr_gz_writer_init(&writer, pipeline->out, Z_DEFAULT_COMPRESSION))
+	{
+		ok = 0;
+		tr_queue_close(&pipeline->free_buffers);
+	}
+
+	while((buffer = tr_queue_pop(&pipeline->write_queue)) != NULL) {
+		if(ok && buffer->len > 0) {
+			if(pipeline->compress) {
+				ok = tr_gz_write(&writer, buffer->data, buffer->len);
+			} else {
+				ok = fwrite(buffer->data, 1, buffer->len, pipeline->out)
+				     == buffer->len
+				     && (!interactive || fflush(pipeline->out) == 0);
+			}
+
+			// Stop the reader from producing more data nobody will write.
+			if(!ok)
+				tr_queue_close(&pipeline->free_buffers);
+		}
+
+		tr_queue_push(&pipeline->free_buffers, buffer);
+	}
+
+	if(pipeline->compress && !tr_gz_writer_end(&writer))
+		ok = 0;
+
+	return ok;
+}
+
+// ========================================================================= //
+
+int tr_pipeline_run(tr_process_state_t* state, tr_buffer_pool_t* pool,
+	                FILE* in, FILE* out, int decompress, int compress)
+{
+	tr_pipeline_t pipeline;
+	tr_buffer_t buffers[TR_PIPELINE_BUFFER_COUNT];
+	pthread_t reader_thread, translator_thread;
+	size_t i;
+	int ok;
+
+	pipeline.state = state;
+	pipeline.in = in;
+	pipeline.out = out;
+	pipeline.decompress = decompress;
+	pipeline.compress = compress;
+	pipeline.read_error = 0;
+
+	tr_queue_init(&pipeline.free_buffers, TR_PIPELINE_BUFFER_COUNT);
+	tr_queue_init(&pipeline.read_queue, TR_PIPELINE_BUFFER_COUNT);
+	tr_queue_init(&pipeline.write_queue, TR_PIPELINE_BUFFER_COUNT);
+
+	for(i = 0; i < TR_PIPELINE_BUFFER_COUNT; i++) {
+		buffers[i].data = tr_buffer_pool_get(pool);
+		buffers[i].size = pool->buffer_size;
+		buffers[i].len = 0;
+
+		tr_queue_push(&pipeline.free_buffers, &buffers[i]);
+	}
+
+	if(pthread_create(&reader_thread, NULL, tr_pipeline_reader,
+	                  &pipeline) != 0)
+	{
+		tr_fatal_error("failed to start reader thread\n");
+	}
+
+	if(pthread_create(&translator_thread, NULL, tr_pipeline_translator,
+	                  &pipeline) != 0)
+	{
+		tr_fatal_error("failed to start translator thread\n");
+	}
+
+	ok = tr_pipeline_writer(&pipeline);
+
+	pthread_join(reader_thread, NULL);
+	pthread_join(translator_thread, NULL);
+
+	if(pipeline.read_error)
+		ok = 0;
+
+	tr_queue_destroy(&pipeline.write_queue);
+	tr_queue_destroy(&pipeline.read_queue);
+	tr_queue_destroy(&pipeline.free_buffers);
+
+	for(i = 0; i < TR_PIPELINE_BUFFER_COUNT; i++)
+		tr_buffer_pool_put(pool, buffers[i].data);
+
+	return ok;
+}
+
+#endif // #ifdef TR_WITH_ZLIB
@@ -0,0 +1,17 @@
+#ifndef TR_TR_PIPELINE_H
+#define TR_TR_PIPELINE_H
+
+#include <stdio.h>
+
+#include "tr_process.h"
+#include "tr_buffer_pool.h"
+
+// Runs the translation of `in` into `out` as three threads connected by
+// bounded queues: one reading (and optionally gunzip'ing) the input, one
+// running the translation kernel, and one (optionally gzip'ing and) writing
+// the output. The buffers passed between threads come from `pool`. Returns
+// 0 on errors.
+int tr_pipeline_run(tr_process_state_t* state, tr_buffer_pool_t* pool,
+	                FILE* in, FILE* out, int decompress, int compress);
+
+#endif // #ifndef TR_TR_PIPELINE_H
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "utils.h"
+#include "char_vector.h"
+#include "tr_parser.h"
+#include "tr_io.h"
+
+#include "tr_process.h"
+
+// ========================================================================= //
+
+// Builds the byte translation table. Characters map to the character at the
+// same position in set2; with complement, the characters absent from set1
+// are taken in ascending order instead, and positions past the end of set2
+// map to its last character.
+static void tr_process_build_map(tr_process_state_t* state)
+{
+	const char_vector_t *set1 = state->set1,
+	                    *set2 = state->set2;
+	char_bitset_t mapped;
+	unsigned int c;
+	size_t i;
+
+	for(c = 0; c <= UCHAR_MAX; c++)
+		state->translate_map[c] = (unsigned char)c;
+
+	if(set1 == NULL || set2 == NULL || set2->len == 0)
+		return;
+
+	if(state->complement) {
+		i = 0;
+		for(c = 0; c <= UCHAR_MAX; c++) {
+			if(CHAR_BITSET_TEST(&set1->members, c))
+				continue;
+
+			state->translate_map[c] =
+				(unsigned char)set2->vector[MIN(i, set2->len - 1)];
+			i++;
+		}
+	} else {
+		// The first occurrence of a character in set1 decides its mapping.
+		char_bitset_clear(&mapped);
+
+		for(i = 0; i < set1->len && i < set2->len; i++) {
+			unsigned char ch = (unsigned char)set1->vector[i];
+			if(CHAR_BITSET_TEST(&mapped, ch))
+				continue;
+
+			CHAR_BITSET_ADD(&mapped, ch);
+			state->translate_map[ch] = (unsigned char)set2->vector[i];
+		}
+	}
+}
+
+void tr_process_state_init(tr_process_state_t* state, tr_mode_t mode,
+	                       const char_vector_t* set1,
+	                       const char_vector_t* set2,
+	                       int complement, int squeeze)
+{
+	state->mode = mode;
+	state->set1 = set1;
+	state->set2 = set2;
+	state->complement = complement;
+	state->squeeze = squeeze;
+	// The kernel compares bytes as 0..255, so the "no previous character"
+	// value has to lie outside that range.
+	state->last = EOF;
+
+	char_bitset_clear(&state->delete_members);
+	char_bitset_clear(&state->squeeze_members);
+
+	if(set1 != NULL) {
+		if(complement)
+			char_bitset_complement(&state->delete_members, &set1->members);
+		else
+			state->delete_members = set1->members;
+	}
+
+	// Squeezing uses set2 when translating or deleting, set1 otherwise.
+	if(mode == TR_MODE_SQUEEZE)
+		state->squeeze_members = state->delete_members;
+	else if(squeeze && set2 != NULL)
+		state->squeeze_members = set2->members;
+
+	tr_process_build_map(state);
+}
+
+size_t tr_process_block(tr_process_state_t* state, const char* in, size_t len,
+	                    char* out)
+{
+	const unsigned char *map = state->translate_map;
+	const char_bitset_t *delete_members  = &state->delete_members,
+	                    *squeeze_members = &state->squeeze_members;
+	const unsigned char *src = (const unsigned char*)in;
+	unsigned char *dst = (unsigned char*)out;
+	int squeeze = state->squeeze,
+	    last    = state->last;
+	size_t i, out_len = 0;
+
+	switch(state->mode) {
+	case TR_MODE_TRANSLATE:
+		for(i = 0; i < len; i++) {
+			int c = map[src[i]];
+
+			if(squeeze && last == c && CHAR_BITSET_TEST(squeeze_members, c))
+				continue;
+
+			dst[out_len++] = c;
+			last = c;
+		}
+
+		break;
+	case TR_MODE_DELETE:
+		for(i = 0; i < len; i++) {
+			int c = src[i];
+
+			if(CHAR_BITSET_TEST(delete_members, c))
+				continue;
+
+			if(squeeze && last == c && CHAR_BITSET_TEST(squeeze_members, c))
+				continue;
+
+			dst[out_len++] = c;
+			last = c;
+		}
+
+		break;
+	case TR_MODE_SQUEEZE:
+		for(i = 0; i < len; i++) {
+			int c = src[i];
+
+			if(last == c && CHAR_BITSET_TEST(squeeze_members, c))
+				continue;
+
+			dst[out_len++] = c;
+			last = c;
+		}
+
+		break;
+	}
+
+	state->last = last;
+	return out_len;
+}
+
+int tr_process_stream(tr_process_state_t* state, tr_buffer_pool_t* pool,
+	                  FILE* in, FILE* out)
+{
+	char *buffer = tr_buffer_pool_get(pool);
+	size_t len;
+	int ok = 1,
+	    read_error = 0,
+	    interactive = tr_io_is_interactive(out);
+
+	// Each block is whatever input was available, so output keeps up with
+	// input arriving a line at a time.
+	while((len = tr_io_read(in, buffer, pool->buffer_size, &read_error)) > 0) {
+		len = tr_process_block(state, buffer, len, buffer);
+
+		if(fwrite(buffer, 1, len, out) != len
+		   || (interactive && fflush(out) != 0))
+		{
+			ok = 0;
+			break;
+		}
+	}
+
+	if(read_error)
+		ok = 0;
+
+	tr_buffer_pool_put(pool, buffer);
+	return ok;
+}
@@ -0,0 +1,52 @@
+#ifndef TR_TR_PROCESS_H
+#define TR_TR_PROCESS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <limits.h>
+
+#include "char_vector.h"
+#include "char_bitset.h"
+#include "tr_buffer_pool.h"
+
+typedef enum {
+	TR_MODE_TRANSLATE,
+	TR_MODE_DELETE,
+	TR_MODE_SQUEEZE
+} tr_mode_t;
+
+// State carried by the translation kernel between blocks of input, so a
+// stream may be fed to it in arbitrarily sized pieces.
+typedef struct {
+	tr_mode_t mode;
+	const char_vector_t *set1;
+	const char_vector_t *set2;
+	int complement;
+	int squeeze;
+
+	// Lookup tables derived from the sets once, so the kernel does a single
+	// table load or bit test per character.
+	unsigned char translate_map[UCHAR_MAX + 1];
+	char_bitset_t delete_members;
+	char_bitset_t squeeze_members;
+
+	int last;
+} tr_process_state_t;
+
+void tr_process_state_init(tr_process_state_t* state, tr_mode_t mode,
+	                       const char_vector_t* set1,
+	                       const char_vector_t* set2,
+	                       int complement, int squeeze);
+
+// Processes `len` bytes from `in`, writing the result to `out`, and returns
+// the number of bytes written. The output is never longer than the input, so
+// `in` and `out` may point to the same buffer.
+size_t tr_process_block(tr_process_state_t* state, const char* in, size_t len,
+	                    char* out);
+
+// Runs the kernel over a whole stream, using a buffer from `pool`, returning
+// 0 on I/O errors.
+int tr_process_stream(tr_process_state_t* state, tr_buffer_pool_t* pool,
+	                  FILE* in, FILE* out);
+
+#endif // #ifndef TR_TR_PROCESS_H
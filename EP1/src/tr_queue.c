@@ -0,0 +1,92 @@
+#ifdef TR_WITH_ZLIB
+
+#include <stdlib.h>
+
+#include "xmalloc.h"
+#include "tr_queue.h"
+
+int tr_queue_init(tr_queue_t* queue, size_t capacity)
+{
+	if(queue == NULL || capacity == 0)
+		return 0;
+
+	queue->items = (tr_buffer_t**)xmalloc(capacity * sizeof(*queue->items));
+	queue->capacity = capacity;
+	queue->head = 0;
+	queue->count = 0;
+	queue->closed = 0;
+
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->not_empty, NULL);
+	pthread_cond_init(&queue->not_full, NULL);
+
+	return 1;
+}
+
+void tr_queue_destroy(tr_queue_t* queue)
+{
+	if(queue != NULL) {
+		pthread_cond_destroy(&queue->not_full);
+		pthread_cond_destroy(&queue->not_empty);
+		pthread_mutex_destroy(&queue->lock);
+
+		free(queue->items);
+		queue->items = NULL;
+	}
+}
+
+int tr_queue_push(tr_queue_t* queue, tr_buffer_t* buffer)
+{
+	int ok = 0;
+
+	pthread_mutex_lock(&queue->lock);
+
+	while(queue->count == queue->capacity && !queue->closed)
+		pthread_cond_wait(&queue->not_full, &queue->lock);
+
+	if(!queue->closed) {
+		queue->items[(queue->head + queue->count) % queue->capacity] = buffer;
+		queue->count++;
+		ok = 1;
+
+		pthread_cond_signal(&queue->not_empty);
+	}
+
+	pthread_mutex_unlock(&queue->lock);
+	return ok;
+}
+
+tr_buffer_t* tr_queue_pop(tr_queue_t* queue)
+{
+	tr_buffer_t* buffer = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+
+	while(queue->count == 0 && !queue->closed)
+		pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+	// Items pushed before closing are still handed out.
+	if(queue->count > 0) {
+		buffer = queue->items[queue->head];
+		queue->head = (queue->head + 1) % queue->capacity;
+		queue->count--;
+
+		pthread_cond_signal(&queue->not_full);
+	}
+
+	pthread_mutex_unlock(&queue->lock);
+	return buffer;
+}
+
+void tr_queue_close(tr_queue_t* queue)
+{
+	pthread_mutex_lock(&queue->lock);
+
+	queue->closed = 1;
+	pthread_cond_broadcast(&queue->not_empty);
+	pthread_cond_broadcast(&queue->not_full);
+
+	pthread_mutex_unlock(&queue->lock);
+}
+
+#endif // #ifdef TR_WITH_ZLIB
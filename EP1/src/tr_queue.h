@@ -0,0 +1,40 @@
+#ifndef TR_TR_QUEUE_H
+#define TR_TR_QUEUE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// A block of data travelling between pipeline stages.
+typedef struct {
+	char* data;
+	size_t len;
+	size_t size;
+} tr_buffer_t;
+
+// Bounded blocking FIFO of buffers shared between two threads. Pushing to a
+// full queue and popping from an empty one block until the other side makes
+// progress or the queue is closed.
+typedef struct {
+	tr_buffer_t** items;
+	size_t capacity;
+	size_t head;
+	size_t count;
+	int closed;
+
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+} tr_queue_t;
+
+int tr_queue_init(tr_queue_t* queue, size_t capacity);
+void tr_queue_destroy(tr_queue_t* queue);
+
+// Returns 0 if the queue was closed, in which case the buffer was not queued.
+int tr_queue_push(tr_queue_t* queue, tr_buffer_t* buffer);
+
+// Returns NULL once the queue is closed and drained.
+tr_buffer_t* tr_queue_pop(tr_queue_t* queue);
+
+void tr_queue_close(tr_queue_t* queue);
+
+#endif // #ifndef TR_TR_QUEUE_H
@@ -0,0 +1,957 @@
+/** @file regions_bench.c
+ *
+ * Benchmark of reading, labeling and aggregating regions over synthetic
+ * bitmaps, including the worst cases of each labeling method
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "bitmap_label.h"
+#include "bitmap_euler.h"
+#include "bitmap_contour.h"
+#include "bitmap_dynamic.h"
+#include "bitmap_reader.h"
+#include "bitmap_runs.h"
+#include "bitmap_stream.h"
+#include "bitmap_tiled.h"
+#include "bitmap_volume.h"
+#include "bitmap_pbm.h"
+#include "bitmap_mapped.h"
+#include "region_features.h"
+#include "region_query.h"
+#include "regions_ctx.h"
+#include "parallel.h"
+
+/** Site percolation threshold of the square lattice, for 4-connectivity */
+#define BENCH_PERCOLATION 0.592746
+
+/** Number of points flipped by each run of the incremental phases */
+#define BENCH_FLIPS 4096
+
+#if defined(BENCH_COUNT_ALLOCS)
+
+/** Number of calls to malloc(), calloc() and realloc() so far */
+static unsigned long bench_allocs;
+
+/* With BENCH_COUNT_ALLOCS, the Makefile links with --wrap for each of these,
+   so every call from the labeling code goes through the wrappers */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void*
+__wrap_malloc(size_t size)
+{
+    __sync_fetch_and_add(&bench_allocs, 1);
+    return __real_malloc(size);
+}
+
+void*
+__wrap_calloc(size_t count,
+              size_t size)
+{
+    __sync_fetch_and_add(&bench_allocs, 1);
+    return __real_calloc(count, size);
+}
+
+void*
+__wrap_realloc(void *ptr,
+               size_t size)
+{
+    __sync_fetch_and_add(&bench_allocs, 1);
+    return __real_realloc(ptr, size);
+}
+
+#endif /* BENCH_COUNT_ALLOCS */
+
+/** Options selected in the command line */
+typedef struct {
+    /** Width and height of the bitmaps */
+    int size;
+    /** Number of times each phase is run, keeping the fastest */
+    unsigned int repeats;
+    /** Number of threads for the parallel labeling phase */
+    unsigned int threads;
+} bench_options;
+
+/**
+ * A dynamic bitmap kept across the runs of an incremental phase, changing a
+ * little more with each one
+ */
+typedef struct {
+    /** The dynamic bitmap, starting as a copy of the case's bitmap */
+    bitmap_dynamic *dyn;
+    /** State of the generator of the points to flip */
+    uint64_t random;
+} bench_dynamic;
+
+/** Inputs shared by the phases of a case, prepared without being timed */
+typedef struct {
+    /** The bitmap */
+    const bitmap *map;
+    /** A tiled copy of the bitmap, for the tiled labeling phase */
+    const bitmap_tiled *tiled;
+    /** The bitmap in the text format, for the reading phase */
+    FILE *text;
+    /** The 4-connected labels of the bitmap, for the aggregation phase */
+    const label_image *labels;
+    /** The bitmap as a mapped PBM file, for the out-of-core phase */
+    const pbm_image *pbm;
+    /** Path of the label file the out-of-core phase writes */
+    const char *label_path;
+    /** Labeling context kept across the runs of the context phase */
+    regions_ctx *ctx;
+    /** Dynamic bitmaps of the incremental phases, for each connectivity */
+    bench_dynamic *dynamic4;
+    bench_dynamic *dynamic8;
+    /** Number of threads for the parallel labeling phase */
+    unsigned int threads;
+} bench_input;
+
+/**
+ * Runs a phase once
+ *
+ * @param input The inputs of the case
+ *
+ * @returns The result of the phase, or NULL on error
+ */
+typedef void* (*bench_run)(const bench_input *input);
+
+/**
+ * Frees the result of a phase, outside of the timed section
+ *
+ * @param result The result to free
+ */
+typedef void (*bench_release)(void *result);
+
+/**
+ * Checks the result of a phase, outside of the timed section
+ *
+ * @param result The result to check
+ *
+ * @returns 1 if the result is right, 0 otherwise
+ */
+typedef int (*bench_check)(void *result);
+
+/** A phase of the benchmark */
+typedef struct {
+    /** Name of the phase */
+    const char *name;
+    /** Runs the phase */
+    bench_run run;
+    /** Frees the phase's result */
+    bench_release release;
+    /** Checks the phase's result, or NULL if it is not checked */
+    bench_check check;
+} bench_phase;
+
+/**
+ * Fills a bitmap with a synthetic pattern
+ *
+ * @param map     The bitmap to fill, with all bits cleared
+ * @param density Density of set points, for random patterns
+ */
+typedef void (*bench_generator)(bitmap *map,
+                                double density);
+
+/** A synthetic bitmap */
+typedef struct {
+    /** Name of the case */
+    const char *name;
+    /** Generator of the bitmap */
+    bench_generator generate;
+    /** Density of set points, for random patterns */
+    double density;
+} bench_case;
+
+/**
+ * Retrieves the time elapsed since an arbitrary point, in seconds
+ */
+static double
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Random points, each set with the given probability
+ */
+static void
+generate_random(bitmap *map,
+                double density)
+{
+    /* xorshift64: reproducible across runs and platforms */
+    uint64_t state = ((uint64_t)0x9E3779B9UL << 32) | 0x7F4A7C15UL;
+    uint64_t threshold = (uint64_t)(density * 4294967296.0);
+    int x, y;
+
+    for(y = 0; y < map->height; y++) {
+        for(x = 0; x < map->width; x++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+
+            if((state >> 32) < threshold)
+                bitmap_setbit(map, x, y, 1);
+        }
+    }
+}
+
+/**
+ * A single square spiral path with a one point gap between its turns: one
+ * region as long and as deep as it gets
+ */
+static void
+generate_spiral(bitmap *map,
+                double density)
+{
+    int x = 0, y = 0, dx = 1, dy = 0,
+        lengths[2], turn, i;
+
+    (void)density;
+
+    lengths[0] = map->width - 1;
+    lengths[1] = map->height - 1;
+
+    bitmap_setbit(map, 0, 0, 1);
+
+    /* Each pair of turns after the first two brings the path 2 points
+       further in from each side */
+    for(turn = 0; lengths[turn % 2] > 0; turn++) {
+        for(i = 0; i < lengths[turn % 2]; i++) {
+            x += dx;
+            y += dy;
+            bitmap_setbit(map, x, y, 1);
+        }
+
+        if(turn >= 1)
+            lengths[turn % 2] -= 2;
+
+        /* Turn clockwise */
+        i = dx;
+        dx = -dy;
+        dy = i;
+    }
+}
+
+/**
+ * Full rows joined at alternating ends: one region zigzagging from top to
+ * bottom
+ */
+static void
+generate_serpentine(bitmap *map,
+                    double density)
+{
+    int x, y;
+
+    (void)density;
+
+    for(y = 0; y < map->height; y++) {
+        if(y % 2 == 0) {
+            for(x = 0; x < map->width; x++)
+                bitmap_setbit(map, x, y, 1);
+        } else {
+            bitmap_setbit(map, (y % 4 == 1) ? map->width - 1 : 0, y, 1);
+        }
+    }
+}
+
+/**
+ * Alternating points: the most 4-connected regions possible, and a single
+ * 8-connected one
+ */
+static void
+generate_checkerboard(bitmap *map,
+                      double density)
+{
+    int x, y;
+
+    (void)density;
+
+    for(y = 0; y < map->height; y++)
+        for(x = y % 2; x < map->width; x += 2)
+            bitmap_setbit(map, x, y, 1);
+}
+
+/**
+ * All points set
+ */
+static void
+generate_solid(bitmap *map,
+               double density)
+{
+    int x, y;
+
+    (void)density;
+
+    for(y = 0; y < map->height; y++)
+        for(x = 0; x < map->width; x++)
+            bitmap_setbit(map, x, y, 1);
+}
+
+/** All the cases, in the order they are run */
+static const bench_case bench_cases[] = {
+    { "random-0.10",     generate_random,       0.10 },
+    { "random-0.30",     generate_random,       0.30 },
+    { "random-0.50",     generate_random,       0.50 },
+    { "random-0.5927",   generate_random,       BENCH_PERCOLATION },
+    { "random-0.70",     generate_random,       0.70 },
+    { "random-0.90",     generate_random,       0.90 },
+    { "spiral",          generate_spiral,       0 },
+    { "serpentine",      generate_serpentine,   0 },
+    { "checkerboard",    generate_checkerboard, 0 },
+    { "solid",           generate_solid,        0 }
+};
+
+/** Number of cases */
+#define BENCH_CASE_COUNT (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+/**
+ * Writes a bitmap in the text format read by bitmap_reader_read()
+ */
+static int
+write_text(FILE *file,
+           const bitmap *map)
+{
+    int x, y;
+
+    fprintf(file, "%d %d\n", map->height, map->width);
+
+    for(y = 0; y < map->height; y++) {
+        for(x = 0; x < map->width; x++) {
+            putc('0' + bitmap_getbit(map, x, y), file);
+            putc((x == map->width - 1) ? '\n' : ' ', file);
+        }
+    }
+
+    return fflush(file) == 0 && !ferror(file);
+}
+
+/** Reads the bitmap back from its text format */
+static void*
+run_read(const bench_input *input)
+{
+    bitmap_reader *reader;
+    bitmap *map;
+
+    rewind(input->text);
+
+    reader = bitmap_reader_new(input->text);
+    if(reader == NULL)
+        return NULL;
+
+    map = bitmap_reader_read(reader);
+    bitmap_reader_free(reader);
+
+    return map;
+}
+
+/** Labels the 4-connected regions */
+static void*
+run_label_4(const bench_input *input)
+{
+    return bitmap_label(input->map, BITMAP_CONNECTIVITY_4, 1);
+}
+
+/** Labels the 8-connected regions */
+static void*
+run_label_8(const bench_input *input)
+{
+    return bitmap_label(input->map, BITMAP_CONNECTIVITY_8, 1);
+}
+
+/** Labels the 4-connected regions with multiple threads */
+static void*
+run_label_parallel(const bench_input *input)
+{
+    return bitmap_label(input->map, BITMAP_CONNECTIVITY_4, input->threads);
+}
+
+/** Labels the 4-connected regions of the tiled copy, tile by tile */
+static void*
+run_label_tiled(const bench_input *input)
+{
+    return bitmap_tiled_label(input->tiled, BITMAP_CONNECTIVITY_4,
+                              input->threads);
+}
+
+/** Builds the list of regions from the 4-connected labels */
+static void*
+run_regions(const bench_input *input)
+{
+    return label_image_regions(input->labels);
+}
+
+/** Labels and lists the 4-connected regions by runs */
+static void*
+run_runs(const bench_input *input)
+{
+    return bitmap_find_all_run_regions(input->map, BITMAP_CONNECTIVITY_4);
+}
+
+/** Labels the 4-connected regions by runs, computing their features */
+static void*
+run_features(const bench_input *input)
+{
+    region_features *features;
+    size_t region_count;
+
+    if(!bitmap_find_all_features(input->map, BITMAP_CONNECTIVITY_4,
+                                 &features, &region_count))
+    {
+        return NULL;
+    }
+
+    /* Without regions there is no array to return, but the phase worked */
+    return (features != NULL) ? (void*)features : malloc(1);
+}
+
+/**
+ * Labels the 6-connected regions of the bitmap seen as a volume of 8 slices,
+ * each made of consecutive rows, or of a single slice for tiny bitmaps
+ */
+static void*
+run_volume(const bench_input *input)
+{
+    bitmap_volume vol;
+
+    vol.depth = (input->map->height >= 8) ? 8 : 1;
+    vol.width = input->map->width;
+    vol.height = input->map->height / vol.depth;
+    vol.stride = input->map->stride;
+    vol.data = input->map->data;
+
+    return bitmap_volume_label(&vol, VOLUME_CONNECTIVITY_6, input->threads);
+}
+
+/**
+ * Labels the 4-connected regions by runs in a context reused from run to
+ * run, which stops allocating after the first one
+ */
+static void*
+run_runs_ctx(const bench_input *input)
+{
+    /* The list belongs to the context */
+    return (void*)regions_ctx_find(input->ctx, input->map,
+                                   BITMAP_CONNECTIVITY_4);
+}
+
+/** Builds only the 10 largest 4-connected regions */
+static void*
+run_top(const bench_input *input)
+{
+    region_query query;
+
+    query.min_area = 0;
+    query.top_k = 10;
+    query.max_count = 0;
+
+    return bitmap_query_run_regions(input->map, BITMAP_CONNECTIVITY_4,
+                                    &query);
+}
+
+/**
+ * Flips random points of a dynamic bitmap, updating its regions as it goes,
+ * and retrieves the number of regions
+ */
+static void*
+run_dynamic_flips(bench_dynamic *bdyn)
+{
+    bitmap_dynamic *dyn = bdyn->dyn;
+    int i, x, y;
+
+    for(i = 0; i < BENCH_FLIPS; i++) {
+        bdyn->random ^= bdyn->random << 13;
+        bdyn->random ^= bdyn->random >> 7;
+        bdyn->random ^= bdyn->random << 17;
+
+        x = (int)((bdyn->random >> 32) % (uint64_t)dyn->map->width);
+        y = (int)((bdyn->random & 0xFFFFFFFFUL) % (uint64_t)dyn->map->height);
+
+        if(!bitmap_dynamic_setbit(dyn, x, y, !bitmap_getbit(dyn->map, x, y)))
+            return NULL;
+    }
+
+    bitmap_dynamic_region_count(dyn);
+
+    return dyn;
+}
+
+/** Flips BENCH_FLIPS points, keeping the 4-connected regions up to date */
+static void*
+run_dynamic_4(const bench_input *input)
+{
+    return run_dynamic_flips(input->dynamic4);
+}
+
+/** Flips BENCH_FLIPS points, keeping the 8-connected regions up to date */
+static void*
+run_dynamic_8(const bench_input *input)
+{
+    return run_dynamic_flips(input->dynamic8);
+}
+
+/** Labels the 4-connected regions of the mapped PBM file out of core */
+static void*
+run_mapped(const bench_input *input)
+{
+    region_label *region_count = malloc(sizeof(*region_count));
+
+    if(region_count != NULL
+       && !pbm_label_mapped(input->pbm, BITMAP_CONNECTIVITY_4,
+                            PBM_MAPPED_TILE_SIZE, input->label_path,
+                            region_count))
+    {
+        free(region_count);
+        return NULL;
+    }
+
+    return region_count;
+}
+
+/** Traces the contours of the 4-connected labels */
+static void*
+run_contours(const bench_input *input)
+{
+    return label_image_contours(input->labels, BITMAP_CONNECTIVITY_4);
+}
+
+/** Computes the Euler number of the 4-connected regions by bit-quads */
+static void*
+run_euler(const bench_input *input)
+{
+    long *euler = malloc(sizeof(*euler));
+
+    if(euler != NULL)
+        *euler = bitmap_euler_number(input->map, BITMAP_CONNECTIVITY_4);
+
+    return euler;
+}
+
+/**
+ * Checks the regions of a dynamic bitmap against labeling it from scratch:
+ * there must be as many regions, and each region labeled from scratch must
+ * be a single region of the dynamic bitmap, of the same size
+ */
+static int
+check_dynamic(void *result)
+{
+    bitmap_dynamic *dyn = result;
+    label_image *labels;
+    region_label *regions = NULL, label, region;
+    size_t *sizes = NULL;
+    int x, y, ok = 0;
+
+    labels = bitmap_label(dyn->map, dyn->connectivity, 1);
+    if(labels == NULL)
+        return 0;
+
+    if(bitmap_dynamic_region_count(dyn) != labels->region_count)
+        goto out;
+
+    regions = calloc((size_t)labels->region_count + 1, sizeof(*regions));
+    sizes = calloc((size_t)labels->region_count + 1, sizeof(*sizes));
+    if(regions == NULL || sizes == NULL)
+        goto out;
+
+    for(y = 0; y < labels->height; y++)
+        for(x = 0; x < labels->width; x++)
+            sizes[label_image_get(labels, x, y)]++;
+
+    for(y = 0; y < labels->height; y++) {
+        for(x = 0; x < labels->width; x++) {
+            label = label_image_get(labels, x, y);
+            region = bitmap_dynamic_region(dyn, x, y);
+
+            if((label == 0) != (region == 0))
+                goto out;
+
+            if(label == 0)
+                continue;
+
+            /* The first point of each region decides which region of the
+               dynamic bitmap it must be. With the same size, that region
+               can't hold any other point. */
+            if(regions[label] == 0) {
+                regions[label] = region;
+                if(bitmap_dynamic_region_size(dyn, x, y) != sizes[label])
+                    goto out;
+            } else if(regions[label] != region) {
+                goto out;
+            }
+        }
+    }
+
+    ok = 1;
+
+out:
+    free(regions);
+    free(sizes);
+    label_image_free(labels);
+
+    return ok;
+}
+
+/** Frees a contour list result */
+static void
+release_contour_list(void *result)
+{
+    region_contour_list_free(result);
+}
+
+/** Leaves a result owned by someone else alone */
+static void
+release_nothing(void *result)
+{
+    (void)result;
+}
+
+/** Frees a volume labels result */
+static void
+release_volume_labels(void *result)
+{
+    volume_labels_free(result);
+}
+
+/** Frees a bitmap result */
+static void
+release_bitmap(void *result)
+{
+    bitmap_free(result);
+}
+
+/** Frees a label image result */
+static void
+release_label_image(void *result)
+{
+    label_image_free(result);
+}
+
+/** Frees a region list result */
+static void
+release_region_list(void *result)
+{
+    bitmap_region_list_free(result);
+}
+
+/**
+ * All the phases, in the order they are run: reading, labeling alone with
+ * each method, aggregating labels into regions, labeling and aggregating at
+ * once with the run-based methods, with a reused context as well, building
+ * only the largest regions, tracing contours from the labels, counting holes
+ * without labeling, labeling the bitmap as a volume, labeling it out of
+ * core from a file and keeping the regions up to date while points are
+ * flipped, checked against labeling from scratch
+ */
+static const bench_phase bench_phases[] = {
+    { "read",         run_read,           release_bitmap,        NULL },
+    { "label-4",      run_label_4,        release_label_image,   NULL },
+    { "label-8",      run_label_8,        release_label_image,   NULL },
+    { "label-4-par",  run_label_parallel, release_label_image,   NULL },
+    { "label-tiled",  run_label_tiled,    release_label_image,   NULL },
+    { "regions",      run_regions,        release_region_list,   NULL },
+    { "runs",         run_runs,           release_region_list,   NULL },
+    { "runs-ctx",     run_runs_ctx,       release_nothing,       NULL },
+    { "top-10",       run_top,            release_region_list,   NULL },
+    { "features",     run_features,       free,                  NULL },
+    { "contours",     run_contours,       release_contour_list,  NULL },
+    { "euler",        run_euler,          free,                  NULL },
+    { "volume-6",     run_volume,         release_volume_labels, NULL },
+    { "mapped",       run_mapped,         free,                  NULL },
+    { "dynamic-4",    run_dynamic_4,      release_nothing,       check_dynamic },
+    { "dynamic-8",    run_dynamic_8,      release_nothing,       check_dynamic }
+};
+
+/** Number of phases */
+#define BENCH_PHASE_COUNT (sizeof(bench_phases) / sizeof(bench_phases[0]))
+
+/**
+ * Times a phase, printing its fastest run
+ *
+ * @returns 1 on success, 0 if the phase failed
+ */
+static int
+bench_run_phase(const bench_phase *phase,
+                const bench_input *input,
+                const bench_options *options)
+{
+    double best = -1, pixels = (double)input->map->width * input->map->height;
+    unsigned long allocs = 0;
+    unsigned int i;
+
+    for(i = 0; i < options->repeats; i++) {
+        double start, elapsed;
+        void *result;
+
+#if defined(BENCH_COUNT_ALLOCS)
+        allocs = bench_allocs;
+#endif
+
+        start = bench_now();
+        result = phase->run(input);
+        elapsed = bench_now() - start;
+
+#if defined(BENCH_COUNT_ALLOCS)
+        allocs = bench_allocs - allocs;
+#endif
+
+        if(result == NULL) {
+            printf("  %-12s failed\n", phase->name);
+            return 0;
+        }
+
+        if(phase->check != NULL && !phase->check(result)) {
+            printf("  %-12s wrong result\n", phase->name);
+            phase->release(result);
+            return 0;
+        }
+
+        phase->release(result);
+
+        if(best < 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    printf("  %-12s %10.2f Mpx/s %10.2f ms", phase->name,
+           pixels / best / 1e6, best * 1e3);
+
+#if defined(BENCH_COUNT_ALLOCS)
+    printf(" %10lu allocs\n", allocs);
+#else
+    printf("          - allocs\n");
+#endif
+
+    return 1;
+}
+
+/**
+ * Generates the bitmap of a case and runs all phases over it
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+bench_run_case(const bench_case *bcase,
+               const bench_options *options)
+{
+    bench_input input;
+    bench_dynamic dynamic4, dynamic8;
+    bitmap *map;
+    bitmap_tiled *tiled = NULL;
+    label_image *labels4 = NULL, *labels8 = NULL;
+    pbm_image *pbm = NULL;
+    char pbm_path[64], label_path[64];
+    FILE *pbm_file;
+    struct rusage usage;
+    size_t i;
+    int ok = 0;
+
+    map = bitmap_new(options->size, options->size);
+    if(map == NULL)
+        return 0;
+
+    bcase->generate(map, bcase->density);
+
+    input.map = map;
+    input.threads = options->threads;
+    input.text = tmpfile();
+
+    /* The out-of-core phase needs files with names */
+    sprintf(pbm_path, "/tmp/regions-bench-%ld.pbm", (long)getpid());
+    sprintf(label_path, "/tmp/regions-bench-%ld.bin", (long)getpid());
+
+    pbm_file = fopen(pbm_path, "wb");
+    if(pbm_file != NULL) {
+        int written = pbm_write(pbm_file, map);
+
+        if(fclose(pbm_file) == 0 && written)
+            pbm = pbm_map(pbm_path);
+    }
+
+    input.ctx = regions_ctx_new();
+
+    /* Each incremental phase flips the same points, from the same state */
+    dynamic4.dyn = bitmap_dynamic_new(map, BITMAP_CONNECTIVITY_4);
+    dynamic8.dyn = bitmap_dynamic_new(map, BITMAP_CONNECTIVITY_8);
+    dynamic4.random = dynamic8.random =
+        ((uint64_t)0x2545F491UL << 32) | 0x4F6CDD1DUL;
+    input.dynamic4 = &dynamic4;
+    input.dynamic8 = &dynamic8;
+
+    if(input.text != NULL && write_text(input.text, map)) {
+        labels4 = bitmap_label(map, BITMAP_CONNECTIVITY_4, 1);
+        labels8 = bitmap_label(map, BITMAP_CONNECTIVITY_8, 1);
+        tiled = bitmap_tiled_from_bitmap(map);
+    }
+
+    if(labels4 != NULL && labels8 != NULL && tiled != NULL && pbm != NULL
+       && input.ctx != NULL && dynamic4.dyn != NULL && dynamic8.dyn != NULL)
+    {
+        input.labels = labels4;
+        input.tiled = tiled;
+        input.pbm = pbm;
+        input.label_path = label_path;
+
+        printf("%s: %dx%d, %lu 4-connected regions, "
+               "%lu 8-connected regions\n", bcase->name, map->width,
+               map->height, (unsigned long)labels4->region_count,
+               (unsigned long)labels8->region_count);
+
+        ok = 1;
+        for(i = 0; i < BENCH_PHASE_COUNT; i++)
+            ok = bench_run_phase(&bench_phases[i], &input, options) && ok;
+
+        /* Kilobytes on Linux. Each case runs in a process of its own. */
+        getrusage(RUSAGE_SELF, &usage);
+        printf("  peak RSS %ld KiB\n", (long)usage.ru_maxrss);
+    } else {
+        fprintf(stderr, "ERROR: Can't prepare case '%s'.\n", bcase->name);
+    }
+
+    label_image_free(labels4);
+    label_image_free(labels8);
+    bitmap_tiled_free(tiled);
+    regions_ctx_free(input.ctx);
+    bitmap_dynamic_free(dynamic4.dyn);
+    bitmap_dynamic_free(dynamic8.dyn);
+    pbm_unmap(pbm);
+    remove(pbm_path);
+    remove(label_path);
+    if(input.text != NULL)
+        fclose(input.text);
+    bitmap_free(map);
+
+    return ok;
+}
+
+/**
+ * Runs a case in a child process, so that its peak memory use is not mixed
+ * with the other cases'
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+bench_fork_case(const bench_case *bcase,
+                const bench_options *options)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+
+    pid = fork();
+    if(pid < 0)
+        return bench_run_case(bcase, options);
+
+    if(pid == 0) {
+        status = bench_run_case(bcase, options);
+        fflush(stdout);
+        _exit(status ? 0 : 1);
+    }
+
+    if(waitpid(pid, &status, 0) != pid)
+        return 0;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Prints the command line usage
+ *
+ * @param program_name Name the program was invoked with
+ */
+static void
+print_usage(const char *program_name)
+{
+    size_t i;
+
+    fprintf(stderr,
+            "Usage: %s [--size N] [--repeats N] [--threads N] [CASE...]\n"
+            "\n"
+            "Times reading, labeling and aggregating the regions of synthetic\n"
+            "N x N bitmaps (default: 2048), keeping the fastest of a number of\n"
+            "repeats (default: 3). The parallel labeling uses the given\n"
+            "number of threads (default: all processors).\n"
+            "\n"
+            "Cases:",
+            program_name);
+
+    for(i = 0; i < BENCH_CASE_COUNT; i++)
+        fprintf(stderr, " %s", bench_cases[i].name);
+
+    fprintf(stderr, "\n");
+}
+
+/** Benchmark entry point */
+int main(int argc, char **argv) {
+    bench_options options;
+    int i, status = 0;
+    size_t c;
+
+    options.size = 2048;
+    options.repeats = 3;
+    options.threads = parallel_cpu_count();
+
+    for(i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if(strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            options.size = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            options.repeats = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+            if(options.threads == 0)
+                options.threads = parallel_cpu_count();
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(options.size <= 0 || options.repeats == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* Without case names, run them all */
+    if(i == argc) {
+        for(c = 0; c < BENCH_CASE_COUNT; c++) {
+            if(!bench_fork_case(&bench_cases[c], &options))
+                status = 1;
+        }
+
+        return status;
+    }
+
+    for(; i < argc; i++) {
+        for(c = 0; c < BENCH_CASE_COUNT; c++) {
+            if(strcmp(argv[i], bench_cases[c].name) == 0)
+                break;
+        }
+
+        if(c == BENCH_CASE_COUNT) {
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        if(!bench_fork_case(&bench_cases[c], &options))
+            status = 1;
+    }
+
+    return status;
+}
@@ -14,6 +14,8 @@
 
 #include "utils.h"
 #include "bitmap.h"
+#include "union_find.h"
+#include "bitmap_label.h"
 
 image_bit
 bitmap_getbit(const bitmap *map,
@@ -27,7 +29,8 @@ bitmap_getbit(const bitmap *map,
         return 0;
     }
 
-    return map->data[(y * map->width) + x];
+    return (bitmap_row(map, y)[x / BITMAP_WORD_BITS]
+            >> (x % BITMAP_WORD_BITS)) & 1;
 }
 
 void
@@ -43,229 +46,161 @@ bitmap_setbit(bitmap *map,
         return;
     }
 
-    map->data[(y * map->width) + x] = value;
+    if(value)
+        bitmap_row(map, y)[x / BITMAP_WORD_BITS] |=
+            (bitmap_word)1 << (x % BITMAP_WORD_BITS);
+    else
+        bitmap_row(map, y)[x / BITMAP_WORD_BITS] &=
+            ~((bitmap_word)1 << (x % BITMAP_WORD_BITS));
 }
 
-void
-bitmap_free(bitmap *map)
+bitmap_word
+bitmap_getword(const bitmap *map,
+               size_t i,
+               int y)
 {
-    if(map != NULL) {
-        if(map->data != NULL)
-            free(map->data);
-        
-        free(map);
+    if(map == NULL || map->data == NULL
+       || i >= map->stride
+       || y < 0 || y >= map->height)
+    {
+        return 0;
     }
-}
 
-void
-bitmap_region_free(bitmap_region *region)
-{
-    if(region != NULL)
-        linked_list_free(region, bitmap_region, next);
+    return bitmap_row(map, y)[i];
 }
 
 void
-bitmap_region_list_free(bitmap_region_list* list)
-{
-    if(list != NULL) {
-        bitmap_region_list *iter, *iter_next;
-
-        /* Free both the stored regions themselves, and the list entries */
-        linked_list_foreach(list, iter, iter_next, next) {
-            bitmap_region_free(iter->region);
-            free(iter);
-        }
-    }
-}
-
-/**
- * @internal
- *
- * Adds a point to the list of points representing a region on a bitmap
- *
- * @param x            0-based index of the starting position on the x-axis
- * @param y            0-based index of the starting position on the y-axis
- * @param region_start Pointer to a pointer to a bitmap_region that will be
- *                     updated to refer to the first item of the newly created
- *                     region
- * @param region_end Pointer to a pointer to a bitmap_region that will be
- *                     updated to refer to the last item of the newly created
- *                     region
- */
-static void
-bitmap_region_entry_add__(int x,
-                          int y,
-                          bitmap_region **region_start,
-                          bitmap_region **region_end)
+bitmap_setword(bitmap *map,
+               size_t i,
+               int y,
+               bitmap_word value)
 {
-    bitmap_region *region_entry = malloc(sizeof(*region_entry));
-    if(region_entry == NULL)
+    if(map == NULL || map->data == NULL
+       || i >= map->stride
+       || y < 0 || y >= map->height)
+    {
         return;
+    }
 
-    region_entry->x = x;
-    region_entry->y = y;
-    region_entry->next = NULL;
-
-    if(*region_start == NULL)
-        *region_start = region_entry;
-    else if(*region_end != NULL)
-        (*region_end)->next = region_entry;
+    /* Keep the padding past the width clear */
+    if(i == map->stride - 1)
+        value &= bitmap_last_word_mask(map);
 
-    *region_end = region_entry;
+    bitmap_row(map, y)[i] = value;
 }
 
-/**
- * @internal
- *
- * Retrieves a single connected regions from a bitmap, starting at a given
- * point.
- *
- * @param map          The bitmap to use
- * @param start_x      0-based index of the starting position on the x-axis
- * @param start_y      0-based index of the starting position on the y-axis
- * @param region_start Pointer to a pointer to a bitmap_region that will be
- *                     updated to refer to the first item of the newly created
- *                     region
- * @param region_end Pointer to a pointer to a bitmap_region that will be
- *                     updated to refer to the last item of the newly created
- *                     region
- */
-
-static int
-bitmap_find_region__(bitmap *map,
-                     int start_x,
-                     int start_y,
-                     bitmap_region** region_start,
-                     bitmap_region** region_end)
+bitmap_word
+bitmap_last_word_mask(const bitmap *map)
 {
-    /* Array of structures representing the directions we'll check */
-    struct {
-        int x, y;
-    } const deltas[] = {
-        { 1,  0}, /* right */ {-1,  0}, /* left */
-        { 0,  1}, /* down  */ { 0, -1}  /* up   */
-    };
-    /* All elements are zero-initialized */
-    unsigned int edges[ARRAY_SIZE(deltas)] = {0};
-    unsigned int i, j, k;
-
-    if(region_start == NULL || region_end == NULL)
-        return 0;
+    unsigned int used = map->width % BITMAP_WORD_BITS;
 
-    /* Don't bother doing anything if the very first point on the region is a
-       zero. */
-    if(bitmap_getbit(map, start_x, start_y) == 0)
-        return 0;
+    if(used == 0)
+        return ~(bitmap_word)0;
 
-    /* Clear the bit so it is not found again later: this makes our algorithm
-       much simpler as we can just recursively walk around all adjacent points
-       naively. */
-    bitmap_setbit(map, start_x, start_y, 0);
-    bitmap_region_entry_add__(start_x, start_y, region_start, region_end);
+    return ((bitmap_word)1 << used) - 1;
+}
 
-    /* Instead of doing a naive recursion to four directions for each point.
-       try walking as much as possible in each direction first, until a zero
-       point is reached. */
+bitmap*
+bitmap_new(int width,
+           int height)
+{
+    bitmap *map;
 
-    for(i = 0; i < ARRAY_SIZE(deltas); i++) {
-        int dx = deltas[i].x, dy = deltas[i].y,
-            x = start_x + dx,
-            y = start_y + dy;
+    if(width <= 0 || height <= 0)
+        return NULL;
 
-        while(bitmap_getbit(map, x, y) != 0)
-        {
-            bitmap_setbit(map, x, y, 0);
-            bitmap_region_entry_add__(x, y, region_start, region_end);
+    map = malloc(sizeof(*map));
+    if(map == NULL)
+        return NULL;
 
-            x += dx;
-            y += dy;
+    map->width = width;
+    map->height = height;
+    map->stride = BITMAP_STRIDE(width);
 
-            edges[i]++;
-        }
+    map->data = calloc(map->stride * height, sizeof(*map->data));
+    if(map->data == NULL) {
+        free(map);
+        return NULL;
     }
 
-    /* Now that we walked and removed as much points as possible in all
-       directions, we must call bitmap_find_region__() manually for each
-       direction, because the center points have been unset already. */
-
-    for(i = 0; i < ARRAY_SIZE(deltas); i++) {
-        for(j = 1; j <= edges[i]; j++) {
-            for(k = 0; k < ARRAY_SIZE(deltas); k++) {
-                int x = start_x + (deltas[i].x * j) + deltas[k].x,
-                    y = start_y + (deltas[i].y * j) + deltas[k].y;
+    return map;
+}
 
-                bitmap_find_region__(map, x, y, region_start, region_end);
-            }
-        }
+void
+bitmap_free(bitmap *map)
+{
+    if(map != NULL) {
+        if(map->data != NULL)
+            free(map->data);
+        
+        free(map);
     }
-
-    return 1;
 }
 
 bitmap_region_list*
-bitmap_find_all_regions(bitmap* map)
+bitmap_region_list_alloc(size_t region_count,
+                         size_t run_count)
 {
-    bitmap_region_list *list_start = NULL,
-                       *list_end = NULL;
-    bitmap_region *region_start, *region_end;
-    int x, y;
-
-    if(map == NULL || map->data == NULL)
+    bitmap_region_list *list;
+
+    /* The runs go after the regions, which go after the list itself.
+       Regions hold pointers, so they are aligned properly after the list,
+       and runs only hold ints. */
+    list = malloc(sizeof(*list)
+                  + region_count * sizeof(*list->regions)
+                  + run_count * sizeof(*list->runs));
+    if(list == NULL)
         return NULL;
 
-    for(y = 0; y < map->height; y++) {
-        for(x = 0; x < map->width; x++) {
-            region_start = region_end = NULL;
-
-            if(bitmap_find_region__(map, x, y, &region_start, &region_end)) {
-                /* A region was found, create an entry for it and append it to
-                   the list of regions. */
-                bitmap_region_list *list_entry = malloc(sizeof(*list_entry));
-                if(list_entry == NULL)
-                    goto error;
+    list->regions = (bitmap_region*)(list + 1);
+    list->region_count = region_count;
+    list->runs = (bitmap_run*)(list->regions + region_count);
+    list->run_count = run_count;
 
-                list_entry->region = region_start;
-                list_entry->next = NULL;
+    return list;
+}
 
-                if(list_start == NULL)
-                    list_start = list_entry;
-                else if(list_end != NULL)
-                    list_end->next = list_entry;
+void
+bitmap_region_list_free(bitmap_region_list* list)
+{
+    /* Everything lives in a single block */
+    free(list);
+}
 
-                list_end = list_entry;
-            }
-        }
-    }
+bitmap_region_list*
+bitmap_find_all_regions(bitmap* map)
+{
+    return bitmap_find_all_regions_parallel(map, BITMAP_CONNECTIVITY_4, 1);
+}
 
-    return list_start;
+bitmap_region_list*
+bitmap_find_all_regions_parallel(bitmap* map,
+                                 bitmap_connectivity connectivity,
+                                 unsigned int threads)
+{
+    bitmap_region_list *list;
+    label_image *image;
 
-error:
-    /* An error may happen when we have acquired a region, but are unable to
-       continue adding it to the region list. Make sure not to leak it in that
-       case. */
-    if(region_start != NULL) {
-        linked_list_free(region_start, bitmap_region, next);
-    }
+    image = bitmap_label(map, connectivity, threads);
+    if(image == NULL)
+        return NULL;
 
-    if(list_start != NULL) {
-        bitmap_region_list *iter, *iter_next;
+    list = label_image_regions(image);
+    label_image_free(image);
 
-        /* Free both the stored regions themselves, and the list entries */
-        linked_list_foreach(list_start, iter, iter_next, next) {
-            linked_list_free(iter->region, bitmap_region, next);
-            free(iter);
-        }
-    }
+    /* Keep the documented behaviour of leaving no region behind */
+    if(list != NULL)
+        memset(map->data, 0, map->stride * map->height * sizeof(*map->data));
 
-    return NULL;
+    return list;
 }
 
 char*
 bitmap_regions_print(const bitmap* map,
                      const bitmap_region_list* regions)
 {
-    const bitmap_region_list *region_cur, *region_next;
-    int row;
+    size_t r, i;
+    int row, x;
     char ch;
 
     char* regions_str;
@@ -286,7 +221,7 @@ bitmap_regions_print(const bitmap* map,
         return NULL;
 
     /* Initialize the whole string with spaces: we'll then sparingly insert the
-       newlines, and finally the region letters as we walk the lists */
+       newlines, and finally the region letters as we walk the runs */
     memset(regions_str, ' ', regions_str_size - 1);
     regions_str[regions_str_size - 1] = '\0';
 
@@ -294,12 +229,15 @@ bitmap_regions_print(const bitmap* map,
         regions_str[(row * regions_str_row_size) - 1] = '\n';
 
     ch = 'a';
-    linked_list_foreach(regions, region_cur, region_next, next) {
-        const bitmap_region *point_cur, *point_next;
+    for(r = 0; r < regions->region_count; r++) {
+        const bitmap_region *region = &regions->regions[r];
+
+        for(i = 0; i < region->run_count; i++) {
+            const bitmap_run *run = &region->runs[i];
+            char *row_str = regions_str + (run->y * regions_str_row_size);
 
-        linked_list_foreach(region_cur->region, point_cur, point_next, next) {
-            regions_str[(point_cur->y * regions_str_row_size) +
-                        (2 * point_cur->x)] = ch;
+            for(x = run->x_start; x < run->x_end; x++)
+                row_str[2 * x] = ch;
         }
 
         ch++;
@@ -312,7 +250,7 @@ bitmap*
 bitmap_read(FILE* infile)
 {
     unsigned int width, height, x, y;
-    image_bit *bitmap_data = NULL;
+    bitmap_word *row, word;
     bitmap* map = NULL;
 
     if(fscanf(infile, "%u %u", &height, &width) != 2
@@ -321,17 +259,18 @@ bitmap_read(FILE* infile)
         return NULL;
     }
 
-    map = calloc(1, sizeof(bitmap));
+    map = bitmap_new(width, height);
     if(map == NULL)
         return NULL;
 
-    bitmap_data = (image_bit*)calloc(width * height, sizeof(*bitmap_data));
-    if(bitmap_data == NULL)
-        goto error;
-
+    /* Bits are accumulated in a word and stored once it is full or the row
+       ends. The data array starts zeroed, so words without any set bits are
+       skipped. */
     x = 0; y = 0;
+    row = bitmap_row(map, 0);
+    word = 0;
     for(;;) {
-        int c = getchar();
+        int c = getc(infile);
         if(c == EOF) {
             fprintf(stderr, "ERROR: Missing bits in row %d, col %d.\n", y, x);
             goto error;
@@ -342,38 +281,33 @@ bitmap_read(FILE* infile)
 
         switch(c) {
         case '0':
-            /* The data array starts zeroed, skip a redundant assignmen */
-
-            /* bitmap_data[y * width + x] = 0; */
             break;
         case '1':
-            bitmap_data[y * width + x] = 1;
+            word |= (bitmap_word)1 << (x % BITMAP_WORD_BITS);
             break;
         default:
             fprintf(stderr, "ERROR: Invalid bitmap char '%c'.\n", c);
             goto error;
         }
 
-        if(++x >= width) {
+        if(++x % BITMAP_WORD_BITS == 0 || x >= width) {
+            row[(x - 1) / BITMAP_WORD_BITS] = word;
+            word = 0;
+        }
+
+        if(x >= width) {
             x = 0;
             if(++y >= height)
                 break;
+
+            row = bitmap_row(map, y);
         }
     }
 
-    map->width = width;
-    map->height = height;
-    map->data = bitmap_data;
-
     return map;
 
 error:
-    if(map != NULL)
-        free(map);
-
-    if(bitmap_data != NULL)
-        free(bitmap_data);
+    bitmap_free(map);
 
     return NULL;
 }
-
@@ -10,36 +10,97 @@
 #define BITMAP_H
 
 #include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
 
 /** Type representing a single bit in an image matrix */
 typedef unsigned char image_bit;
 
-/** Type for a matrix of bits */
+/** Type of a word of packed bits in a bitmap row */
+typedef uint64_t bitmap_word;
+
+/** Number of bits in a bitmap_word */
+#define BITMAP_WORD_BITS 64
+
+/**
+ * Number of words needed to hold a row of a given width
+ *
+ * @param width Width of the row, in bits
+ */
+#define BITMAP_STRIDE(width) \
+    (((size_t)(width) + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS)
+
+/**
+ * Type for a matrix of bits.
+ *
+ * Bits are packed 64 to a word, the point at x being bit (x % 64) of word
+ * (x / 64) of its row. Each row starts on a new word, and the bits past the
+ * width in the last word of a row are always zero.
+ */
 typedef struct {
     /** Width of the bitmap */
     int width;
     /** Height of the bitmap */
     int height;
-    /** Pointer to an array containing the width * height image_bit's */
-    image_bit *data;
+    /** Number of words in each row */
+    size_t stride;
+    /** Pointer to an array containing the stride * height words */
+    bitmap_word *data;
 } bitmap;
 
-/** Type representing a connected region of points in a bitmap */
-typedef struct bitmap_region {
-    /** 0-based position of the point in the x-axis */
-    int x;
-    /** 0-based position of the point in the y-axis */
+/** A horizontal run of consecutive set points in a row of a bitmap */
+typedef struct {
+    /** 0-based position of the row in the y-axis */
     int y;
-    /** Pointer to the next node in the list */
-    struct bitmap_region *next;
+    /** 0-based position of the first point of the run in the x-axis */
+    int x_start;
+    /** Position one past the last point of the run in the x-axis */
+    int x_end;
+} bitmap_run;
+
+/**
+ * Which neighbours of a point are connected to it, and so belong to the same
+ * region when set
+ */
+typedef enum {
+    /** Only the points above, below, to the left and to the right */
+    BITMAP_CONNECTIVITY_4 = 4,
+    /** The diagonal neighbours as well */
+    BITMAP_CONNECTIVITY_8 = 8
+} bitmap_connectivity;
+
+/**
+ * Type representing a connected region of points in a bitmap, as the runs
+ * of points it is made of. Iterate over its points with:
+ *
+ * @code
+ * for(i = 0; i < region->run_count; i++)
+ *     for(x = region->runs[i].x_start; x < region->runs[i].x_end; x++)
+ *         visit(x, region->runs[i].y);
+ * @endcode
+ */
+typedef struct {
+    /** Pointer to the runs of the region, in row-major order */
+    bitmap_run *runs;
+    /** Number of runs in the region */
+    size_t run_count;
+    /** Number of points in the region */
+    size_t area;
 } bitmap_region;
 
-/** Type representing a list of multiple bitmap_region's */
-typedef struct bitmap_region_list {
-    /** Pointer to a bitmap region */
-    bitmap_region *region;
-    /** Pointer to the next node in the list */
-    struct bitmap_region_list *next;
+/**
+ * Type representing all the connected regions of a bitmap. The structure,
+ * the regions and all the runs are stored in a single block of memory.
+ */
+typedef struct {
+    /** Pointer to the regions, in the order their first point was found */
+    bitmap_region *regions;
+    /** Number of regions */
+    size_t region_count;
+    /** Pointer to the runs of all regions, grouped by region */
+    bitmap_run *runs;
+    /** Total number of runs */
+    size_t run_count;
 } bitmap_region_list;
 
 /**
@@ -72,6 +133,67 @@ bitmap_setbit(bitmap *map,
               int y,
               image_bit value);
 
+/**
+ * Retrieves a pointer to the words of a row of a bitmap
+ *
+ * @param map The bitmap to use
+ * @param y   0-base coordinate of the row in the y-axis
+ *
+ * @returns Pointer to the first of the map->stride words of the row
+ */
+#define bitmap_row(map, y) ((map)->data + (size_t)(y) * (map)->stride)
+
+/**
+ * Retrieves a word of 64 packed bits from a bitmap
+ *
+ * @param map The bitmap to use
+ * @param i   0-based index of the word in the row
+ * @param y   0-base coordinate of the row in the y-axis
+ *
+ * @returns The word, or 0 if the coordinates are out of range
+ */
+bitmap_word
+bitmap_getword(const bitmap *map,
+               size_t i,
+               int y);
+
+/**
+ * Sets a word of 64 packed bits in a bitmap. Bits past the width of the
+ * bitmap are cleared.
+ *
+ * @param map   The bitmap to use
+ * @param i     0-based index of the word in the row
+ * @param y     0-base coordinate of the row in the y-axis
+ * @param value The new value of the word
+ */
+void
+bitmap_setword(bitmap *map,
+               size_t i,
+               int y,
+               bitmap_word value);
+
+/**
+ * Retrieves the mask of the valid bits of the last word of a row
+ *
+ * @param map The bitmap to use
+ *
+ * @returns A word with the bits inside the width of the bitmap set
+ */
+bitmap_word
+bitmap_last_word_mask(const bitmap *map);
+
+/**
+ * Creates a new bitmap with all bits cleared
+ *
+ * @param width  Width of the bitmap
+ * @param height Height of the bitmap
+ *
+ * @returns The new bitmap, or NULL on error
+ */
+bitmap*
+bitmap_new(int width,
+           int height);
+
 /**
  * Frees a bitmap and its associated data
  *
@@ -83,12 +205,18 @@ void
 bitmap_free(bitmap *map);
 
 /**
- * Frees a bitmap_region and its associated data
+ * Allocates a bitmap_region_list with room for a number of regions and runs.
+ * The regions' run pointers, counts and areas are left for the caller to
+ * fill.
  *
- * @param region A bitmap_region to free
+ * @param region_count Number of regions
+ * @param run_count    Total number of runs
+ *
+ * @returns The new list, or NULL on error
  */
-void
-bitmap_region_free(bitmap_region *region);
+bitmap_region_list*
+bitmap_region_list_alloc(size_t region_count,
+                         size_t run_count);
 
 /**
  * Frees a bitmap_region_list and its associated data
@@ -100,17 +228,41 @@ bitmap_region_list_free(bitmap_region_list* list);
 
 /**
  * Retrieves a list of all the connected regions from a bitmap.
+ *
+ * Regions are listed in the order their first point appears in a row-major
+ * scan, and are found by a two-pass labeling (see bitmap_label_two_pass())
+ * that runs in linear time, without recursion.
  * 
  * @warning This function is destructive: the bitmap will be completely zero-ed
- *          out after all regions are found
+ *          out after all regions are found. Use bitmap_label() and
+ *          label_image_regions() to keep it.
  *
  * @param map The bitmap to use
  *
- * @returns Pointer to the first item of the list of regions, or NULL on error
+ * @returns The list of regions, or NULL on error
  */
 bitmap_region_list*
 bitmap_find_all_regions(bitmap* map);
 
+/**
+ * Retrieves a list of all the connected regions from a bitmap, labeling it
+ * with multiple threads (see bitmap_label_parallel()). With 4-connectivity
+ * the list is the same bitmap_find_all_regions() would return.
+ *
+ * @warning This function is destructive: the bitmap will be completely zero-ed
+ *          out after all regions are found
+ *
+ * @param map          The bitmap to use
+ * @param connectivity Connectivity of the regions
+ * @param threads      Maximum number of threads to use
+ *
+ * @returns The list of regions, or NULL on error
+ */
+bitmap_region_list*
+bitmap_find_all_regions_parallel(bitmap* map,
+                                 bitmap_connectivity connectivity,
+                                 unsigned int threads);
+
 /**
  * Generates the string representation of multiple regions on a matrix.
  * The letter representing each regions starts at 'a'.
@@ -125,7 +277,8 @@ bitmap_regions_print(const bitmap* map,
                      const bitmap_region_list* regions);
 
 /**
- * Reads a bitmap from a file.
+ * Reads a bitmap from a file, one character at a time, leaving the file right
+ * after its last point. See bitmap_reader_read() for a faster reader.
  *
  * @param infile Input stream
  *
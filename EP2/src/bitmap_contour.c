@@ -0,0 +1,341 @@
+/** @file bitmap_contour.c
+ *
+ * Outer and inner contours of labeled regions, as Freeman chain codes
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "bitmap_label.h"
+#include "bitmap_contour.h"
+
+const int contour_dx[CONTOUR_DIRECTIONS] = { 1,  1,  0, -1, -1, -1,  0,  1 };
+const int contour_dy[CONTOUR_DIRECTIONS] = { 0, -1, -1, -1,  0,  1,  1,  1 };
+
+/** Direction to the right neighbour */
+#define CONTOUR_RIGHT 0
+/** Direction to the left neighbour */
+#define CONTOUR_LEFT  4
+
+/** Mark of a point that is on a contour already traced */
+#define CONTOUR_MARK_VISITED 1
+/**
+ * Mark of a point whose right neighbour was found outside its region while
+ * tracing. No hole can start there anymore.
+ */
+#define CONTOUR_MARK_RIGHT   2
+
+/**
+ * @internal
+ *
+ * Working state of the contour tracer
+ */
+typedef struct {
+    const label_image *image;
+    /** Steps between the directions searched: 1, or 2 with 4-connectivity */
+    int step;
+    /** Marks of each point, in row-major order */
+    unsigned char *marks;
+    /** The contours found so far, in the order they were found */
+    region_contour *contours;
+    size_t count, capacity;
+    /** Chain codes of the contours found so far */
+    unsigned char *codes;
+    size_t code_count, code_capacity;
+} contour_tracer__;
+
+/**
+ * @internal
+ *
+ * Appends a chain code to the last contour
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+contour_append_code__(contour_tracer__ *tracer,
+                      int direction)
+{
+    if(tracer->code_count == tracer->code_capacity) {
+        size_t new_capacity = (tracer->code_capacity != 0)
+                              ? tracer->code_capacity * 2 : 1024;
+        unsigned char *new_codes = realloc(tracer->codes, new_capacity);
+
+        if(new_codes == NULL)
+            return 0;
+
+        tracer->codes = new_codes;
+        tracer->code_capacity = new_capacity;
+    }
+
+    tracer->codes[tracer->code_count++] = (unsigned char)direction;
+    tracer->contours[tracer->count - 1].length++;
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Starts a new, empty contour
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+contour_start__(contour_tracer__ *tracer,
+                region_label region,
+                int hole,
+                int x,
+                int y)
+{
+    region_contour *contour;
+
+    if(tracer->count == tracer->capacity) {
+        size_t new_capacity = (tracer->capacity != 0)
+                              ? tracer->capacity * 2 : 64;
+        region_contour *new_contours =
+            realloc(tracer->contours, new_capacity * sizeof(*new_contours));
+
+        if(new_contours == NULL)
+            return 0;
+
+        tracer->contours = new_contours;
+        tracer->capacity = new_capacity;
+    }
+
+    contour = &tracer->contours[tracer->count++];
+    contour->region = region;
+    contour->hole = hole;
+    contour->x = x;
+    contour->y = y;
+    contour->offset = tracer->code_count;
+    contour->length = 0;
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Follows a border, starting from one of its points and a neighbour outside
+ * the region, marking the points along it
+ *
+ * @param tracer    The tracer's state
+ * @param x         x-axis coordinate of the first point
+ * @param y         y-axis coordinate of the first point
+ * @param label     The region's label
+ * @param outside   Direction to a neighbour of the first point outside the
+ *                  region
+ * @param hole      Whether the border is the one of a hole
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+contour_trace__(contour_tracer__ *tracer,
+                int x,
+                int y,
+                region_label label,
+                int outside,
+                int hole)
+{
+    const label_image *image = tracer->image;
+    int step = tracer->step, directions = CONTOUR_DIRECTIONS / step;
+    int last_x, last_y, cur_x, cur_y, back, d = 0, k;
+
+    if(!contour_start__(tracer, label, hole, x, y))
+        return 0;
+
+    /* The neighbour found clockwise from the outside is the last point of
+       the contour, as it is followed counter-clockwise */
+    for(k = 0; k < directions; k++) {
+        d = (outside - k * step) & (CONTOUR_DIRECTIONS - 1);
+        if(label_image_get(image, x + contour_dx[d], y + contour_dy[d])
+           == label)
+        {
+            break;
+        }
+    }
+
+    if(k == directions) {
+        tracer->marks[(size_t)y * image->width + x] |=
+            CONTOUR_MARK_VISITED | CONTOUR_MARK_RIGHT;
+        return 1;
+    }
+
+    last_x = x + contour_dx[d];
+    last_y = y + contour_dy[d];
+    cur_x = x;
+    cur_y = y;
+    back = d;
+
+    for(;;) {
+        int right_outside = 0, next_x, next_y;
+        unsigned char *mark;
+
+        /* Search counter-clockwise, starting after the previous point */
+        for(k = 1; k <= directions; k++) {
+            d = (back + k * step) & (CONTOUR_DIRECTIONS - 1);
+            if(label_image_get(image, cur_x + contour_dx[d],
+                               cur_y + contour_dy[d]) == label)
+            {
+                break;
+            }
+
+            if(d == CONTOUR_RIGHT)
+                right_outside = 1;
+        }
+
+        /* Only a right neighbour actually passed over here belongs to this
+           border: one across a thin part of the region may be a hole that
+           still has to be traced */
+        mark = &tracer->marks[(size_t)cur_y * image->width + cur_x];
+        *mark |= CONTOUR_MARK_VISITED;
+        if(right_outside)
+            *mark |= CONTOUR_MARK_RIGHT;
+
+        if(!contour_append_code__(tracer, d))
+            return 0;
+
+        next_x = cur_x + contour_dx[d];
+        next_y = cur_y + contour_dy[d];
+
+        if(next_x == x && next_y == y && cur_x == last_x && cur_y == last_y)
+            return 1;
+
+        back = (d + CONTOUR_DIRECTIONS / 2) & (CONTOUR_DIRECTIONS - 1);
+        cur_x = next_x;
+        cur_y = next_y;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Orders contours by region, keeping the order they were found in within
+ * each region
+ *
+ * @returns The ordered contours, or NULL on memory allocation failure
+ */
+static region_contour*
+contour_sort__(const region_contour *contours,
+               size_t count,
+               region_label region_count)
+{
+    region_contour *sorted;
+    size_t *next, i, total = 0;
+    region_label label;
+
+    sorted = malloc((count != 0 ? count : 1) * sizeof(*sorted));
+    next = calloc((size_t)region_count + 1, sizeof(*next));
+    if(sorted == NULL || next == NULL) {
+        free(sorted);
+        free(next);
+        return NULL;
+    }
+
+    for(i = 0; i < count; i++)
+        next[contours[i].region - 1]++;
+
+    for(label = 0; label < region_count; label++) {
+        size_t contour_count = next[label];
+
+        next[label] = total;
+        total += contour_count;
+    }
+
+    for(i = 0; i < count; i++)
+        sorted[next[contours[i].region - 1]++] = contours[i];
+
+    free(next);
+    return sorted;
+}
+
+region_contour_list*
+label_image_contours(const label_image *image,
+                     bitmap_connectivity connectivity)
+{
+    contour_tracer__ tracer;
+    region_contour_list *list = NULL;
+    region_label *row = NULL;
+    int x, y;
+
+    if(image == NULL || image->data == NULL)
+        return NULL;
+
+    memset(&tracer, 0, sizeof(tracer));
+    tracer.image = image;
+    tracer.step = (connectivity == BITMAP_CONNECTIVITY_8) ? 1 : 2;
+    tracer.marks = calloc((size_t)image->width * image->height, 1);
+    row = malloc((size_t)image->width * sizeof(*row));
+    list = malloc(sizeof(*list));
+
+    if(tracer.marks == NULL || row == NULL || list == NULL)
+        goto error;
+
+    for(y = 0; y < image->height; y++) {
+        const unsigned char *marks = tracer.marks + (size_t)y * image->width;
+
+        label_image_read_row(image, y, row);
+
+        for(x = 0; x < image->width; x++) {
+            region_label label = row[x];
+            int ok = 1;
+
+            if(label == 0)
+                continue;
+
+            /* A point not yet on any contour with the outside on its left
+               starts an outer contour, and one with a hole on its right
+               that wasn't passed by yet starts the contour of the hole */
+            if(!(marks[x] & CONTOUR_MARK_VISITED)
+               && (x == 0 || row[x - 1] != label))
+            {
+                ok = contour_trace__(&tracer, x, y, label, CONTOUR_LEFT, 0);
+            } else if(!(marks[x] & CONTOUR_MARK_RIGHT)
+                      && (x + 1 == image->width || row[x + 1] != label))
+            {
+                ok = contour_trace__(&tracer, x, y, label, CONTOUR_RIGHT, 1);
+            }
+
+            if(!ok)
+                goto error;
+        }
+    }
+
+    list->contours = contour_sort__(tracer.contours, tracer.count,
+                                    image->region_count);
+    if(list->contours == NULL)
+        goto error;
+
+    list->count = tracer.count;
+    list->codes = tracer.codes;
+    list->code_count = tracer.code_count;
+
+    free(tracer.contours);
+    free(tracer.marks);
+    free(row);
+
+    return list;
+
+error:
+    free(tracer.contours);
+    free(tracer.codes);
+    free(tracer.marks);
+    free(row);
+    free(list);
+
+    return NULL;
+}
+
+void
+region_contour_list_free(region_contour_list *list)
+{
+    if(list != NULL) {
+        free(list->contours);
+        free(list->codes);
+        free(list);
+    }
+}
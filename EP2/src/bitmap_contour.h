@@ -0,0 +1,94 @@
+/** @file bitmap_contour.h
+ *
+ * Outer and inner contours of labeled regions, as Freeman chain codes
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_CONTOUR_H
+#define BITMAP_CONTOUR_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+#include "bitmap_label.h"
+
+/**
+ * Number of Freeman chain code directions. Direction d moves by
+ * (contour_dx[d], contour_dy[d]): 0 is right, 2 is up, 4 is left and 6 is
+ * down, odd directions being the diagonals between them. With
+ * 4-connectivity only even directions are used.
+ */
+#define CONTOUR_DIRECTIONS 8
+
+/** Movement in the x-axis for each chain code direction */
+extern const int contour_dx[CONTOUR_DIRECTIONS];
+/** Movement in the y-axis for each chain code direction */
+extern const int contour_dy[CONTOUR_DIRECTIONS];
+
+/**
+ * A closed contour of a region: the points of the region along its border
+ * with the outside or with one of its holes
+ */
+typedef struct {
+    /** Label of the region */
+    region_label region;
+    /** 0 for the outer contour, 1 for the contour of a hole */
+    int hole;
+    /** x-axis coordinate of the first point of the contour */
+    int x;
+    /** y-axis coordinate of the first point of the contour */
+    int y;
+    /** Position of the contour's first chain code in the list's codes */
+    size_t offset;
+    /**
+     * Number of chain codes. They lead from the first point all around the
+     * contour and back to it, so a region of a single point has none.
+     */
+    size_t length;
+} region_contour;
+
+/**
+ * All the contours of a label image. Each region has its outer contour
+ * first, followed by the contours of its holes in the order they start in
+ * row-major order.
+ */
+typedef struct {
+    /** Pointer to the contours, ordered by region */
+    region_contour *contours;
+    /** Number of contours */
+    size_t count;
+    /** Chain codes of all contours, one direction per byte */
+    unsigned char *codes;
+    /** Total number of chain codes */
+    size_t code_count;
+} region_contour_list;
+
+/**
+ * Traces the outer and inner contours of every region of a label image, by
+ * Suzuki and Abe's border following. Only points along the borders are
+ * visited while tracing, so the result is proportional to the perimeter of
+ * the regions and not to their area.
+ *
+ * Outer contours go around their region counter-clockwise, as seen with the
+ * y-axis pointing down, and the contours of holes clockwise.
+ *
+ * @param image        The label image to use
+ * @param connectivity Connectivity the image was labeled with
+ *
+ * @returns The list of contours, or NULL on memory allocation failure
+ */
+region_contour_list*
+label_image_contours(const label_image *image,
+                     bitmap_connectivity connectivity);
+
+/**
+ * Frees a list of contours and its associated data
+ *
+ * @param list A list of contours to free
+ */
+void
+region_contour_list_free(region_contour_list *list);
+
+#endif /* BITMAP_CONTOUR_H */
@@ -0,0 +1,556 @@
+/** @file bitmap_dynamic.c
+ *
+ * Connected regions of a bitmap kept up to date while its points change
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "bitmap_label.h"
+#include "union_find.h"
+#include "bitmap_dynamic.h"
+
+/** Offsets of the neighbours of a point: the first 4 ones for 4-connectivity */
+static const int bitmap_dynamic_deltas__[BITMAP_DYNAMIC_MAX_NEIGHBOURS][2] = {
+    { -1,  0 }, {  1,  0 }, {  0, -1 }, {  0,  1 },
+    { -1, -1 }, {  1, -1 }, { -1,  1 }, {  1,  1 }
+};
+
+/**
+ * @internal
+ *
+ * Makes sure the sizes array has room for every label of the union-find
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+bitmap_dynamic_reserve_sizes__(bitmap_dynamic *dyn)
+{
+    size_t capacity = dyn->sizes_capacity;
+    size_t *sizes;
+
+    if(dyn->uf.count <= capacity)
+        return 1;
+
+    while(capacity < dyn->uf.count)
+        capacity *= 2;
+
+    sizes = realloc(dyn->sizes, capacity * sizeof(*sizes));
+    if(sizes == NULL)
+        return 0;
+
+    dyn->sizes = sizes;
+    dyn->sizes_capacity = capacity;
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Labels the whole bitmap from scratch, so that every region is a single
+ * label again and labels no longer in use are given back
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+bitmap_dynamic_rebuild__(bitmap_dynamic *dyn)
+{
+    size_t points = (size_t)dyn->map->width * dyn->map->height, i;
+    region_label region_count, label;
+
+    dyn->stale = 1;
+
+    if(!bitmap_label_connected(dyn->map, dyn->connectivity, dyn->labels,
+                               &region_count))
+    {
+        return 0;
+    }
+
+    union_find_clear(&dyn->uf);
+    for(label = 1; label <= region_count; label++) {
+        if(union_find_make_set(&dyn->uf) == 0)
+            return 0;
+    }
+
+    if(!bitmap_dynamic_reserve_sizes__(dyn))
+        return 0;
+
+    memset(dyn->sizes, 0, dyn->uf.count * sizeof(*dyn->sizes));
+    for(i = 0; i < points; i++)
+        dyn->sizes[dyn->labels[i]]++;
+
+    dyn->region_count = region_count;
+    dyn->stale = 0;
+
+    return 1;
+}
+
+bitmap_dynamic*
+bitmap_dynamic_new(const bitmap *map,
+                   bitmap_connectivity connectivity)
+{
+    bitmap_dynamic *dyn;
+    size_t points;
+    int i;
+
+    if(map == NULL)
+        return NULL;
+
+    dyn = malloc(sizeof(*dyn));
+    if(dyn == NULL)
+        return NULL;
+
+    points = (size_t)map->width * map->height;
+
+    dyn->connectivity = connectivity;
+    dyn->region_count = 0;
+    dyn->stale = 1;
+    dyn->epoch = 0;
+    dyn->sizes_capacity = 64;
+    dyn->sizes = malloc(dyn->sizes_capacity * sizeof(*dyn->sizes));
+    dyn->labels = malloc(points * sizeof(*dyn->labels));
+    dyn->visit_search = NULL;
+    dyn->visit_epoch = NULL;
+    for(i = 0; i < BITMAP_DYNAMIC_MAX_NEIGHBOURS; i++) {
+        dyn->queues[i] = NULL;
+        dyn->queue_capacity[i] = 0;
+    }
+
+    dyn->map = bitmap_new(map->width, map->height);
+    if(dyn->map != NULL) {
+        memcpy(dyn->map->data, map->data,
+               map->stride * map->height * sizeof(*map->data));
+    }
+
+    if(!union_find_init(&dyn->uf, 64)) {
+        dyn->uf.parent = NULL;
+        bitmap_dynamic_free(dyn);
+        return NULL;
+    }
+
+    if(dyn->sizes == NULL || dyn->labels == NULL || dyn->map == NULL
+       || !bitmap_dynamic_rebuild__(dyn))
+    {
+        bitmap_dynamic_free(dyn);
+        return NULL;
+    }
+
+    return dyn;
+}
+
+void
+bitmap_dynamic_free(bitmap_dynamic *dyn)
+{
+    int i;
+
+    if(dyn != NULL) {
+        bitmap_free(dyn->map);
+        union_find_free(&dyn->uf);
+        free(dyn->labels);
+        free(dyn->sizes);
+        free(dyn->visit_search);
+        free(dyn->visit_epoch);
+        for(i = 0; i < BITMAP_DYNAMIC_MAX_NEIGHBOURS; i++)
+            free(dyn->queues[i]);
+
+        free(dyn);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Retrieves the position of the next set neighbour of a point
+ *
+ * @param dyn   The dynamic bitmap
+ * @param x     x-axis coordinate of the point
+ * @param y     y-axis coordinate of the point
+ * @param next  Index of the first neighbour to check. Updated to the one
+ *              after the neighbour found.
+ * @param index Receives the neighbour's row-major position
+ *
+ * @returns 1 if a set neighbour was found, 0 if there are no more
+ */
+static int
+bitmap_dynamic_next_neighbour__(const bitmap_dynamic *dyn,
+                                int x,
+                                int y,
+                                int *next,
+                                size_t *index)
+{
+    while(*next < (int)dyn->connectivity) {
+        int nx = x + bitmap_dynamic_deltas__[*next][0],
+            ny = y + bitmap_dynamic_deltas__[*next][1];
+
+        (*next)++;
+
+        if(bitmap_getbit(dyn->map, nx, ny)) {
+            *index = (size_t)ny * dyn->map->width + nx;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * Adds a set point to the regions, merging those of its neighbours
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+bitmap_dynamic_add__(bitmap_dynamic *dyn,
+                     int x,
+                     int y)
+{
+    size_t index = (size_t)y * dyn->map->width + x, neighbour;
+    region_label label, root;
+    int next = 0;
+
+    label = union_find_make_set(&dyn->uf);
+    if(label == 0 || !bitmap_dynamic_reserve_sizes__(dyn))
+        return 0;
+
+    dyn->labels[index] = label;
+    dyn->sizes[label] = 1;
+    dyn->region_count++;
+
+    root = label;
+    while(bitmap_dynamic_next_neighbour__(dyn, x, y, &next, &neighbour)) {
+        region_label other = union_find_find(&dyn->uf, dyn->labels[neighbour]);
+
+        if(other != root) {
+            size_t size = dyn->sizes[root] + dyn->sizes[other];
+
+            root = union_find_union(&dyn->uf, root, other);
+            dyn->sizes[root] = size;
+            dyn->region_count--;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Finds the group a search was merged into, among the searches started from
+ * each neighbour of a cleared point. Groups are kept as a tiny union-find
+ * whose roots are the smallest search of each group.
+ */
+static int
+bitmap_dynamic_group__(const int *groups,
+                       int search)
+{
+    while(groups[search] != search)
+        search = groups[search];
+
+    return search;
+}
+
+/**
+ * @internal
+ *
+ * Appends a point to the queue of a search
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+bitmap_dynamic_push__(bitmap_dynamic *dyn,
+                      int search,
+                      size_t *len,
+                      size_t index)
+{
+    if(*len == dyn->queue_capacity[search]) {
+        size_t capacity = (*len > 0) ? *len * 2 : 64;
+        size_t *queue = realloc(dyn->queues[search],
+                                capacity * sizeof(*queue));
+
+        if(queue == NULL)
+            return 0;
+
+        dyn->queues[search] = queue;
+        dyn->queue_capacity[search] = capacity;
+    }
+
+    dyn->queues[search][(*len)++] = index;
+    dyn->visit_epoch[index] = dyn->epoch;
+    dyn->visit_search[index] = (unsigned char)search;
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Moves the points visited by a group of searches to a region of their own
+ */
+static int
+bitmap_dynamic_split__(bitmap_dynamic *dyn,
+                       region_label root,
+                       const int *groups,
+                       int group,
+                       int search_count,
+                       const size_t *lens)
+{
+    region_label label;
+    size_t size = 0, i;
+    int search;
+
+    label = union_find_make_set(&dyn->uf);
+    if(label == 0 || !bitmap_dynamic_reserve_sizes__(dyn))
+        return 0;
+
+    for(search = 0; search < search_count; search++) {
+        if(bitmap_dynamic_group__(groups, search) != group)
+            continue;
+
+        for(i = 0; i < lens[search]; i++)
+            dyn->labels[dyn->queues[search][i]] = label;
+
+        size += lens[search];
+    }
+
+    dyn->sizes[label] = size;
+    dyn->sizes[root] -= size;
+    dyn->region_count++;
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Removes a cleared point from the regions, splitting its region if the
+ * point was the only link between some of its pieces
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+bitmap_dynamic_remove__(bitmap_dynamic *dyn,
+                        int x,
+                        int y)
+{
+    size_t index = (size_t)y * dyn->map->width + x, points, neighbour;
+    size_t heads[BITMAP_DYNAMIC_MAX_NEIGHBOURS],
+           lens[BITMAP_DYNAMIC_MAX_NEIGHBOURS];
+    int groups[BITMAP_DYNAMIC_MAX_NEIGHBOURS],
+        exhausted[BITMAP_DYNAMIC_MAX_NEIGHBOURS];
+    int search_count = 0, active, next = 0, search;
+    region_label root;
+
+    root = union_find_find(&dyn->uf, dyn->labels[index]);
+    dyn->labels[index] = 0;
+
+    if(--dyn->sizes[root] == 0) {
+        dyn->region_count--;
+        return 1;
+    }
+
+    points = (size_t)dyn->map->width * dyn->map->height;
+    if(dyn->visit_epoch == NULL) {
+        dyn->visit_epoch = calloc(points, sizeof(*dyn->visit_epoch));
+        dyn->visit_search = malloc(points);
+        if(dyn->visit_epoch == NULL || dyn->visit_search == NULL) {
+            free(dyn->visit_epoch);
+            free(dyn->visit_search);
+            dyn->visit_epoch = NULL;
+            dyn->visit_search = NULL;
+            return 0;
+        }
+    }
+
+    /* Epoch 0 is never current, so every point starts out unvisited */
+    if(++dyn->epoch == 0) {
+        memset(dyn->visit_epoch, 0, points * sizeof(*dyn->visit_epoch));
+        dyn->epoch = 1;
+    }
+
+    /* Start a search from each neighbour, all of them in the same region */
+    while(bitmap_dynamic_next_neighbour__(dyn, x, y, &next, &neighbour)) {
+        groups[search_count] = search_count;
+        exhausted[search_count] = 0;
+        heads[search_count] = lens[search_count] = 0;
+
+        if(!bitmap_dynamic_push__(dyn, search_count, &lens[search_count],
+                                  neighbour))
+        {
+            return 0;
+        }
+
+        search_count++;
+    }
+
+    /* Advance each search by one point in turn. Searches that meet are
+       joined, and a group whose searches all run out of points before the
+       others is a piece of its own. The last group standing keeps the
+       region's label. */
+    active = search_count;
+    while(active > 1) {
+        for(search = 0; search < search_count && active > 1; search++) {
+            int group = bitmap_dynamic_group__(groups, search), other;
+            size_t current;
+            int px, py;
+
+            if(exhausted[group])
+                continue;
+
+            if(heads[search] == lens[search]) {
+                for(other = 0; other < search_count; other++) {
+                    if(bitmap_dynamic_group__(groups, other) == group
+                       && heads[other] < lens[other])
+                    {
+                        break;
+                    }
+                }
+
+                if(other == search_count) {
+                    if(!bitmap_dynamic_split__(dyn, root, groups, group,
+                                               search_count, lens))
+                    {
+                        return 0;
+                    }
+
+                    exhausted[group] = 1;
+                    active--;
+                }
+
+                continue;
+            }
+
+            current = dyn->queues[search][heads[search]++];
+            px = (int)(current % dyn->map->width);
+            py = (int)(current / dyn->map->width);
+
+            next = 0;
+            while(bitmap_dynamic_next_neighbour__(dyn, px, py, &next,
+                                                  &neighbour))
+            {
+                if(dyn->visit_epoch[neighbour] != dyn->epoch) {
+                    if(!bitmap_dynamic_push__(dyn, search, &lens[search],
+                                              neighbour))
+                    {
+                        return 0;
+                    }
+                } else {
+                    other = bitmap_dynamic_group__(groups,
+                                                   dyn->visit_search[neighbour]);
+
+                    if(other != group) {
+                        if(other < group) {
+                            groups[group] = other;
+                            group = other;
+                        } else {
+                            groups[other] = group;
+                        }
+
+                        active--;
+                    }
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+int
+bitmap_dynamic_setbit(bitmap_dynamic *dyn,
+                      int x,
+                      int y,
+                      image_bit value)
+{
+    size_t points = (size_t)dyn->map->width * dyn->map->height;
+    int ok;
+
+    if(x < 0 || x >= dyn->map->width || y < 0 || y >= dyn->map->height)
+        return 1;
+
+    value = (value != 0);
+    if(bitmap_getbit(dyn->map, x, y) == value)
+        return 1;
+
+    bitmap_setbit(dyn->map, x, y, value);
+
+    if(dyn->stale)
+        return bitmap_dynamic_rebuild__(dyn);
+
+    if(value)
+        ok = bitmap_dynamic_add__(dyn, x, y);
+    else
+        ok = bitmap_dynamic_remove__(dyn, x, y);
+
+    /* Labels left behind by merges and splits are only given back by
+       labeling from scratch, which is done once they outnumber the points,
+       so that its cost is spread over as many updates */
+    if(!ok || dyn->uf.count > points + 64)
+        return bitmap_dynamic_rebuild__(dyn);
+
+    return 1;
+}
+
+size_t
+bitmap_dynamic_region_count(bitmap_dynamic *dyn)
+{
+    if(dyn->stale)
+        bitmap_dynamic_rebuild__(dyn);
+
+    return dyn->region_count;
+}
+
+region_label
+bitmap_dynamic_region(bitmap_dynamic *dyn,
+                      int x,
+                      int y)
+{
+    size_t index;
+
+    if(x < 0 || x >= dyn->map->width || y < 0 || y >= dyn->map->height)
+        return 0;
+
+    if(dyn->stale)
+        bitmap_dynamic_rebuild__(dyn);
+
+    index = (size_t)y * dyn->map->width + x;
+    if(dyn->labels[index] == 0)
+        return 0;
+
+    return union_find_find(&dyn->uf, dyn->labels[index]);
+}
+
+size_t
+bitmap_dynamic_region_size(bitmap_dynamic *dyn,
+                           int x,
+                           int y)
+{
+    region_label root = bitmap_dynamic_region(dyn, x, y);
+
+    return (root != 0) ? dyn->sizes[root] : 0;
+}
+
+void
+bitmap_dynamic_region_sizes(bitmap_dynamic *dyn,
+                            size_t *sizes)
+{
+    region_label label;
+    size_t count = 0;
+
+    if(dyn->stale)
+        bitmap_dynamic_rebuild__(dyn);
+
+    /* Roots are the labels that are still their own parent and hold points;
+       labels orphaned by splits hold none */
+    for(label = 1; label < dyn->uf.count && count < dyn->region_count;
+        label++)
+    {
+        if(dyn->uf.parent[label] == label && dyn->sizes[label] > 0)
+            sizes[count++] = dyn->sizes[label];
+    }
+}
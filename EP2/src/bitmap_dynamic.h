@@ -0,0 +1,156 @@
+/** @file bitmap_dynamic.h
+ *
+ * Connected regions of a bitmap kept up to date while its points change
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_DYNAMIC_H
+#define BITMAP_DYNAMIC_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+#include "union_find.h"
+
+/** Most neighbours a point can have, with 8-connectivity */
+#define BITMAP_DYNAMIC_MAX_NEIGHBOURS 8
+
+/**
+ * A bitmap along with the labels of its regions, kept up to date as points
+ * are set and cleared.
+ *
+ * Every set point holds a label of a union-find whose sets are the regions.
+ * Setting a point only merges the sets of its neighbours. Clearing one may
+ * split its region: the pieces around the point are searched at the same
+ * time, one step each in turn, until they all meet or all but one are
+ * exhausted. Only the exhausted ones are relabeled, so the work done is
+ * proportional to the smaller pieces, not to the whole region.
+ */
+typedef struct {
+    /** The bitmap. Change it only through bitmap_dynamic_setbit(). */
+    bitmap *map;
+    /** Connectivity of the regions */
+    bitmap_connectivity connectivity;
+    /** Label of each point, in row-major order, 0 for unset points */
+    region_label *labels;
+    /** Sets of labels making up each region */
+    union_find uf;
+    /** Number of points of each region, indexed by the root of its set */
+    size_t *sizes;
+    /** Number of labels the sizes array has room for */
+    size_t sizes_capacity;
+    /** Number of regions */
+    size_t region_count;
+    /**
+     * Whether the labels must be rebuilt from scratch, after running out of
+     * memory in the middle of an update
+     */
+    int stale;
+    /** Search that visited each point last, valid if its epoch is current */
+    unsigned char *visit_search;
+    /** Search epoch in which each point was visited last */
+    region_label *visit_epoch;
+    /** Current search epoch */
+    region_label epoch;
+    /** Points visited by each search, in visiting order */
+    size_t *queues[BITMAP_DYNAMIC_MAX_NEIGHBOURS];
+    /** Number of points each queue has room for */
+    size_t queue_capacity[BITMAP_DYNAMIC_MAX_NEIGHBOURS];
+} bitmap_dynamic;
+
+/**
+ * Creates a dynamic bitmap, labeling a copy of a bitmap from scratch
+ *
+ * @param map          The bitmap to copy. It is not modified.
+ * @param connectivity Connectivity of the regions
+ *
+ * @returns The new dynamic bitmap, or NULL on memory allocation failure
+ */
+bitmap_dynamic*
+bitmap_dynamic_new(const bitmap *map,
+                   bitmap_connectivity connectivity);
+
+/**
+ * Frees a dynamic bitmap and its associated data
+ *
+ * @param dyn A dynamic bitmap to free
+ */
+void
+bitmap_dynamic_free(bitmap_dynamic *dyn);
+
+/**
+ * Sets or clears a point, updating the regions.
+ *
+ * Setting a point takes near constant time. Clearing one takes time
+ * proportional to the number of neighbours it had times the size of the
+ * pieces its region is split in, except the largest.
+ *
+ * @param dyn   The dynamic bitmap to use
+ * @param x     0-base coordinate of the point in the x-axis
+ * @param y     0-base coordinate of the point in the y-axis
+ * @param value The new value of the point
+ *
+ * @returns 1 on success, 0 on memory allocation failure. The point is
+ *          changed anyway, and the regions are labeled again from scratch as
+ *          soon as there is enough memory.
+ */
+int
+bitmap_dynamic_setbit(bitmap_dynamic *dyn,
+                      int x,
+                      int y,
+                      image_bit value);
+
+/**
+ * Retrieves the number of regions
+ *
+ * @param dyn The dynamic bitmap to use
+ *
+ * @returns The number of regions
+ */
+size_t
+bitmap_dynamic_region_count(bitmap_dynamic *dyn);
+
+/**
+ * Identifies the region a point belongs to. Identifiers stay the same until
+ * the next change to the bitmap.
+ *
+ * @param dyn The dynamic bitmap to use
+ * @param x   0-base coordinate of the point in the x-axis
+ * @param y   0-base coordinate of the point in the y-axis
+ *
+ * @returns The region's identifier, or 0 if the point is not set or the
+ *          coordinates are out of range
+ */
+region_label
+bitmap_dynamic_region(bitmap_dynamic *dyn,
+                      int x,
+                      int y);
+
+/**
+ * Retrieves the number of points of the region a point belongs to
+ *
+ * @param dyn The dynamic bitmap to use
+ * @param x   0-base coordinate of the point in the x-axis
+ * @param y   0-base coordinate of the point in the y-axis
+ *
+ * @returns The size of the region, or 0 if the point is not set or the
+ *          coordinates are out of range
+ */
+size_t
+bitmap_dynamic_region_size(bitmap_dynamic *dyn,
+                           int x,
+                           int y);
+
+/**
+ * Retrieves the sizes of all regions, in no particular order
+ *
+ * @param dyn   The dynamic bitmap to use
+ * @param sizes Array of bitmap_dynamic_region_count() sizes to fill
+ */
+void
+bitmap_dynamic_region_sizes(bitmap_dynamic *dyn,
+                            size_t *sizes);
+
+#endif /* BITMAP_DYNAMIC_H */
@@ -0,0 +1,76 @@
+/** @file bitmap_euler.c
+ *
+ * Euler number and hole counting by bit-quad counting
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stddef.h>
+
+#include "bitmap.h"
+#include "bitops.h"
+#include "bitmap_euler.h"
+
+long
+bitmap_euler_quads(const bitmap_word *upper,
+                   const bitmap_word *lower,
+                   size_t words,
+                   bitmap_connectivity connectivity)
+{
+    bitmap_word upper_carry = 0, lower_carry = 0;
+    long q1 = 0, q3 = 0, qd = 0;
+    size_t w;
+
+    /* Bit i of each word stands for the window whose right column is point
+       i of the word. One more word, all zeros, closes the right border. */
+    for(w = 0; w <= words; w++) {
+        bitmap_word q = (upper != NULL && w < words) ? upper[w] : 0,
+                    s = (lower != NULL && w < words) ? lower[w] : 0,
+                    p, r, odd, two, three;
+
+        if((q | s | upper_carry | lower_carry) == 0)
+            continue;
+
+        /* Left columns of the windows */
+        p = (q << 1) | upper_carry;
+        r = (s << 1) | lower_carry;
+        upper_carry = q >> (BITMAP_WORD_BITS - 1);
+        lower_carry = s >> (BITMAP_WORD_BITS - 1);
+
+        odd = p ^ q ^ r ^ s;
+        two = (p & q) | (r & s) | ((p | q) & (r | s));
+        three = (p & q & (r | s)) | (r & s & (p | q));
+
+        q1 += bit_popcount(odd & ~two);
+        q3 += bit_popcount(odd & three);
+        qd += bit_popcount((p & s & ~q & ~r) | (q & r & ~p & ~s));
+    }
+
+    /* Diagonal pairs join with 8-connectivity, and split the background
+       with 4-connectivity */
+    if(connectivity == BITMAP_CONNECTIVITY_8)
+        return q1 - q3 - 2 * qd;
+
+    return q1 - q3 + 2 * qd;
+}
+
+long
+bitmap_euler_number(const bitmap *map,
+                    bitmap_connectivity connectivity)
+{
+    long quads = 0;
+    int y;
+
+    if(map == NULL || map->data == NULL)
+        return 0;
+
+    for(y = 0; y <= map->height; y++) {
+        quads += bitmap_euler_quads(y > 0 ? bitmap_row(map, y - 1) : NULL,
+                                    y < map->height ? bitmap_row(map, y)
+                                                    : NULL,
+                                    map->stride, connectivity);
+    }
+
+    return quads / 4;
+}
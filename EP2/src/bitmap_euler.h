@@ -0,0 +1,56 @@
+/** @file bitmap_euler.h
+ *
+ * Euler number and hole counting by bit-quad counting
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_EULER_H
+#define BITMAP_EULER_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+
+/**
+ * Counts the bit-quads (2x2 windows) between two consecutive rows of a
+ * bitmap, including the windows hanging over the left and right borders.
+ *
+ * Summing this over every pair of consecutive rows, plus the pairs formed
+ * with an empty row above the first one and below the last one, gives four
+ * times the Euler number of the bitmap: the number of regions minus the
+ * number of holes in them.
+ *
+ * @param upper        The words of the upper row, or NULL for an empty row
+ * @param lower        The words of the lower row, or NULL for an empty row
+ * @param words        Number of words in each row. Bits past the width must
+ *                     be zero.
+ * @param connectivity Connectivity of the regions. The holes are connected
+ *                     the other way.
+ *
+ * @returns Q1 - Q3 + 2 * QD with 4-connectivity, Q1 - Q3 - 2 * QD with
+ *          8-connectivity, where Q1 and Q3 are the number of windows with
+ *          exactly 1 and 3 points set and QD the number with only 2
+ *          diagonally opposite points set
+ */
+long
+bitmap_euler_quads(const bitmap_word *upper,
+                   const bitmap_word *lower,
+                   size_t words,
+                   bitmap_connectivity connectivity);
+
+/**
+ * Computes the Euler number of a bitmap in a single pass over its rows,
+ * without labeling it
+ *
+ * @param map          The bitmap to use
+ * @param connectivity Connectivity of the regions
+ *
+ * @returns The number of regions minus the number of holes in them
+ */
+long
+bitmap_euler_number(const bitmap *map,
+                    bitmap_connectivity connectivity);
+
+#endif /* BITMAP_EULER_H */
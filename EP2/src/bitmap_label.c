@@ -0,0 +1,736 @@
+/** @file bitmap_label.c
+ *
+ * Connected component labeling of bitmaps
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "union_find.h"
+#include "parallel.h"
+#include "bitmap_label.h"
+
+/**
+ * Number of strips given to each thread by bitmap_label_parallel(). Using a
+ * few per thread evens out strips that take longer than others.
+ */
+#define STRIPS_PER_THREAD 4
+
+/** State shared by the tasks of bitmap_label_parallel() */
+typedef struct {
+    const bitmap *map;
+    region_label *labels;
+    /** Connectivity of the regions */
+    bitmap_connectivity connectivity;
+    /** Number of strips */
+    size_t strip_count;
+    /** Number of rows in each strip but the last one */
+    int strip_height;
+    /** Number of regions found in each strip */
+    region_label *strip_regions;
+    /** Offset of each strip's labels in the merged label space */
+    region_label *strip_offsets;
+    /** Final label of every label in the merged label space */
+    const region_label *final_labels;
+    /** Set for each strip that fails to be labeled. Each task only writes
+        its own strip's entry, so they are read once all tasks are done. */
+    unsigned char *strip_failed;
+} strip_labeling;
+
+/**
+ * @internal
+ *
+ * Creates a view of some rows of a bitmap, sharing its data
+ */
+static void
+bitmap_label_strip_view__(const strip_labeling *state,
+                          size_t strip,
+                          bitmap *view,
+                          size_t *label_offset)
+{
+    const bitmap *map = state->map;
+    int y_start = (int)strip * state->strip_height,
+        y_end = y_start + state->strip_height;
+
+    if(strip == state->strip_count - 1)
+        y_end = map->height;
+
+    view->width = map->width;
+    view->height = y_end - y_start;
+    view->stride = map->stride;
+    view->data = bitmap_row(map, y_start);
+
+    *label_offset = (size_t)y_start * map->width;
+}
+
+/**
+ * @internal
+ *
+ * Task labeling a single strip with labels local to it
+ */
+static void
+bitmap_label_strip__(void *arg,
+                     size_t strip)
+{
+    strip_labeling *state = arg;
+    bitmap view;
+    size_t offset;
+
+    bitmap_label_strip_view__(state, strip, &view, &offset);
+
+    if(!bitmap_label_connected(&view, state->connectivity,
+                               state->labels + offset,
+                               &state->strip_regions[strip]))
+    {
+        state->strip_failed[strip] = 1;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Task rewriting the local labels of a single strip to final labels
+ */
+static void
+bitmap_label_strip_finish__(void *arg,
+                            size_t strip)
+{
+    strip_labeling *state = arg;
+    region_label *labels, base = state->strip_offsets[strip];
+    bitmap view;
+    size_t offset, i, size;
+
+    bitmap_label_strip_view__(state, strip, &view, &offset);
+
+    labels = state->labels + offset;
+    size = (size_t)view.width * view.height;
+
+    for(i = 0; i < size; i++) {
+        if(labels[i] != 0)
+            labels[i] = state->final_labels[base + labels[i]];
+    }
+}
+
+int
+bitmap_label_two_pass(const bitmap *map,
+                      region_label *labels,
+                      region_label *region_count)
+{
+    union_find uf;
+    size_t width, height, x, y, i, size, w;
+
+    if(map == NULL || map->data == NULL || labels == NULL)
+        return 0;
+
+    width = map->width;
+    height = map->height;
+    size = width * height;
+
+    if(!union_find_init(&uf, width + 1))
+        return 0;
+
+    /* First pass: provisional labels. With 4-connectivity only the upper (q)
+       and left (p) neighbours have been visited, which makes for a tiny
+       decision tree: q decides the label if set, merging p into it when both
+       are set; otherwise p decides; otherwise a new label starts. */
+    for(y = 0, i = 0; y < height; y++) {
+        const bitmap_word *row = bitmap_row(map, y);
+
+        for(w = 0; w < map->stride; w++) {
+            bitmap_word word = row[w];
+            size_t x_end = (w + 1) * BITMAP_WORD_BITS;
+
+            if(x_end > width)
+                x_end = width;
+
+            /* Whole words of background need no decisions */
+            if(word == 0) {
+                for(x = w * BITMAP_WORD_BITS; x < x_end; x++, i++)
+                    labels[i] = 0;
+
+                continue;
+            }
+
+            for(x = w * BITMAP_WORD_BITS; x < x_end; x++, i++, word >>= 1) {
+                region_label p, q;
+
+                if((word & 1) == 0) {
+                    labels[i] = 0;
+                    continue;
+                }
+
+                q = (y > 0) ? labels[i - width] : 0;
+                p = (x > 0) ? labels[i - 1] : 0;
+
+                if(q != 0) {
+                    if(p != 0 && p != q)
+                        union_find_union(&uf, p, q);
+
+                    labels[i] = q;
+                } else if(p != 0) {
+                    labels[i] = p;
+                } else {
+                    labels[i] = union_find_make_set(&uf);
+                    if(labels[i] == 0) {
+                        union_find_free(&uf);
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+
+    /* Roots are the smallest provisional label of each set, and provisional
+       labels are handed out in scan order, so flattening numbers the regions
+       in the order their first point was found. */
+    *region_count = union_find_flatten(&uf);
+
+    /* Second pass: final labels */
+    for(i = 0; i < size; i++)
+        labels[i] = uf.parent[labels[i]];
+
+    union_find_free(&uf);
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Retrieves the pair of points starting at an even column of a row: the left
+ * one in bit 0, the right one in bit 1. Pairs never straddle two words.
+ */
+#define bitmap_label_pair__(row, x) \
+    ((unsigned int)((row)[(x) / BITMAP_WORD_BITS] \
+                    >> ((x) % BITMAP_WORD_BITS)) & 3)
+
+/**
+ * @internal
+ *
+ * Retrieves a single point of a row, which may be past its end
+ */
+#define bitmap_label_point__(row, x, width) \
+    (((x) < (width)) \
+     ? (unsigned int)((row)[(x) / BITMAP_WORD_BITS] \
+                      >> ((x) % BITMAP_WORD_BITS)) & 1 \
+     : 0)
+
+int
+bitmap_label_blocks(const bitmap *map,
+                    region_label *labels,
+                    region_label *region_count)
+{
+    union_find uf;
+    region_label *block_labels = NULL, *final_labels = NULL, next = 0;
+    size_t width, height, x, y;
+    int ok = 0;
+
+    if(map == NULL || map->data == NULL || labels == NULL)
+        return 0;
+
+    width = map->width;
+    height = map->height;
+
+    if(!union_find_init(&uf, width / 2 + 1))
+        return 0;
+
+    /* First pass: a provisional label for each 2x2 block with any set point,
+       stored in the labels of its top-left point. All set points of a block
+       are connected to each other, so only blocks are ever decided on: a
+       neighbouring block is connected to the current one X when
+         - P (up-left):  its bottom-right point and X's top-left one are set
+         - Q (up):       any of its bottom points and of X's top points are
+         - R (up-right): its bottom-left point and X's top-right one are set
+         - S (left):     any of its right points and of X's left points are
+       which takes at most 4 reads of packed pairs of points per block. */
+    for(y = 0; y < height; y += 2) {
+        const bitmap_word *row = bitmap_row(map, y),
+                          *below = (y + 1 < height) ? bitmap_row(map, y + 1)
+                                                    : NULL,
+                          *above = (y > 0) ? bitmap_row(map, y - 1) : NULL;
+        region_label *block = labels + y * width;
+
+        for(x = 0; x < width; x += 2) {
+            unsigned int top = bitmap_label_pair__(row, x),
+                         bottom = (below != NULL)
+                                  ? bitmap_label_pair__(below, x) : 0;
+            region_label label = 0, neighbour;
+
+            if((top | bottom) == 0) {
+                block[x] = 0;
+                continue;
+            }
+
+            if(above != NULL && top != 0) {
+                /* Q first: when it connects it is usually the only one */
+                if(bitmap_label_pair__(above, x) != 0)
+                    label = block[x - 2 * width];
+
+                if((top & 1) && x > 0
+                   && bitmap_label_point__(above, x - 1, width))
+                {
+                    neighbour = block[x - 2 * width - 2];
+                    if(label == 0)
+                        label = neighbour;
+                    else if(neighbour != label)
+                        label = union_find_union(&uf, label, neighbour);
+                }
+
+                if((top & 2) && bitmap_label_point__(above, x + 2, width)) {
+                    neighbour = block[x - 2 * width + 2];
+                    if(label == 0)
+                        label = neighbour;
+                    else if(neighbour != label)
+                        label = union_find_union(&uf, label, neighbour);
+                }
+            }
+
+            if(x > 0 && ((top | bottom) & 1)
+               && (bitmap_label_point__(row, x - 1, width)
+                   || (below != NULL
+                       && bitmap_label_point__(below, x - 1, width))))
+            {
+                neighbour = block[x - 2];
+                if(label == 0)
+                    label = neighbour;
+                else if(neighbour != label)
+                    label = union_find_union(&uf, label, neighbour);
+            }
+
+            if(label == 0) {
+                label = union_find_make_set(&uf);
+                if(label == 0)
+                    goto out;
+            }
+
+            block[x] = label;
+        }
+    }
+
+    union_find_flatten(&uf);
+
+    /* Second pass: spread each block's label to its set points, a pair of
+       rows at a time. Blocks are visited in a different order than points
+       are, so the final labels are renumbered by first point on the way. */
+    block_labels = malloc((width / 2 + 1) * sizeof(*block_labels));
+    final_labels = calloc(uf.count, sizeof(*final_labels));
+    if(block_labels == NULL || final_labels == NULL)
+        goto out;
+
+    for(y = 0; y < height; y += 2) {
+        size_t dy;
+
+        for(x = 0; x < width; x += 2)
+            block_labels[x / 2] = uf.parent[labels[y * width + x]];
+
+        for(dy = 0; dy < 2 && y + dy < height; dy++) {
+            const bitmap_word *row = bitmap_row(map, y + dy);
+            region_label *out = labels + (y + dy) * width;
+
+            for(x = 0; x < width; x++) {
+                region_label label = block_labels[x / 2];
+
+                if(label == 0 || !bitmap_label_point__(row, x, width)) {
+                    out[x] = 0;
+                    continue;
+                }
+
+                if(final_labels[label] == 0)
+                    final_labels[label] = ++next;
+
+                out[x] = final_labels[label];
+            }
+        }
+    }
+
+    *region_count = next;
+    ok = 1;
+
+out:
+    free(block_labels);
+    free(final_labels);
+    union_find_free(&uf);
+
+    return ok;
+}
+
+int
+bitmap_label_connected(const bitmap *map,
+                       bitmap_connectivity connectivity,
+                       region_label *labels,
+                       region_label *region_count)
+{
+    if(connectivity == BITMAP_CONNECTIVITY_8)
+        return bitmap_label_blocks(map, labels, region_count);
+
+    return bitmap_label_two_pass(map, labels, region_count);
+}
+
+int
+bitmap_label_parallel(const bitmap *map,
+                      bitmap_connectivity connectivity,
+                      region_label *labels,
+                      region_label *region_count,
+                      unsigned int threads)
+{
+    strip_labeling state;
+    union_find uf;
+    size_t strip, width, x;
+    region_label total = 0, label;
+    int ok = 0;
+
+    if(map == NULL || map->data == NULL || labels == NULL)
+        return 0;
+
+    if(threads <= 1 || map->height < 4)
+        return bitmap_label_connected(map, connectivity, labels, region_count);
+
+    width = map->width;
+
+    state.map = map;
+    state.labels = labels;
+    state.connectivity = connectivity;
+    state.strip_count = (size_t)threads * STRIPS_PER_THREAD;
+    if(state.strip_count > (size_t)map->height / 2)
+        state.strip_count = map->height / 2;
+    state.strip_height = map->height / state.strip_count;
+
+    /* Blocks of 2x2 points must not be split between strips */
+    if(connectivity == BITMAP_CONNECTIVITY_8) {
+        state.strip_height += state.strip_height % 2;
+        state.strip_count = (map->height + state.strip_height - 1)
+                            / state.strip_height;
+    }
+
+    state.strip_regions = calloc(state.strip_count,
+                                 sizeof(*state.strip_regions));
+    state.strip_offsets = calloc(state.strip_count,
+                                 sizeof(*state.strip_offsets));
+    state.strip_failed = calloc(state.strip_count,
+                                sizeof(*state.strip_failed));
+    if(state.strip_regions == NULL || state.strip_offsets == NULL
+       || state.strip_failed == NULL)
+    {
+        goto out;
+    }
+
+    /* Label all strips independently */
+    parallel_run(bitmap_label_strip__, &state, state.strip_count, threads);
+    for(strip = 0; strip < state.strip_count; strip++) {
+        if(state.strip_failed[strip])
+            goto out;
+    }
+
+    /* Give each strip a range of labels in a common label space, in strip
+       order. As each strip numbers its regions in scan order, the common
+       labels are still ordered by the position of each region's first
+       point. */
+    for(strip = 0; strip < state.strip_count; strip++) {
+        state.strip_offsets[strip] = total;
+        total += state.strip_regions[strip];
+    }
+
+    if(!union_find_init(&uf, total + 1))
+        goto out;
+
+    for(label = 0; label < total; label++)
+        union_find_make_set(&uf);
+
+    /* Merge the regions touching across each boundary. The union-find keeps
+       the smallest label as the root, so flattening it numbers regions by
+       their first point, exactly as a sequential scan would. */
+    for(strip = 1; strip < state.strip_count; strip++) {
+        size_t y = strip * state.strip_height;
+        const region_label *above = labels + (y - 1) * width,
+                           *below = labels + y * width;
+        region_label above_base = state.strip_offsets[strip - 1],
+                     below_base = state.strip_offsets[strip];
+
+        for(x = 0; x < width; x++) {
+            size_t dx_start, dx_end, dx;
+
+            if(above[x] == 0)
+                continue;
+
+            /* With 8-connectivity the diagonal neighbours count as well */
+            dx_start = (connectivity == BITMAP_CONNECTIVITY_8 && x > 0)
+                       ? x - 1 : x;
+            dx_end = (connectivity == BITMAP_CONNECTIVITY_8 && x + 1 < width)
+                     ? x + 1 : x;
+
+            for(dx = dx_start; dx <= dx_end; dx++) {
+                if(below[dx] != 0) {
+                    union_find_union(&uf, above_base + above[x],
+                                     below_base + below[dx]);
+                }
+            }
+        }
+    }
+
+    *region_count = union_find_flatten(&uf);
+
+    state.final_labels = uf.parent;
+    parallel_run(bitmap_label_strip_finish__, &state, state.strip_count,
+                 threads);
+
+    union_find_free(&uf);
+    ok = 1;
+
+out:
+    free(state.strip_regions);
+    free(state.strip_offsets);
+    free(state.strip_failed);
+
+    return ok;
+}
+
+label_image*
+label_image_wrap(region_label *labels,
+                 int width,
+                 int height,
+                 region_label region_count)
+{
+    label_image *image;
+    size_t i, size = (size_t)width * height;
+    void *data;
+
+    image = malloc(sizeof(*image));
+    if(image == NULL) {
+        free(labels);
+        return NULL;
+    }
+
+    image->region_count = region_count;
+
+    /* Each narrow label is written at or before the wide one it comes from,
+       which was already read. The narrow labels are copied in as bytes, so
+       the buffer is never accessed as two different types at once. */
+    if(region_count <= UINT8_MAX) {
+        unsigned char *narrow = (unsigned char*)labels;
+
+        for(i = 0; i < size; i++) {
+            uint8_t label = (uint8_t)labels[i];
+            memcpy(narrow + i * sizeof(label), &label, sizeof(label));
+        }
+
+        image->label_size = sizeof(uint8_t);
+    } else if(region_count <= UINT16_MAX) {
+        unsigned char *narrow = (unsigned char*)labels;
+
+        for(i = 0; i < size; i++) {
+            uint16_t label = (uint16_t)labels[i];
+            memcpy(narrow + i * sizeof(label), &label, sizeof(label));
+        }
+
+        image->label_size = sizeof(uint16_t);
+    } else {
+        image->label_size = sizeof(uint32_t);
+    }
+
+    /* Give back the memory the narrowing freed up */
+    data = realloc(labels, size * image->label_size);
+    image->data = (data != NULL) ? data : labels;
+
+    image->width = width;
+    image->height = height;
+
+    return image;
+}
+
+label_image*
+bitmap_label(const bitmap *map,
+             bitmap_connectivity connectivity,
+             unsigned int threads)
+{
+    region_label *labels, region_count;
+
+    if(map == NULL || map->data == NULL)
+        return NULL;
+
+    /* Provisional labels need the full width. Once the number of regions is
+       known, the labels are narrowed in place. */
+    labels = malloc((size_t)map->width * map->height * sizeof(*labels));
+    if(labels == NULL
+       || !bitmap_label_parallel(map, connectivity, labels, &region_count,
+                                 threads))
+    {
+        free(labels);
+        return NULL;
+    }
+
+    return label_image_wrap(labels, map->width, map->height, region_count);
+}
+
+label_image*
+label_image_from_regions(const bitmap_region_list *regions,
+                         int width,
+                         int height)
+{
+    region_label *labels;
+    size_t i, j;
+    int x;
+
+    if(regions == NULL || width <= 0 || height <= 0)
+        return NULL;
+
+    labels = calloc((size_t)width * height, sizeof(*labels));
+    if(labels == NULL)
+        return NULL;
+
+    for(i = 0; i < regions->region_count; i++) {
+        const bitmap_region *region = &regions->regions[i];
+
+        for(j = 0; j < region->run_count; j++) {
+            const bitmap_run *run = &region->runs[j];
+            region_label *row = labels + (size_t)run->y * width;
+
+            for(x = run->x_start; x < run->x_end; x++)
+                row[x] = (region_label)(i + 1);
+        }
+    }
+
+    return label_image_wrap(labels, width, height,
+                            (region_label)regions->region_count);
+}
+
+void
+label_image_free(label_image *image)
+{
+    if(image != NULL) {
+        free(image->data);
+        free(image);
+    }
+}
+
+region_label
+label_image_get(const label_image *image,
+                int x,
+                int y)
+{
+    size_t i;
+
+    if(image == NULL || image->data == NULL
+       || x < 0 || x >= image->width
+       || y < 0 || y >= image->height)
+    {
+        return 0;
+    }
+
+    i = (size_t)y * image->width + x;
+
+    switch(image->label_size) {
+    case sizeof(uint8_t):
+        return ((const uint8_t*)image->data)[i];
+    case sizeof(uint16_t):
+        return ((const uint16_t*)image->data)[i];
+    default:
+        return ((const uint32_t*)image->data)[i];
+    }
+}
+
+void
+label_image_read_row(const label_image *image,
+                     int y,
+                     region_label *out)
+{
+    size_t i, width = image->width,
+           start = (size_t)y * width;
+
+    switch(image->label_size) {
+    case sizeof(uint8_t):
+        for(i = 0; i < width; i++)
+            out[i] = ((const uint8_t*)image->data)[start + i];
+        break;
+    case sizeof(uint16_t):
+        for(i = 0; i < width; i++)
+            out[i] = ((const uint16_t*)image->data)[start + i];
+        break;
+    default:
+        for(i = 0; i < width; i++)
+            out[i] = ((const uint32_t*)image->data)[start + i];
+        break;
+    }
+}
+
+bitmap_region_list*
+label_image_regions(const label_image *image)
+{
+    bitmap_region_list *list = NULL;
+    region_label *row = NULL, label, region_count;
+    size_t *next_run = NULL, run_count = 0, x, width;
+    int y;
+
+    if(image == NULL || image->data == NULL)
+        return NULL;
+
+    width = image->width;
+    region_count = image->region_count;
+
+    /* Count the runs of each label first, so all of them fit in one block */
+    row = malloc(width * sizeof(*row));
+    next_run = calloc(region_count + 1, sizeof(*next_run));
+    if(row == NULL || next_run == NULL)
+        goto out;
+
+    for(y = 0; y < image->height; y++) {
+        label_image_read_row(image, y, row);
+
+        for(x = 0; x < width; x++) {
+            if(row[x] != 0 && (x == 0 || row[x - 1] != row[x])) {
+                next_run[row[x]]++;
+                run_count++;
+            }
+        }
+    }
+
+    list = bitmap_region_list_alloc(region_count, run_count);
+    if(list == NULL)
+        goto out;
+
+    /* Lay out the regions' runs one after another, and turn the counts into
+       the position of each region's next run */
+    run_count = 0;
+    for(label = 1; label <= region_count; label++) {
+        bitmap_region *region = &list->regions[label - 1];
+
+        region->runs = list->runs + run_count;
+        region->run_count = next_run[label];
+        region->area = 0;
+
+        next_run[label] = run_count;
+        run_count += region->run_count;
+    }
+
+    for(y = 0; y < image->height; y++) {
+        label_image_read_row(image, y, row);
+
+        for(x = 0; x < width; ) {
+            size_t x_start = x;
+            bitmap_run *run;
+
+            label = row[x];
+            while(x < width && row[x] == label)
+                x++;
+
+            if(label == 0)
+                continue;
+
+            run = &list->runs[next_run[label]++];
+            run->y = y;
+            run->x_start = (int)x_start;
+            run->x_end = (int)x;
+
+            list->regions[label - 1].area += x - x_start;
+        }
+    }
+
+out:
+    free(next_run);
+    free(row);
+
+    return list;
+}
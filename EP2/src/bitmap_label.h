@@ -0,0 +1,213 @@
+/** @file bitmap_label.h
+ *
+ * Connected component labeling of bitmaps
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_LABEL_H
+#define BITMAP_LABEL_H
+
+#include "bitmap.h"
+#include "union_find.h"
+
+/**
+ * Labels the 4-connected regions of a bitmap with a two-pass scan.
+ *
+ * The first pass gives every set point a provisional label taken from its
+ * upper or left neighbour (SAUF decision tree), recording equivalences in a
+ * union-find. The second pass replaces the provisional labels by final ones.
+ * Regions are numbered from 1 in the order their first point is found in a
+ * row-major scan, and the background gets label 0.
+ *
+ * Runs in time linear to the number of points, without recursion.
+ *
+ * @param map          The bitmap to use. It is not modified.
+ * @param labels       Array of width * height labels to fill
+ * @param region_count Pointer that will receive the number of regions found
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+bitmap_label_two_pass(const bitmap *map,
+                      region_label *labels,
+                      region_label *region_count);
+
+/**
+ * Labels the 8-connected regions of a bitmap with a two-pass scan over blocks
+ * of 2x2 points.
+ *
+ * All set points of a block are connected to each other, so the first pass
+ * only decides on a provisional label per block, from the blocks above and to
+ * the left of it, reading the few points that can connect them. The second
+ * pass gives every set point its block's final label. Regions are numbered
+ * as in bitmap_label_two_pass().
+ *
+ * @param map          The bitmap to use. It is not modified.
+ * @param labels       Array of width * height labels to fill
+ * @param region_count Pointer that will receive the number of regions found
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+bitmap_label_blocks(const bitmap *map,
+                    region_label *labels,
+                    region_label *region_count);
+
+/**
+ * Labels the regions of a bitmap with the given connectivity, with
+ * bitmap_label_two_pass() or bitmap_label_blocks()
+ *
+ * @param map          The bitmap to use. It is not modified.
+ * @param connectivity Connectivity of the regions
+ * @param labels       Array of width * height labels to fill
+ * @param region_count Pointer that will receive the number of regions found
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+bitmap_label_connected(const bitmap *map,
+                       bitmap_connectivity connectivity,
+                       region_label *labels,
+                       region_label *region_count);
+
+/**
+ * Labels the regions of a bitmap using multiple threads.
+ *
+ * The bitmap is split in horizontal strips, each labeled on its own by
+ * bitmap_label_connected(). The strips' labels are then merged along the
+ * strip boundaries with a union-find over all of them, and finally rewritten
+ * in parallel. The result is exactly the same as bitmap_label_connected()'s.
+ *
+ * @param map          The bitmap to use. It is not modified.
+ * @param connectivity Connectivity of the regions
+ * @param labels       Array of width * height labels to fill
+ * @param region_count Pointer that will receive the number of regions found
+ * @param threads      Maximum number of threads to use
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+bitmap_label_parallel(const bitmap *map,
+                      bitmap_connectivity connectivity,
+                      region_label *labels,
+                      region_label *region_count,
+                      unsigned int threads);
+
+/**
+ * Dense image of region labels, one per point of a bitmap. Labels are stored
+ * in the narrowest of 8, 16 or 32 bits that fits the number of regions.
+ */
+typedef struct {
+    /** Width of the image */
+    int width;
+    /** Height of the image */
+    int height;
+    /** Number of regions. Labels go from 1 to it, 0 being the background. */
+    region_label region_count;
+    /** Size of each label, in bytes: 1, 2 or 4 */
+    unsigned int label_size;
+    /**
+     * Pointer to the width * height labels, in row-major order, as uint8_t,
+     * uint16_t or uint32_t depending on label_size
+     */
+    void *data;
+} label_image;
+
+/**
+ * Labels the regions of a bitmap, leaving the bitmap untouched. Labels are
+ * the same as bitmap_label_connected() gives.
+ *
+ * @param map          The bitmap to use
+ * @param connectivity Connectivity of the regions
+ * @param threads      Maximum number of threads to use (see
+ *                     bitmap_label_parallel())
+ *
+ * @returns The label image, or NULL on error
+ */
+label_image*
+bitmap_label(const bitmap *map,
+             bitmap_connectivity connectivity,
+             unsigned int threads);
+
+/**
+ * Turns an array of full-width labels into a label image, narrowing them in
+ * place to the fewest bits that fit the number of regions
+ *
+ * @param labels       Array of width * height labels, allocated with
+ *                     malloc(). The label image takes it over, and it is
+ *                     freed on errors.
+ * @param width        Width of the image
+ * @param height       Height of the image
+ * @param region_count Number of regions
+ *
+ * @returns The label image, or NULL on memory allocation failure
+ */
+label_image*
+label_image_wrap(region_label *labels,
+                 int width,
+                 int height,
+                 region_label region_count);
+
+/**
+ * Builds the label image of a list of regions, labeling the points of each
+ * region with its position in the list, starting from 1
+ *
+ * @param regions The list of regions
+ * @param width   Width of the image
+ * @param height  Height of the image
+ *
+ * @returns The label image, or NULL on memory allocation failure
+ */
+label_image*
+label_image_from_regions(const bitmap_region_list *regions,
+                         int width,
+                         int height);
+
+/**
+ * Frees a label image and its associated data
+ *
+ * @param image A label image to free
+ */
+void
+label_image_free(label_image *image);
+
+/**
+ * Retrieves the label of a single point of a label image
+ *
+ * @param image The label image to use
+ * @param x     0-base coordinate of the point in the x-axis
+ * @param y     0-base coordinate of the point in the y-axis
+ *
+ * @returns The label, or 0 if the coordinates are out of range
+ */
+region_label
+label_image_get(const label_image *image,
+                int x,
+                int y);
+
+/**
+ * Copies a row of a label image to an array of full-width labels
+ *
+ * @param image The label image to use
+ * @param y     0-base coordinate of the row in the y-axis
+ * @param out   Array of image->width labels to fill
+ */
+void
+label_image_read_row(const label_image *image,
+                     int y,
+                     region_label *out);
+
+/**
+ * Builds the list of regions of a label image, grouping the points of each
+ * label into runs.
+ *
+ * @param image The label image to use
+ *
+ * @returns The list of regions, in label order, or NULL on error
+ */
+bitmap_region_list*
+label_image_regions(const label_image *image);
+
+#endif /* BITMAP_LABEL_H */
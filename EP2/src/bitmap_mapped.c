@@ -0,0 +1,692 @@
+/** @file bitmap_mapped.c
+ *
+ * Out-of-core labeling of memory-mapped PBM images, one tile at a time, into
+ * memory-mapped label files
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#if defined(HAVE_MMAP)
+#define _POSIX_C_SOURCE 200112L
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "bitmap_runs.h"
+#include "bitmap_pbm.h"
+#include "union_find.h"
+#include "bitmap_mapped.h"
+
+/** Size of the header of the label file: five 32-bit integers */
+#define PBM_MAPPED_HEADER_SIZE 20
+
+/**
+ * Label file being written, mapped in memory a row of tiles at a time when
+ * possible
+ */
+typedef struct {
+#if defined(HAVE_MMAP)
+    /** The open file */
+    int fd;
+    /** Start of the mapped part of the file, or NULL */
+    unsigned char *window;
+    /** Position of the mapped part in the file */
+    size_t window_start;
+    /** Size of the mapped part */
+    size_t window_size;
+#else
+    /** The open file */
+    FILE *file;
+#endif
+} pbm_mapped_output;
+
+/** State of the labeling of an image, kept from one tile to the next */
+typedef struct {
+    const pbm_image *image;
+    /** Width and height of the tiles */
+    int tile_size;
+    /** Number of tiles in each row of tiles */
+    int tiles_x;
+    /** Number of rows of tiles */
+    int tiles_y;
+    /** Connectivity of the regions */
+    bitmap_connectivity connectivity;
+    /** 1 if diagonal neighbours are connected, 0 otherwise */
+    int reach;
+    /** 0 while merging regions across tiles, 1 while writing the labels */
+    int writing;
+
+    /** The points of the tile being labeled */
+    bitmap tile;
+    /** Runs of the tile, row by row, and the regions of the tile */
+    bitmap_run_scan scan;
+    /** Position of the first run of each row of the tile, and the end */
+    size_t *row_first;
+    /**
+     * Region crossing tile borders each region of the tile belongs to, or 0,
+     * and then its final label while writing
+     */
+    region_label *entries;
+
+    /** Sets of the regions crossing tile borders */
+    union_find global;
+    /** Entry of each point of the bottom row of the tiles above, or 0 */
+    region_label *above;
+    /** Entry of each point of the bottom row of the current tiles, or 0 */
+    region_label *below;
+    /** Entry of each point of the right column of the tile to the left */
+    region_label *left;
+    /** Number of entries given out so far while writing */
+    region_label entry_count;
+    /** Final label of each set of the global union-find, or 0 */
+    region_label *set_labels;
+    /** Number of regions that never cross a tile border */
+    size_t inner_count;
+    /** Number of final labels given out so far */
+    region_label label_count;
+
+    /** Size of each label in the output, in bytes */
+    unsigned int label_size;
+    /** Header of the label file */
+    unsigned char header[PBM_MAPPED_HEADER_SIZE];
+    pbm_mapped_output output;
+} pbm_mapped_state;
+
+/**
+ * @internal
+ *
+ * Creates the label file with its final size
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+pbm_mapped_open__(pbm_mapped_output *output,
+                  const char *path,
+                  size_t size)
+{
+#if defined(HAVE_MMAP)
+    output->window = NULL;
+    output->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(output->fd < 0)
+        return 0;
+
+    if(ftruncate(output->fd, (off_t)size) != 0) {
+        close(output->fd);
+        return 0;
+    }
+#else
+    (void)size;
+
+    output->file = fopen(path, "wb");
+    if(output->file == NULL)
+        return 0;
+#endif
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Maps the part of the label file that is going to be written next,
+ * unmapping the previous one. The kernel writes unmapped parts back on its
+ * own, so only one part at a time is held in memory.
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+pbm_mapped_window__(pbm_mapped_output *output,
+                    size_t offset,
+                    size_t size)
+{
+#if defined(HAVE_MMAP)
+    size_t page = (size_t)sysconf(_SC_PAGESIZE),
+           start = offset - offset % page;
+    void *window;
+
+    if(output->window != NULL) {
+        munmap(output->window, output->window_size);
+        output->window = NULL;
+    }
+
+    window = mmap(NULL, offset + size - start, PROT_READ | PROT_WRITE,
+                  MAP_SHARED, output->fd, (off_t)start);
+    if(window == MAP_FAILED)
+        return 0;
+
+    output->window = window;
+    output->window_start = start;
+    output->window_size = offset + size - start;
+#else
+    (void)output;
+    (void)offset;
+    (void)size;
+#endif
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Stores bytes at a position of the label file, inside the mapped part
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+pbm_mapped_store__(pbm_mapped_output *output,
+                   size_t offset,
+                   const unsigned char *bytes,
+                   size_t size)
+{
+#if defined(HAVE_MMAP)
+    memcpy(output->window + (offset - output->window_start), bytes, size);
+    return 1;
+#else
+    return fseek(output->file, (long)offset, SEEK_SET) == 0
+           && fwrite(bytes, 1, size, output->file) == size;
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Finishes writing the label file and closes it
+ *
+ * @returns 1 if everything was written, 0 otherwise
+ */
+static int
+pbm_mapped_close__(pbm_mapped_output *output)
+{
+#if defined(HAVE_MMAP)
+    int ok = 1;
+
+    if(output->window != NULL)
+        ok = (munmap(output->window, output->window_size) == 0);
+
+    ok = (fsync(output->fd) == 0) && ok;
+    return (close(output->fd) == 0) && ok;
+#else
+    return fclose(output->file) == 0;
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Stores a label in a number of bytes, little-endian
+ */
+static void
+pbm_mapped_put__(unsigned char *dest,
+                 unsigned long value,
+                 unsigned int size)
+{
+    unsigned int i;
+
+    for(i = 0; i < size; i++)
+        dest[i] = (unsigned char)((value >> (8 * i)) & 0xFF);
+}
+
+/**
+ * @internal
+ *
+ * Copies a tile of the image into the state's tile bitmap, turning the most
+ * significant bit first bytes of the image into words with the first point
+ * in the least significant bit
+ */
+static void
+pbm_mapped_load__(pbm_mapped_state *state,
+                  int x0,
+                  int y0,
+                  int width,
+                  int height)
+{
+    const pbm_image *image = state->image;
+    /* Masks of every other bit, pair of bits and nibble of a word */
+    const bitmap_word m1 = ~(bitmap_word)0 / 3,
+                      m2 = ~(bitmap_word)0 / 5,
+                      m4 = ~(bitmap_word)0 / 17;
+    size_t first = (size_t)x0 / 8;
+    int y;
+
+    state->tile.width = width;
+    state->tile.height = height;
+    state->tile.stride = BITMAP_STRIDE(width);
+
+    for(y = 0; y < height; y++) {
+        const unsigned char *bytes =
+            image->data + (size_t)(y0 + y) * image->row_bytes + first;
+        size_t avail = image->row_bytes - first, w, i;
+        bitmap_word *row = bitmap_row(&state->tile, y);
+
+        for(w = 0; w < state->tile.stride; w++) {
+            bitmap_word word = 0;
+
+            /* Bytes in little-endian order, then each byte reversed */
+            for(i = 0; i < 8 && w * 8 + i < avail; i++)
+                word |= (bitmap_word)bytes[w * 8 + i] << (8 * i);
+
+            word = ((word >> 1) & m1) | ((word & m1) << 1);
+            word = ((word >> 2) & m2) | ((word & m2) << 2);
+            word = ((word >> 4) & m4) | ((word & m4) << 4);
+
+            row[w] = word;
+        }
+
+        /* Padding bits, and points of the next tile, must be clear */
+        if(width % BITMAP_WORD_BITS != 0)
+            row[state->tile.stride - 1] &=
+                ((bitmap_word)1 << (width % BITMAP_WORD_BITS)) - 1;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Labels the runs of the tile on their own, with the same scan as
+ * bitmap_find_all_source_run_regions(), and finds where each row's runs
+ * start
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+pbm_mapped_label_tile__(pbm_mapped_state *state,
+                        region_label *region_count)
+{
+    const bitmap_run *runs;
+    size_t i = 0;
+    int y;
+
+    /* The tile bitmap only holds the points of the tile, so its runs never
+       reach past it */
+    if(!bitmap_run_scan_source(&state->scan, &state->tile, state->tile.height,
+                               bitmap_source_row_runs, state->connectivity,
+                               region_count))
+    {
+        return 0;
+    }
+
+    runs = state->scan.runs;
+    for(y = 0; y <= state->tile.height; y++) {
+        while(i < state->scan.run_count && runs[i].y < y)
+            i++;
+
+        state->row_first[y] = i;
+    }
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Joins a region of the tile to the entry of a region of a previous tile it
+ * touches
+ */
+static void
+pbm_mapped_join__(pbm_mapped_state *state,
+                  region_label *entry,
+                  region_label other)
+{
+    if(*entry == 0)
+        *entry = other;
+    else if(!state->writing && *entry != other)
+        union_find_union(&state->global, *entry, other);
+}
+
+/**
+ * @internal
+ *
+ * Labels a tile, joins its regions to the ones they touch in the tiles
+ * above and to the left, and gives entries in the global union-find to the
+ * regions that reach the tiles below or to the right. While writing, the
+ * entries are given out again in the same order, and the final labels are
+ * written out.
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+pbm_mapped_tile__(pbm_mapped_state *state,
+                  int tx,
+                  int ty)
+{
+    const pbm_image *image = state->image;
+    int x0 = tx * state->tile_size,
+        y0 = ty * state->tile_size,
+        width = image->width - x0,
+        height = image->height - y0,
+        last_x = (tx == state->tiles_x - 1),
+        last_y = (ty == state->tiles_y - 1),
+        x, y;
+    region_label region_count, region, *entries = state->entries;
+    const bitmap_run *runs;
+    size_t i;
+
+    if(width > state->tile_size)
+        width = state->tile_size;
+    if(height > state->tile_size)
+        height = state->tile_size;
+
+    pbm_mapped_load__(state, x0, y0, width, height);
+    if(!pbm_mapped_label_tile__(state, &region_count))
+        return 0;
+
+    runs = state->scan.runs;
+
+    for(region = 1; region <= region_count; region++)
+        entries[region] = 0;
+
+    /* Points of the top row touch the bottom row of the tiles above, and
+       with 8-connectivity the corners of the tiles to the sides */
+    if(ty > 0) {
+        for(i = state->row_first[0]; i < state->row_first[1]; i++) {
+            int start = x0 + runs[i].x_start - state->reach,
+                end = x0 + runs[i].x_end + state->reach;
+
+            if(start < 0)
+                start = 0;
+            if(end > image->width)
+                end = image->width;
+
+            for(x = start; x < end; x++) {
+                if(state->above[x] != 0)
+                    pbm_mapped_join__(state,
+                                      &entries[bitmap_run_scan_region(
+                                          &state->scan, i)],
+                                      state->above[x]);
+            }
+        }
+    }
+
+    /* The first point of a row touches the right column of the tile to the
+       left. The corner below is left to the tile below that one. */
+    if(tx > 0) {
+        for(y = 0; y < height; y++) {
+            size_t first = state->row_first[y];
+            int k;
+
+            if(first == state->row_first[y + 1] || runs[first].x_start != 0)
+                continue;
+
+            for(k = y - state->reach; k <= y + state->reach; k++) {
+                if(k >= 0 && k < height && state->left[k] != 0)
+                    pbm_mapped_join__(state,
+                                      &entries[bitmap_run_scan_region(
+                                          &state->scan, first)],
+                                      state->left[k]);
+            }
+        }
+    }
+
+    /* Regions that reach a tile still to come and didn't join an earlier
+       one need an entry of their own, given out in the order the regions
+       were found */
+    if(!last_y) {
+        for(i = state->row_first[height - 1]; i < state->scan.run_count; i++) {
+            region = bitmap_run_scan_region(&state->scan, i);
+            if(entries[region] == 0)
+                entries[region] = (region_label)-1;
+        }
+    }
+
+    if(!last_x) {
+        for(y = 0; y < height; y++) {
+            i = state->row_first[y + 1];
+            if(i > state->row_first[y] && runs[i - 1].x_end == width) {
+                region = bitmap_run_scan_region(&state->scan, i - 1);
+                if(entries[region] == 0)
+                    entries[region] = (region_label)-1;
+            }
+        }
+    }
+
+    for(region = 1; region <= region_count; region++) {
+        if(entries[region] == (region_label)-1) {
+            if(state->writing) {
+                entries[region] = ++state->entry_count;
+            } else {
+                entries[region] = union_find_make_set(&state->global);
+                if(entries[region] == 0) {
+                    fprintf(stderr, "ERROR: Too many regions.\n");
+                    return 0;
+                }
+            }
+        } else if(entries[region] == 0 && !state->writing) {
+            state->inner_count++;
+        }
+    }
+
+    /* Keep the borders the next tiles touch */
+    if(!last_y) {
+        for(x = 0; x < width; x++)
+            state->below[x0 + x] = 0;
+
+        for(i = state->row_first[height - 1]; i < state->scan.run_count; i++) {
+            region = entries[bitmap_run_scan_region(&state->scan, i)];
+            for(x = runs[i].x_start; x < runs[i].x_end; x++)
+                state->below[x0 + x] = region;
+        }
+    }
+
+    if(!last_x) {
+        for(y = 0; y < height; y++) {
+            i = state->row_first[y + 1];
+            state->left[y] = 0;
+            if(i > state->row_first[y] && runs[i - 1].x_end == width)
+                state->left[y] =
+                    entries[bitmap_run_scan_region(&state->scan, i - 1)];
+        }
+    }
+
+    if(!state->writing)
+        return 1;
+
+    /* Final labels, in the order regions are first found */
+    for(region = 1; region <= region_count; region++) {
+        if(entries[region] == 0) {
+            entries[region] = ++state->label_count;
+        } else {
+            region_label set = state->global.parent[entries[region]];
+
+            if(state->set_labels[set] == 0)
+                state->set_labels[set] = ++state->label_count;
+
+            entries[region] = state->set_labels[set];
+        }
+    }
+
+    for(y = 0; y < height; y++) {
+        /* The words of the tile aren't needed anymore: reuse them to
+           assemble the row's labels */
+        unsigned char *bytes = (unsigned char*)state->tile.data;
+        unsigned int size = state->label_size;
+
+        memset(bytes, 0, (size_t)width * size);
+        for(i = state->row_first[y]; i < state->row_first[y + 1]; i++) {
+            region = entries[bitmap_run_scan_region(&state->scan, i)];
+            for(x = runs[i].x_start; x < runs[i].x_end; x++)
+                pbm_mapped_put__(bytes + (size_t)x * size, region, size);
+        }
+
+        if(!pbm_mapped_store__(&state->output,
+                               PBM_MAPPED_HEADER_SIZE
+                               + ((size_t)(y0 + y) * image->width + x0)
+                                 * size,
+                               bytes, (size_t)width * size))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Goes through all the tiles in order
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+pbm_mapped_pass__(pbm_mapped_state *state)
+{
+    size_t row_size = (size_t)state->image->width * state->label_size;
+    int tx, ty;
+
+    for(ty = 0; ty < state->tiles_y; ty++) {
+        region_label *swap;
+
+        if(state->writing) {
+            int y0 = ty * state->tile_size,
+                y1 = y0 + state->tile_size;
+            size_t start = PBM_MAPPED_HEADER_SIZE + y0 * row_size;
+
+            if(y1 > state->image->height)
+                y1 = state->image->height;
+
+            /* The header goes with the first row of tiles */
+            if(ty == 0)
+                start = 0;
+
+            if(!pbm_mapped_window__(&state->output, start,
+                                    PBM_MAPPED_HEADER_SIZE + y1 * row_size
+                                    - start)
+               || (ty == 0
+                   && !pbm_mapped_store__(&state->output, 0, state->header,
+                                          PBM_MAPPED_HEADER_SIZE)))
+            {
+                return 0;
+            }
+        }
+
+        for(tx = 0; tx < state->tiles_x; tx++) {
+            if(!pbm_mapped_tile__(state, tx, ty))
+                return 0;
+        }
+
+        swap = state->above;
+        state->above = state->below;
+        state->below = swap;
+    }
+
+    return 1;
+}
+
+int
+pbm_label_mapped(const pbm_image *image,
+                 bitmap_connectivity connectivity,
+                 int tile_size,
+                 const char *path,
+                 region_label *region_count)
+{
+    pbm_mapped_state state;
+    size_t tile_words, max_runs, total;
+    region_label set_count;
+    int opened = 0, ok = 0;
+
+    if(image == NULL || tile_size <= 0 || tile_size % BITMAP_WORD_BITS != 0)
+        return 0;
+
+    memset(&state, 0, sizeof(state));
+    state.image = image;
+    state.tile_size = tile_size;
+    state.tiles_x = (image->width + tile_size - 1) / tile_size;
+    state.tiles_y = (image->height + tile_size - 1) / tile_size;
+    state.connectivity = connectivity;
+    state.reach = (connectivity == BITMAP_CONNECTIVITY_8) ? 1 : 0;
+
+    /* Also room for a row of labels of up to 4 bytes, which reuses it */
+    tile_words = BITMAP_STRIDE(tile_size) * tile_size;
+
+    /* Every other point set in every row of the tile */
+    max_runs = (size_t)tile_size * ((tile_size + 1) / 2);
+
+    state.tile.data = malloc(tile_words * sizeof(*state.tile.data));
+    state.row_first = malloc((tile_size + 1) * sizeof(*state.row_first));
+    state.entries = malloc((max_runs + 1) * sizeof(*state.entries));
+    state.above = calloc(image->width, sizeof(*state.above));
+    state.below = calloc(image->width, sizeof(*state.below));
+    state.left = calloc(tile_size, sizeof(*state.left));
+
+    if(!bitmap_run_scan_init(&state.scan, max_runs)
+       || !union_find_init(&state.global, 1024)
+       || state.tile.data == NULL || state.row_first == NULL
+       || state.entries == NULL || state.above == NULL
+       || state.below == NULL || state.left == NULL)
+    {
+        goto done;
+    }
+
+    /* First pass: merge the regions crossing tile borders */
+    if(!pbm_mapped_pass__(&state))
+        goto done;
+
+    set_count = union_find_flatten(&state.global);
+
+    total = state.inner_count + set_count;
+    if(total < state.inner_count || total != (region_label)total) {
+        fprintf(stderr, "ERROR: Too many regions.\n");
+        goto done;
+    }
+
+    state.set_labels = calloc((size_t)set_count + 1,
+                              sizeof(*state.set_labels));
+    if(state.set_labels == NULL)
+        goto done;
+
+    state.label_size = (total <= 0xFF) ? 1 : (total <= 0xFFFF) ? 2 : 4;
+
+    if(!pbm_mapped_open__(&state.output, path,
+                          PBM_MAPPED_HEADER_SIZE
+                          + (size_t)image->width * image->height
+                            * state.label_size))
+    {
+        fprintf(stderr, "ERROR: Can't write '%s'.\n", path);
+        goto done;
+    }
+    opened = 1;
+
+    pbm_mapped_put__(state.header, 0x4C424C52UL, 4);
+    pbm_mapped_put__(state.header + 4, (unsigned long)image->width, 4);
+    pbm_mapped_put__(state.header + 8, (unsigned long)image->height, 4);
+    pbm_mapped_put__(state.header + 12, (unsigned long)total, 4);
+    pbm_mapped_put__(state.header + 16, state.label_size, 4);
+
+    /* Second pass: label the tiles again and write them out */
+    state.writing = 1;
+    ok = pbm_mapped_pass__(&state);
+
+    *region_count = (region_label)total;
+
+done:
+    if(opened) {
+        ok = pbm_mapped_close__(&state.output) && ok;
+
+        /* Don't leave a partial file behind */
+        if(!ok) {
+            fprintf(stderr, "ERROR: Can't write '%s'.\n", path);
+            remove(path);
+        }
+    }
+
+    free(state.set_labels);
+    free(state.left);
+    free(state.below);
+    free(state.above);
+    free(state.entries);
+    free(state.row_first);
+    free(state.tile.data);
+    union_find_free(&state.global);
+    bitmap_run_scan_free(&state.scan);
+
+    return ok;
+}
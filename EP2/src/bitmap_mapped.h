@@ -0,0 +1,59 @@
+/** @file bitmap_mapped.h
+ *
+ * Out-of-core labeling of memory-mapped PBM images, one tile at a time, into
+ * memory-mapped label files
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_MAPPED_H
+#define BITMAP_MAPPED_H
+
+#include "bitmap.h"
+#include "bitmap_pbm.h"
+#include "union_find.h"
+
+/** Default width and height of the tiles, in points */
+#define PBM_MAPPED_TILE_SIZE 1024
+
+/**
+ * Labels the regions of a PBM image too large to be labeled in memory,
+ * writing the labels to a file.
+ *
+ * The image is split in square tiles, labeled one at a time from the mapped
+ * file in two passes. The first pass only merges the regions that cross the
+ * tile borders, in a union-find holding just those regions. The second one
+ * labels each tile again and writes its labels to the output file, mapping
+ * one row of tiles of it at a time. Besides the tile being labeled, only the labels of the
+ * bottom row of the tiles above and of the right column of the tile to the
+ * left are kept in memory, so memory scales with the width, the tile size
+ * and the number of regions crossing tile borders, and not with the size of
+ * the image.
+ *
+ * Regions are numbered in the order their first point is found going
+ * through the tiles in row-major order, and each tile in row-major order:
+ * the same order as bitmap_find_all_regions() when the image fits in a
+ * single tile.
+ *
+ * The file is written in the raw label format of BITMAP_OUTPUT_BINARY.
+ * Without mmap() support (see HAVE_MMAP in the Makefile) it is written with
+ * regular file operations instead.
+ *
+ * @param image        The image to use
+ * @param connectivity Connectivity of the regions
+ * @param tile_size    Width and height of the tiles: a multiple of
+ *                     BITMAP_WORD_BITS
+ * @param path         Path to the label file to write
+ * @param region_count Receives the number of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+pbm_label_mapped(const pbm_image *image,
+                 bitmap_connectivity connectivity,
+                 int tile_size,
+                 const char *path,
+                 region_label *region_count);
+
+#endif /* BITMAP_MAPPED_H */
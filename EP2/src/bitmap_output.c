@@ -0,0 +1,475 @@
+/** @file bitmap_output.c
+ *
+ * Buffered writers of the regions of a bitmap, as text, label images or raw
+ * labels
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "union_find.h"
+#include "bitmap_output.h"
+
+/** Longest region name: 7 letters are enough for 26^7 > 2^32 regions */
+#define BITMAP_OUTPUT_NAME_MAX 8
+
+/** Initial size of the buffer of outputs kept in memory */
+#define BITMAP_OUTPUT_MEMORY_SIZE 4096
+
+/**
+ * @internal
+ *
+ * A run of a region, along with the region's label
+ */
+typedef struct {
+    /** The run */
+    const bitmap_run *run;
+    /** Label of the run's region */
+    region_label label;
+} bitmap_output_run__;
+
+bitmap_output*
+bitmap_output_new(FILE *outfile)
+{
+    bitmap_output *out;
+
+    out = malloc(sizeof(*out));
+    if(out == NULL)
+        return NULL;
+
+    out->file = outfile;
+    out->len = 0;
+    out->capacity = (outfile != NULL) ? BITMAP_OUTPUT_BLOCK_SIZE
+                                      : BITMAP_OUTPUT_MEMORY_SIZE;
+    out->ok = 1;
+
+    out->buffer = malloc(out->capacity);
+    if(out->buffer == NULL) {
+        free(out);
+        return NULL;
+    }
+
+    return out;
+}
+
+int
+bitmap_output_free(bitmap_output *out)
+{
+    int ok;
+
+    if(out == NULL)
+        return 1;
+
+    ok = bitmap_output_flush(out);
+
+    free(out->buffer);
+    free(out);
+
+    return ok;
+}
+
+int
+bitmap_output_flush(bitmap_output *out)
+{
+    if(out->file != NULL) {
+        if(out->len > 0 && out->ok)
+            out->ok = fwrite(out->buffer, 1, out->len, out->file) == out->len;
+
+        out->len = 0;
+    }
+
+    return out->ok;
+}
+
+/**
+ * @internal
+ *
+ * Makes room for a few bytes, at most BITMAP_OUTPUT_MEMORY_SIZE, in the buffer
+ * of an output, flushing or growing it as needed. If growing fails, the
+ * output is marked as failed and its contents discarded.
+ *
+ * @returns Pointer to where the bytes should be stored. Once they are, add
+ *          their number to out->len.
+ */
+static unsigned char*
+bitmap_output_reserve__(bitmap_output *out,
+                        size_t n)
+{
+    if(out->len + n <= out->capacity)
+        return out->buffer + out->len;
+
+    if(out->file != NULL) {
+        bitmap_output_flush(out);
+    } else {
+        unsigned char *buffer = NULL;
+        size_t capacity = out->capacity;
+
+        while(capacity < out->len + n)
+            capacity *= 2;
+
+        if(out->ok)
+            buffer = realloc(out->buffer, capacity);
+
+        if(buffer != NULL) {
+            out->buffer = buffer;
+            out->capacity = capacity;
+        } else {
+            out->ok = 0;
+            out->len = 0;
+        }
+    }
+
+    return out->buffer + out->len;
+}
+
+void
+bitmap_output_bytes(bitmap_output *out,
+                    const void *data,
+                    size_t size)
+{
+    const unsigned char *bytes = data;
+
+    /* Large blocks are copied in pieces the size of the smallest buffer */
+    while(size > 0) {
+        size_t n = (size < BITMAP_OUTPUT_MEMORY_SIZE)
+                   ? size : BITMAP_OUTPUT_MEMORY_SIZE;
+
+        memcpy(bitmap_output_reserve__(out, n), bytes, n);
+        out->len += n;
+
+        bytes += n;
+        size -= n;
+    }
+}
+
+void
+bitmap_output_puts(bitmap_output *out,
+                   const char *str)
+{
+    bitmap_output_bytes(out, str, strlen(str));
+}
+
+/**
+ * @internal
+ *
+ * Groups the runs of all regions by row, with a counting sort
+ *
+ * @param height     Height of the bitmap the regions were found in
+ * @param regions    The list of regions
+ * @param row_starts Pointer that will receive an array of height + 1
+ *                   positions, the runs of row y going from row_starts[y]
+ *                   to row_starts[y + 1]
+ *
+ * @returns The sorted runs, or NULL on memory allocation failure
+ */
+static bitmap_output_run__*
+bitmap_output_index__(int height,
+                      const bitmap_region_list *regions,
+                      size_t **row_starts)
+{
+    bitmap_output_run__ *sorted;
+    size_t *starts, r, i;
+    int y;
+
+    starts = calloc((size_t)height + 1, sizeof(*starts));
+    sorted = malloc((regions->run_count + 1) * sizeof(*sorted));
+    if(starts == NULL || sorted == NULL) {
+        free(starts);
+        free(sorted);
+        return NULL;
+    }
+
+    for(i = 0; i < regions->run_count; i++)
+        starts[regions->runs[i].y + 1]++;
+
+    for(y = 0; y < height; y++)
+        starts[y + 1] += starts[y];
+
+    /* Regions are visited in order, so the runs of each row stay ordered by
+       label, and the starts end up shifted by one row */
+    for(r = 0; r < regions->region_count; r++) {
+        const bitmap_region *region = &regions->regions[r];
+
+        for(i = 0; i < region->run_count; i++) {
+            bitmap_output_run__ *entry =
+                &sorted[starts[region->runs[i].y]++];
+
+            entry->run = &region->runs[i];
+            entry->label = (region_label)(r + 1);
+        }
+    }
+
+    memmove(starts + 1, starts, (size_t)height * sizeof(*starts));
+    starts[0] = 0;
+
+    *row_starts = starts;
+    return sorted;
+}
+
+/**
+ * @internal
+ *
+ * Writes the name of a region to a string: 'a' to 'z', then "aa", "ab" and
+ * so on
+ *
+ * @returns The length of the name
+ */
+static size_t
+bitmap_output_name__(region_label label,
+                     char *name)
+{
+    char reversed[BITMAP_OUTPUT_NAME_MAX];
+    size_t len = 0, i;
+
+    while(label > 0) {
+        label--;
+        reversed[len++] = (char)('a' + label % 26);
+        label /= 26;
+    }
+
+    for(i = 0; i < len; i++)
+        name[i] = reversed[len - 1 - i];
+
+    return len;
+}
+
+/**
+ * @internal
+ *
+ * Formats a row of labels as text
+ */
+static void
+bitmap_output_text_row__(bitmap_output *out,
+                         const region_label *row,
+                         int width,
+                         size_t name_width)
+{
+    char name[BITMAP_OUTPUT_NAME_MAX];
+    region_label last = 0;
+    int x;
+
+    memset(name, ' ', sizeof(name));
+
+    for(x = 0; x < width; x++) {
+        unsigned char *dest = bitmap_output_reserve__(out, name_width + 1);
+
+        /* Points of the same run share a label, so names are only built
+           again when it changes */
+        if(row[x] != last) {
+            memset(name, ' ', sizeof(name));
+            bitmap_output_name__(row[x], name);
+            last = row[x];
+        }
+
+        memcpy(dest, name, name_width);
+        dest[name_width] = (x == width - 1) ? '\n' : ' ';
+        out->len += name_width + 1;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Stores a row of labels in a number of bytes each
+ */
+static void
+bitmap_output_label_row__(bitmap_output *out,
+                          const region_label *row,
+                          int width,
+                          unsigned int label_size,
+                          int big_endian)
+{
+    int x;
+
+    for(x = 0; x < width; x++) {
+        unsigned char *dest = bitmap_output_reserve__(out, label_size);
+        unsigned int i;
+
+        for(i = 0; i < label_size; i++) {
+            unsigned int shift = big_endian ? 8 * (label_size - 1 - i) : 8 * i;
+
+            dest[i] = (unsigned char)((row[x] >> shift) & 0xFF);
+        }
+
+        out->len += label_size;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Smallest number of bytes, 1, 2 or 4, that can hold the labels of a number
+ * of regions
+ */
+static unsigned int
+bitmap_output_label_size__(size_t region_count)
+{
+    if(region_count <= 0xFF)
+        return 1;
+    else if(region_count <= 0xFFFF)
+        return 2;
+
+    return 4;
+}
+
+/**
+ * @internal
+ *
+ * Appends a 32-bit little-endian integer to the buffer
+ */
+static void
+bitmap_output_uint32__(bitmap_output *out,
+                       unsigned long value)
+{
+    unsigned char *dest = bitmap_output_reserve__(out, 4);
+    int i;
+
+    for(i = 0; i < 4; i++)
+        dest[i] = (unsigned char)((value >> (8 * i)) & 0xFF);
+
+    out->len += 4;
+}
+
+int
+bitmap_output_regions(bitmap_output *out,
+                      bitmap_output_format format,
+                      int width,
+                      int height,
+                      const bitmap_region_list *regions)
+{
+    bitmap_output_run__ *sorted;
+    region_label *row;
+    size_t *row_starts, name_width = 1, i;
+    unsigned int label_size;
+    int big_endian = 1;
+    char header[160];
+    int y;
+
+    if(regions == NULL || width <= 0 || height <= 0)
+        return 0;
+
+    if(format == BITMAP_OUTPUT_PGM && regions->region_count > 0xFFFF) {
+        fprintf(stderr, "ERROR: Too many regions for a PGM image, "
+                        "use PAM instead.\n");
+        return 0;
+    }
+
+    label_size = bitmap_output_label_size__(regions->region_count);
+
+    row = malloc((size_t)width * sizeof(*row));
+    sorted = bitmap_output_index__(height, regions, &row_starts);
+
+    if(row == NULL || sorted == NULL) {
+        free(row);
+        if(sorted != NULL) {
+            free(sorted);
+            free(row_starts);
+        }
+        return 0;
+    }
+
+    switch(format) {
+    case BITMAP_OUTPUT_TEXT:
+        {
+            char name[BITMAP_OUTPUT_NAME_MAX];
+
+            name_width = bitmap_output_name__(
+                (region_label)regions->region_count, name);
+            if(name_width == 0)
+                name_width = 1;
+        }
+        break;
+    case BITMAP_OUTPUT_PGM:
+        sprintf(header, "P5\n%d %d\n%lu\n", width, height,
+                (unsigned long)(regions->region_count > 0
+                                ? regions->region_count : 1));
+        bitmap_output_puts(out, header);
+        break;
+    case BITMAP_OUTPUT_PAM:
+        if(label_size <= 2) {
+            sprintf(header, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 1\nMAXVAL %lu\n"
+                            "TUPLTYPE GRAYSCALE\nENDHDR\n", width, height,
+                    (unsigned long)(regions->region_count > 0
+                                    ? regions->region_count : 1));
+        } else {
+            sprintf(header, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 2\nMAXVAL 65535\n"
+                            "TUPLTYPE LABEL32\nENDHDR\n", width, height);
+        }
+        bitmap_output_puts(out, header);
+        break;
+    case BITMAP_OUTPUT_BINARY:
+        big_endian = 0;
+        bitmap_output_uint32__(out, 0x4C424C52UL);
+        bitmap_output_uint32__(out, (unsigned long)width);
+        bitmap_output_uint32__(out, (unsigned long)height);
+        bitmap_output_uint32__(out, (unsigned long)regions->region_count);
+        bitmap_output_uint32__(out, label_size);
+        break;
+    }
+
+    for(y = 0; y < height && out->ok; y++) {
+        memset(row, 0, (size_t)width * sizeof(*row));
+
+        for(i = row_starts[y]; i < row_starts[y + 1]; i++) {
+            const bitmap_run *run = sorted[i].run;
+            int x;
+
+            for(x = run->x_start; x < run->x_end; x++)
+                row[x] = sorted[i].label;
+        }
+
+        if(format == BITMAP_OUTPUT_TEXT)
+            bitmap_output_text_row__(out, row, width, name_width);
+        else
+            bitmap_output_label_row__(out, row, width, label_size,
+                                      big_endian);
+    }
+
+    free(row);
+    free(sorted);
+    free(row_starts);
+
+    return out->ok;
+}
+
+int
+bitmap_output_write(FILE *outfile,
+                    bitmap_output_format format,
+                    int width,
+                    int height,
+                    const bitmap_region_list *regions)
+{
+    bitmap_output *out;
+    int ok;
+
+    out = bitmap_output_new(outfile);
+    if(out == NULL)
+        return 0;
+
+    ok = bitmap_output_regions(out, format, width, height, regions);
+    ok = bitmap_output_free(out) && ok;
+
+    return ok && !ferror(outfile);
+}
+
+const char*
+bitmap_output_extension(bitmap_output_format format)
+{
+    switch(format) {
+    case BITMAP_OUTPUT_TEXT:
+        return "txt";
+    case BITMAP_OUTPUT_PGM:
+        return "pgm";
+    case BITMAP_OUTPUT_PAM:
+        return "pam";
+    case BITMAP_OUTPUT_BINARY:
+        return "bin";
+    }
+
+    return "";
+}
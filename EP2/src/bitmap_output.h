@@ -0,0 +1,176 @@
+/** @file bitmap_output.h
+ *
+ * Buffered writers of the regions of a bitmap, as text, label images or raw
+ * labels
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_OUTPUT_H
+#define BITMAP_OUTPUT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bitmap.h"
+
+/** Size of the blocks written to the output at once, in bytes */
+#define BITMAP_OUTPUT_BLOCK_SIZE (256 * 1024)
+
+/** Formats the regions of a bitmap can be written in */
+typedef enum {
+    /**
+     * The points of each row separated by spaces, each region's points
+     * marked by its name: 'a' to 'z', then "aa", "ab" and so on, like
+     * spreadsheet columns. Names are padded with spaces to the length of the
+     * longest one, and unset points are left blank. With less than 27 regions
+     * this is the same as bitmap_regions_print().
+     */
+    BITMAP_OUTPUT_TEXT,
+    /**
+     * Binary PGM (P5) image of the labels, 0 being the background. Labels take
+     * 2 bytes, most significant first, with more than 255 regions. Fails with
+     * more than 65535 regions.
+     */
+    BITMAP_OUTPUT_PGM,
+    /**
+     * PAM (P7) image of the labels. Up to 65535 regions it holds the same as
+     * BITMAP_OUTPUT_PGM. With more, each label is split in two 16-bit
+     * channels, the most significant first, with a "LABEL32" tuple type.
+     */
+    BITMAP_OUTPUT_PAM,
+    /**
+     * Raw labels, after a header of five 32-bit little-endian integers: the
+     * "RLBL" magic number (0x4C424C52), width, height, number of regions and
+     * size of each label in bytes (1, 2 or 4, the narrowest that fits). Labels
+     * follow in row-major order, little-endian.
+     */
+    BITMAP_OUTPUT_BINARY
+} bitmap_output_format;
+
+/**
+ * Buffered output, either to a file, written in blocks of
+ * BITMAP_OUTPUT_BLOCK_SIZE bytes, or kept in memory
+ */
+typedef struct {
+    /** The file to write to, or NULL if the output is kept in memory */
+    FILE *file;
+    /** The buffered output */
+    unsigned char *buffer;
+    /** Number of bytes in the buffer */
+    size_t len;
+    /** Number of bytes the buffer has room for */
+    size_t capacity;
+    /** Whether all writes so far succeeded */
+    int ok;
+} bitmap_output;
+
+/**
+ * Creates a new buffered output
+ *
+ * @param outfile The file to write to, or NULL to keep the output in memory,
+ *                growing the buffer as needed
+ *
+ * @returns The new output, or NULL on memory allocation failure
+ */
+bitmap_output*
+bitmap_output_new(FILE *outfile);
+
+/**
+ * Flushes a buffered output and frees it. The file is not closed.
+ *
+ * @param out An output to free
+ *
+ * @returns 1 if all writes succeeded, 0 otherwise
+ */
+int
+bitmap_output_free(bitmap_output *out);
+
+/**
+ * Writes the buffered output to its file. Does nothing for outputs kept in
+ * memory.
+ *
+ * @param out The output to flush
+ *
+ * @returns 1 if all writes so far succeeded, 0 otherwise
+ */
+int
+bitmap_output_flush(bitmap_output *out);
+
+/**
+ * Appends bytes to a buffered output
+ *
+ * @param out  The output to use
+ * @param data The bytes to append
+ * @param size Number of bytes
+ */
+void
+bitmap_output_bytes(bitmap_output *out,
+                    const void *data,
+                    size_t size);
+
+/**
+ * Appends a string, without its terminating null character, to a buffered
+ * output
+ *
+ * @param out The output to use
+ * @param str The string to append
+ */
+void
+bitmap_output_puts(bitmap_output *out,
+                   const char *str);
+
+/**
+ * Writes the regions found in a bitmap, labeled by their position in the
+ * list, starting from 1.
+ *
+ * The labels are rebuilt one row at a time from the regions' runs and
+ * formatted straight into the output's buffer, so the memory used is
+ * proportional to the width and the number of runs only.
+ *
+ * @param out     The output to use
+ * @param format  The format to write in
+ * @param width   Width of the bitmap the regions were found in
+ * @param height  Height of the bitmap the regions were found in
+ * @param regions The list of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+bitmap_output_regions(bitmap_output *out,
+                      bitmap_output_format format,
+                      int width,
+                      int height,
+                      const bitmap_region_list *regions);
+
+/**
+ * Writes the regions found in a bitmap to a file, in the same way as
+ * bitmap_output_regions()
+ *
+ * @param outfile The file to write to
+ * @param format  The format to write in
+ * @param width   Width of the bitmap the regions were found in
+ * @param height  Height of the bitmap the regions were found in
+ * @param regions The list of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+bitmap_output_write(FILE *outfile,
+                    bitmap_output_format format,
+                    int width,
+                    int height,
+                    const bitmap_region_list *regions);
+
+/**
+ * Retrieves the extension, without the dot, of the files written in a format
+ *
+ * @param format The format
+ *
+ * @returns The extension
+ */
+const char*
+bitmap_output_extension(bitmap_output_format format);
+
+#endif /* BITMAP_OUTPUT_H */
@@ -0,0 +1,404 @@
+/** @file bitmap_pbm.c
+ *
+ * Binary PBM (P4) images: labeling straight from memory-mapped files, and
+ * writing region masks
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#if defined(HAVE_MMAP)
+#define _POSIX_C_SOURCE 200112L
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "bitmap.h"
+#include "bitops.h"
+#include "bitmap_runs.h"
+#include "bitmap_pbm.h"
+
+/**
+ * @internal
+ *
+ * Loads the contents of a file in memory, mapping it when possible
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+pbm_load_file__(const char *path,
+                pbm_image *image)
+{
+#if defined(HAVE_MMAP)
+    struct stat st;
+    void *mapping;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return 0;
+    }
+
+    mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(mapping == MAP_FAILED)
+        return 0;
+
+    /* Rows are only ever visited in order */
+    posix_madvise(mapping, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    image->mapping = mapping;
+    image->mapping_size = (size_t)st.st_size;
+
+    return 1;
+#else
+    FILE *file;
+    long size;
+    void *data;
+
+    file = fopen(path, "rb");
+    if(file == NULL)
+        return 0;
+
+    if(fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) <= 0
+       || fseek(file, 0, SEEK_SET) != 0)
+    {
+        fclose(file);
+        return 0;
+    }
+
+    data = malloc((size_t)size);
+    if(data == NULL || fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return 0;
+    }
+
+    fclose(file);
+
+    image->mapping = data;
+    image->mapping_size = (size_t)size;
+
+    return 1;
+#endif
+}
+
+/**
+ * @internal
+ *
+ * Reads an unsigned decimal number from a PBM header, skipping whitespace and
+ * comments before it
+ *
+ * @returns 1 on success, 0 if no number was found
+ */
+static int
+pbm_parse_uint__(const unsigned char *data,
+                 size_t size,
+                 size_t *pos,
+                 unsigned int *value)
+{
+    size_t start;
+
+    for(;;) {
+        if(*pos < size && data[*pos] == '#') {
+            while(*pos < size && data[*pos] != '\n')
+                (*pos)++;
+        } else if(*pos < size && isspace(data[*pos])) {
+            (*pos)++;
+        } else {
+            break;
+        }
+    }
+
+    *value = 0;
+    for(start = *pos; *pos < size && isdigit(data[*pos]); (*pos)++)
+        *value = *value * 10 + (data[*pos] - '0');
+
+    return *pos > start;
+}
+
+pbm_image*
+pbm_map(const char *path)
+{
+    pbm_image *image;
+    const unsigned char *data;
+    unsigned int width, height;
+    size_t pos = 2;
+
+    image = malloc(sizeof(*image));
+    if(image == NULL)
+        return NULL;
+
+    if(!pbm_load_file__(path, image)) {
+        fprintf(stderr, "ERROR: Can't read '%s'.\n", path);
+        free(image);
+        return NULL;
+    }
+
+    data = image->mapping;
+
+    /* The header is followed by a single whitespace character */
+    if(image->mapping_size < 2 || data[0] != 'P' || data[1] != '4'
+       || !pbm_parse_uint__(data, image->mapping_size, &pos, &width)
+       || !pbm_parse_uint__(data, image->mapping_size, &pos, &height)
+       || width == 0 || height == 0
+       || pos >= image->mapping_size || !isspace(data[pos]))
+    {
+        fprintf(stderr, "ERROR: '%s' is not a binary PBM (P4) image.\n", path);
+        goto error;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->row_bytes = (width + 7) / 8;
+    image->data = data + pos + 1;
+
+    if((size_t)(data + image->mapping_size - image->data)
+       < image->row_bytes * height)
+    {
+        fprintf(stderr, "ERROR: '%s' is truncated.\n", path);
+        goto error;
+    }
+
+    return image;
+
+error:
+    pbm_unmap(image);
+    return NULL;
+}
+
+void
+pbm_unmap(pbm_image *image)
+{
+    if(image != NULL) {
+#if defined(HAVE_MMAP)
+        munmap(image->mapping, image->mapping_size);
+#else
+        free(image->mapping);
+#endif
+        free(image);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Loads up to 8 bytes of a row into a word, the first byte in the most
+ * significant position, like the points in the row
+ */
+static bitmap_word
+pbm_load_word__(const unsigned char *bytes,
+                size_t n)
+{
+    bitmap_word word = 0;
+    size_t i;
+
+    if(n >= 8) {
+        for(i = 0; i < 8; i++)
+            word = (word << 8) | bytes[i];
+    } else {
+        for(i = 0; i < 8; i++)
+            word = (word << 8) | ((i < n) ? bytes[i] : 0);
+    }
+
+    return word;
+}
+
+int
+pbm_row_runs(const void *source,
+             int y,
+             bitmap_run **runs,
+             size_t *count,
+             size_t *capacity)
+{
+    const pbm_image *image = source;
+    const unsigned char *row = image->data + (size_t)y * image->row_bytes;
+    int base, open = 0, run_start = 0;
+
+    /* Same as bitmap_row_runs(), except the first point of each word is its
+       most significant bit, so the bits are scanned from the top down */
+    for(base = 0; base < image->width; base += BITMAP_WORD_BITS) {
+        size_t offset = base / 8;
+        bitmap_word word = pbm_load_word__(row + offset,
+                                           image->row_bytes - offset);
+        int valid = image->width - base,
+            pos = 0;
+
+        /* Padding bits may hold anything */
+        if(valid < BITMAP_WORD_BITS)
+            word &= ~(~(bitmap_word)0 >> valid);
+
+        while(pos < BITMAP_WORD_BITS) {
+            bitmap_word rest;
+
+            if(!open) {
+                rest = word << pos;
+                if(rest == 0)
+                    break;
+
+                pos += bit_clz(rest);
+                run_start = base + pos;
+                open = 1;
+            } else {
+                rest = ~word << pos;
+                if(rest == 0)
+                    break;
+
+                pos += bit_clz(rest);
+                open = 0;
+
+                if(!bitmap_run_append(runs, count, capacity, y, run_start,
+                                      base + pos))
+                {
+                    return 0;
+                }
+            }
+        }
+    }
+
+    if(open && !bitmap_run_append(runs, count, capacity, y, run_start,
+                                  image->width))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+bitmap_region_list*
+pbm_find_all_regions(const pbm_image *image,
+                     bitmap_connectivity connectivity)
+{
+    if(image == NULL)
+        return NULL;
+
+    return bitmap_find_all_source_run_regions(image, image->width,
+                                              image->height, pbm_row_runs,
+                                              connectivity);
+}
+
+/**
+ * @internal
+ *
+ * Reverses the order of the bits of a byte
+ */
+static unsigned char
+pbm_reverse_byte__(unsigned int b)
+{
+    b = ((b & 0xF0) >> 4) | ((b & 0x0F) << 4);
+    b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+    b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
+
+    return (unsigned char)b;
+}
+
+/**
+ * @internal
+ *
+ * Sets the bits of the points in [x_start, x_end) in a packed PBM row
+ */
+static void
+pbm_set_span__(unsigned char *row,
+               int x_start,
+               int x_end)
+{
+    int x = x_start;
+
+    /* Partial bytes are filled a point at a time, whole bytes at once */
+    while(x < x_end && x % 8 != 0) {
+        row[x / 8] |= 0x80 >> (x % 8);
+        x++;
+    }
+
+    if(x_end - x >= 8) {
+        memset(row + x / 8, 0xFF, (x_end - x) / 8);
+        x += (x_end - x) / 8 * 8;
+    }
+
+    while(x < x_end) {
+        row[x / 8] |= 0x80 >> (x % 8);
+        x++;
+    }
+}
+
+int
+pbm_write(FILE *outfile,
+          const bitmap *map)
+{
+    size_t row_bytes, i;
+    unsigned char *row;
+    int y, ok = 1;
+
+    if(map == NULL || map->data == NULL)
+        return 0;
+
+    row_bytes = (map->width + 7) / 8;
+    row = malloc(row_bytes);
+    if(row == NULL)
+        return 0;
+
+    fprintf(outfile, "P4\n%d %d\n", map->width, map->height);
+
+    /* Padding bits of the bitmap are clear, and so end up the same in PBM */
+    for(y = 0; y < map->height && ok; y++) {
+        const bitmap_word *words = bitmap_row(map, y);
+
+        for(i = 0; i < row_bytes; i++) {
+            bitmap_word word = words[i / sizeof(bitmap_word)];
+            unsigned int shift = (unsigned int)(i % sizeof(bitmap_word)) * 8;
+
+            row[i] = pbm_reverse_byte__((unsigned int)(word >> shift) & 0xFF);
+        }
+
+        ok = fwrite(row, 1, row_bytes, outfile) == row_bytes;
+    }
+
+    free(row);
+    return ok && !ferror(outfile);
+}
+
+int
+pbm_write_region(FILE *outfile,
+                 int width,
+                 int height,
+                 const bitmap_region *region)
+{
+    size_t row_bytes, i = 0;
+    unsigned char *row;
+    int y, ok = 1;
+
+    if(region == NULL || width <= 0 || height <= 0)
+        return 0;
+
+    row_bytes = (width + 7) / 8;
+    row = malloc(row_bytes);
+    if(row == NULL)
+        return 0;
+
+    fprintf(outfile, "P4\n%d %d\n", width, height);
+
+    for(y = 0; y < height && ok; y++) {
+        memset(row, 0, row_bytes);
+
+        for(; i < region->run_count && region->runs[i].y == y; i++)
+            pbm_set_span__(row, region->runs[i].x_start, region->runs[i].x_end);
+
+        ok = fwrite(row, 1, row_bytes, outfile) == row_bytes;
+    }
+
+    free(row);
+    return ok && !ferror(outfile);
+}
@@ -0,0 +1,120 @@
+/** @file bitmap_pbm.h
+ *
+ * Binary PBM (P4) images: labeling straight from memory-mapped files, and
+ * writing region masks
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_PBM_H
+#define BITMAP_PBM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bitmap.h"
+
+/**
+ * Binary PBM image mapped in memory. Rows are packed 8 points per byte, the
+ * first point in the most significant bit, and padded to a whole byte. Set
+ * bits are black, and are the points of the regions.
+ */
+typedef struct {
+    /** Width of the image */
+    int width;
+    /** Height of the image */
+    int height;
+    /** Size of each row, in bytes */
+    size_t row_bytes;
+    /** Pointer to the first row, inside the mapping */
+    const unsigned char *data;
+    /** Start of the mapped file */
+    void *mapping;
+    /** Size of the mapped file */
+    size_t mapping_size;
+} pbm_image;
+
+/**
+ * Maps a binary PBM (P4) file in memory. Only the first image of the file is
+ * used. Without mmap() support (see HAVE_MMAP in the Makefile) the file is
+ * read into memory instead.
+ *
+ * @param path Path to the file
+ *
+ * @returns The mapped image, or NULL on errors
+ */
+pbm_image*
+pbm_map(const char *path);
+
+/**
+ * Unmaps a PBM image and frees it
+ *
+ * @param image An image to unmap
+ */
+void
+pbm_unmap(pbm_image *image);
+
+/**
+ * Appends the runs of a row of a PBM image to an array, in the same way as
+ * bitmap_row_runs(), scanning its packed bytes directly.
+ *
+ * @param image    The pbm_image to use
+ * @param y        0-based position of the row in the y-axis
+ * @param runs     Pointer to a pointer to an array of runs, that will be
+ *                 reallocated as needed
+ * @param count    Pointer to the number of runs in the array
+ * @param capacity Pointer to the number of runs the array has room for
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+pbm_row_runs(const void *image,
+             int y,
+             bitmap_run **runs,
+             size_t *count,
+             size_t *capacity);
+
+/**
+ * Retrieves all the connected regions of a PBM image, without copying or
+ * unpacking it. Regions are ordered as in bitmap_find_all_regions().
+ *
+ * @param image        The image to use
+ * @param connectivity Connectivity of the regions
+ *
+ * @returns The list of regions, or NULL on error
+ */
+bitmap_region_list*
+pbm_find_all_regions(const pbm_image *image,
+                     bitmap_connectivity connectivity);
+
+/**
+ * Writes a bitmap as a binary PBM (P4) image
+ *
+ * @param outfile The file to write to
+ * @param map     The bitmap to write
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+pbm_write(FILE *outfile,
+          const bitmap *map);
+
+/**
+ * Writes the mask of a single region as a binary PBM (P4) image, with the
+ * region's points set
+ *
+ * @param outfile The file to write to
+ * @param width   Width of the image the region was found in
+ * @param height  Height of the image the region was found in
+ * @param region  The region to write. Its runs must be in row-major order.
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+pbm_write_region(FILE *outfile,
+                 int width,
+                 int height,
+                 const bitmap_region *region);
+
+#endif /* BITMAP_PBM_H */
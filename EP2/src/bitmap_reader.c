@@ -0,0 +1,396 @@
+/** @file bitmap_reader.c
+ *
+ * Buffered bulk reader for the text bitmap format
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "bitmap.h"
+#include "bitops.h"
+#include "bitmap_reader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BITMAP_READER_SSE2 1
+#include <emmintrin.h>
+#else
+#define BITMAP_READER_SSE2 0
+#endif
+
+bitmap_reader*
+bitmap_reader_new(FILE *infile)
+{
+    bitmap_reader *reader = malloc(sizeof(*reader));
+    if(reader == NULL)
+        return NULL;
+
+    reader->buffer = malloc(BITMAP_READER_BLOCK_SIZE);
+    if(reader->buffer == NULL) {
+        free(reader);
+        return NULL;
+    }
+
+    reader->file = infile;
+    reader->pos = reader->len = 0;
+
+    return reader;
+}
+
+void
+bitmap_reader_free(bitmap_reader *reader)
+{
+    if(reader != NULL) {
+        free(reader->buffer);
+        free(reader);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Reads the next character, refilling the buffer if it is empty
+ *
+ * @returns The character, or EOF
+ */
+static int
+bitmap_reader_getc__(bitmap_reader *reader)
+{
+    if(reader->pos == reader->len) {
+        reader->pos = 0;
+        reader->len = fread(reader->buffer, 1, BITMAP_READER_BLOCK_SIZE,
+                            reader->file);
+        if(reader->len == 0)
+            return EOF;
+    }
+
+    return (unsigned char)reader->buffer[reader->pos++];
+}
+
+/**
+ * @internal
+ *
+ * Skips whitespace and, if asked to, PBM comments, which go from a '#' to the
+ * end of the line
+ *
+ * @returns The first character after them, which is left to be read again,
+ *          or EOF
+ */
+static int
+bitmap_reader_skip_space__(bitmap_reader *reader,
+                           int comments)
+{
+    int c;
+
+    for(;;) {
+        c = bitmap_reader_getc__(reader);
+
+        if(comments && c == '#') {
+            do {
+                c = bitmap_reader_getc__(reader);
+            } while(c != EOF && c != '\n');
+        }
+
+        if(c == EOF || !isspace(c))
+            break;
+    }
+
+    if(c != EOF)
+        reader->pos--;
+
+    return c;
+}
+
+/**
+ * @internal
+ *
+ * Reads an unsigned decimal number, skipping whitespace before it
+ *
+ * @returns 1 on success, 0 if no number was found
+ */
+static int
+bitmap_reader_read_uint__(bitmap_reader *reader,
+                          unsigned int *value,
+                          int comments)
+{
+    int c, digits = 0;
+
+    bitmap_reader_skip_space__(reader, comments);
+
+    *value = 0;
+    c = bitmap_reader_getc__(reader);
+    while(c >= '0' && c <= '9') {
+        *value = *value * 10 + (c - '0');
+        digits++;
+
+        c = bitmap_reader_getc__(reader);
+    }
+
+    /* Leave the character after the number to be parsed again */
+    if(c != EOF)
+        reader->pos--;
+
+    return digits > 0;
+}
+
+/**
+ * @internal
+ *
+ * Stores consecutive points in a bitmap, moving on to the next row as needed
+ *
+ * @param map  The bitmap to use. Its points must all be clear.
+ * @param x    Pointer to the x-axis coordinate of the first point to store
+ * @param y    Pointer to the y-axis coordinate of the first point to store
+ * @param bits Values of the points, starting from the least significant bit
+ * @param n    Number of points to store, at most 16
+ */
+static void
+bitmap_reader_store__(bitmap *map,
+                      int *x,
+                      int *y,
+                      bitmap_word bits,
+                      int n)
+{
+    while(n > 0) {
+        int bit = *x % BITMAP_WORD_BITS,
+            k = BITMAP_WORD_BITS - bit;
+
+        if(k > map->width - *x)
+            k = map->width - *x;
+        if(k > n)
+            k = n;
+
+        bitmap_row(map, *y)[*x / BITMAP_WORD_BITS] |=
+            (bits & (((bitmap_word)1 << k) - 1)) << bit;
+
+        bits >>= k;
+        n -= k;
+
+        *x += k;
+        if(*x == map->width) {
+            *x = 0;
+            (*y)++;
+        }
+    }
+}
+
+#if BITMAP_READER_SSE2
+
+/**
+ * @internal
+ *
+ * Parses the next 16 characters at once, if they are all digits or whitespace
+ *
+ * @param reader The reader to use
+ * @param bits   Receives the values of the points read
+ * @param n      Receives the number of points read
+ *
+ * @returns 1 if the characters were parsed, 0 if fewer than 16 characters are
+ *          buffered or any of them must be looked at separately
+ */
+static int
+bitmap_reader_block__(bitmap_reader *reader,
+                      bitmap_word *bits,
+                      int *n)
+{
+    __m128i chunk;
+    unsigned int ones, digits;
+
+    if(reader->len - reader->pos < 16)
+        return 0;
+
+    chunk = _mm_loadu_si128((const __m128i*)(reader->buffer + reader->pos));
+
+    ones = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('1')));
+    digits = ones
+             | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('0')));
+
+    if(digits == 0xFFFF) {
+        /* Digits only: each character is a point, in order */
+        *bits = ones;
+        *n = 16;
+    } else {
+        __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                         _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')),
+                         _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))));
+
+        if((digits | _mm_movemask_epi8(space)) != 0xFFFF)
+            return 0;
+
+        if(digits == 0x5555 || digits == 0xAAAA) {
+            /* Digits separated by single spaces: gather every other bit */
+            bitmap_word b = ((digits == 0x5555) ? ones : ones >> 1) & 0x5555;
+
+            b = (b | (b >> 1)) & 0x3333;
+            b = (b | (b >> 2)) & 0x0F0F;
+            b = (b | (b >> 4)) & 0x00FF;
+
+            *bits = b;
+            *n = 8;
+        } else {
+            *bits = 0;
+            *n = 0;
+
+            while(digits != 0) {
+                int i = bit_ctz((bitmap_word)digits);
+
+                *bits |= (bitmap_word)((ones >> i) & 1) << *n;
+                (*n)++;
+
+                digits &= digits - 1;
+            }
+        }
+    }
+
+    reader->pos += 16;
+    return 1;
+}
+
+#endif /* BITMAP_READER_SSE2 */
+
+/**
+ * @internal
+ *
+ * Reads the points of a bitmap, which follow its header
+ *
+ * @returns The read bitmap, or NULL on errors
+ */
+static bitmap*
+bitmap_reader_read_points__(bitmap_reader *reader,
+                            unsigned int width,
+                            unsigned int height)
+{
+    size_t remaining;
+    bitmap* map;
+    int x = 0, y = 0;
+
+    map = bitmap_new(width, height);
+    if(map == NULL)
+        return NULL;
+
+    /* Row boundaries don't matter in the input, which is just a sequence of
+       width * height points */
+    remaining = (size_t)width * height;
+    while(remaining > 0) {
+        int c;
+
+#if BITMAP_READER_SSE2
+        bitmap_word bits;
+        int n;
+
+        /* A block can't hold more than 16 points, so it never reaches past
+           the last one */
+        if(remaining >= 16 && bitmap_reader_block__(reader, &bits, &n)) {
+            bitmap_reader_store__(map, &x, &y, bits, n);
+            remaining -= n;
+            continue;
+        }
+#endif
+
+        c = bitmap_reader_getc__(reader);
+        if(c == EOF) {
+            fprintf(stderr, "ERROR: Missing bits in row %d, col %d.\n", y, x);
+            goto error;
+        }
+
+        if(isspace(c))
+            continue;
+
+        if(c != '0' && c != '1') {
+            fprintf(stderr, "ERROR: Invalid bitmap char '%c' in row %d, "
+                            "col %d.\n", c, y, x);
+            goto error;
+        }
+
+        bitmap_reader_store__(map, &x, &y, c - '0', 1);
+        remaining--;
+    }
+
+    return map;
+
+error:
+    bitmap_free(map);
+    return NULL;
+}
+
+bitmap*
+bitmap_reader_read(bitmap_reader *reader)
+{
+    unsigned int width, height;
+
+    if(!bitmap_reader_read_uint__(reader, &height, 0)
+       || !bitmap_reader_read_uint__(reader, &width, 0)
+       || width == 0 || height == 0)
+    {
+        return NULL;
+    }
+
+    return bitmap_reader_read_points__(reader, width, height);
+}
+
+bitmap*
+bitmap_reader_read_p1(bitmap_reader *reader)
+{
+    unsigned int width, height;
+
+    if(bitmap_reader_skip_space__(reader, 1) == EOF)
+        return NULL;
+
+    if(bitmap_reader_getc__(reader) != 'P'
+       || bitmap_reader_getc__(reader) != '1')
+    {
+        fprintf(stderr, "ERROR: Not a plain PBM (P1) image.\n");
+        return NULL;
+    }
+
+    /* Unlike our own format, PBM gives the width first */
+    if(!bitmap_reader_read_uint__(reader, &width, 1)
+       || !bitmap_reader_read_uint__(reader, &height, 1)
+       || width == 0 || height == 0)
+    {
+        fprintf(stderr, "ERROR: Invalid PBM image size.\n");
+        return NULL;
+    }
+
+    return bitmap_reader_read_points__(reader, width, height);
+}
+
+int
+bitmap_reader_read_volume_header(bitmap_reader *reader,
+                                 int *width,
+                                 int *height,
+                                 int *depth)
+{
+    unsigned int w, h, d;
+
+    if(!bitmap_reader_read_uint__(reader, &d, 0)
+       || !bitmap_reader_read_uint__(reader, &h, 0)
+       || !bitmap_reader_read_uint__(reader, &w, 0)
+       || w == 0 || h == 0 || d == 0)
+    {
+        return 0;
+    }
+
+    *width = (int)w;
+    *height = (int)h;
+    *depth = (int)d;
+
+    return 1;
+}
+
+bitmap*
+bitmap_reader_read_slice(bitmap_reader *reader,
+                         int width,
+                         int height)
+{
+    if(width <= 0 || height <= 0)
+        return NULL;
+
+    return bitmap_reader_read_points__(reader, width, height);
+}
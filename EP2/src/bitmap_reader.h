@@ -0,0 +1,118 @@
+/** @file bitmap_reader.h
+ *
+ * Buffered bulk reader for the text bitmap format
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_READER_H
+#define BITMAP_READER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bitmap.h"
+
+/** Size of the blocks read from the input at once, in bytes */
+#define BITMAP_READER_BLOCK_SIZE (256 * 1024)
+
+/**
+ * Reader of consecutive bitmaps from a file, in the same format as
+ * bitmap_read(). The input is read in large blocks, so a reader may consume
+ * past the end of the bitmap it returns: keep using the same reader for the
+ * rest of the file.
+ */
+typedef struct {
+    /** The file to read from */
+    FILE *file;
+    /** Block of input read from the file */
+    char *buffer;
+    /** Position of the next unparsed character in the buffer */
+    size_t pos;
+    /** Number of characters in the buffer */
+    size_t len;
+} bitmap_reader;
+
+/**
+ * Creates a new reader
+ *
+ * @param infile The file to read from
+ *
+ * @returns The new reader, or NULL on memory allocation failure
+ */
+bitmap_reader*
+bitmap_reader_new(FILE *infile);
+
+/**
+ * Frees a reader. The file is not closed.
+ *
+ * @param reader A reader to free
+ */
+void
+bitmap_reader_free(bitmap_reader *reader);
+
+/**
+ * Reads the next bitmap.
+ *
+ * Whole blocks of 16 characters are checked and packed at once with SSE2
+ * when it is available. Any block that is not made only of digits and
+ * whitespace, like one containing an error, is parsed one character at a time.
+ *
+ * @param reader The reader to use
+ *
+ * @returns The read bitmap, or NULL at the end of the input, on a bitmap of
+ *          width or height 0 and on errors
+ */
+bitmap*
+bitmap_reader_read(bitmap_reader *reader);
+
+/**
+ * Reads the next image in the plain PBM (P1) format: a "P1" header with the
+ * width and height, in that order, followed by the points. Comments are
+ * allowed in the header, and the points are parsed as in
+ * bitmap_reader_read().
+ *
+ * @param reader The reader to use
+ *
+ * @returns The read bitmap, or NULL at the end of the input and on errors
+ */
+bitmap*
+bitmap_reader_read_p1(bitmap_reader *reader);
+
+/**
+ * Reads the header of the next volume of stacked slices: its depth, height
+ * and width, in that order. The slices follow one after the other, each one
+ * made of height * width points as in bitmap_reader_read() but without a
+ * header of its own. Read them with bitmap_reader_read_slice().
+ *
+ * @param reader The reader to use
+ * @param width  Receives the width of the slices
+ * @param height Receives the height of the slices
+ * @param depth  Receives the number of slices
+ *
+ * @returns 1 on success, 0 at the end of the input or on a volume with any
+ *          size of 0
+ */
+int
+bitmap_reader_read_volume_header(bitmap_reader *reader,
+                                 int *width,
+                                 int *height,
+                                 int *depth);
+
+/**
+ * Reads the points of the next slice of a volume, after its header or the
+ * previous slice
+ *
+ * @param reader The reader to use
+ * @param width  Width of the slice
+ * @param height Height of the slice
+ *
+ * @returns The read slice, or NULL on errors
+ */
+bitmap*
+bitmap_reader_read_slice(bitmap_reader *reader,
+                         int width,
+                         int height);
+
+#endif /* BITMAP_READER_H */
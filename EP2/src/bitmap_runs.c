@@ -0,0 +1,316 @@
+/** @file bitmap_runs.c
+ *
+ * Run-length based connected component labeling
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+
+#include "bitmap.h"
+#include "bitops.h"
+#include "union_find.h"
+#include "bitmap_runs.h"
+
+int
+bitmap_run_append(bitmap_run **runs,
+                  size_t *count,
+                  size_t *capacity,
+                  int y,
+                  int x_start,
+                  int x_end)
+{
+    if(*count == *capacity) {
+        size_t new_capacity = (*capacity != 0) ? *capacity * 2 : 64;
+        bitmap_run *new_runs = realloc(*runs,
+                                       new_capacity * sizeof(*new_runs));
+        if(new_runs == NULL)
+            return 0;
+
+        *runs = new_runs;
+        *capacity = new_capacity;
+    }
+
+    (*runs)[*count].y = y;
+    (*runs)[*count].x_start = x_start;
+    (*runs)[*count].x_end = x_end;
+    (*count)++;
+
+    return 1;
+}
+
+int
+bitmap_row_runs(const bitmap *map,
+                int y,
+                bitmap_run **runs,
+                size_t *count,
+                size_t *capacity)
+{
+    const bitmap_word *row = bitmap_row(map, y);
+    size_t w;
+    int open = 0, run_start = 0;
+
+    for(w = 0; w < map->stride; w++) {
+        bitmap_word word = row[w];
+        int base = (int)(w * BITMAP_WORD_BITS),
+            pos = 0;
+
+        /* Alternate between looking for the next set bit, which starts a
+           run, and the next clear bit, which ends it. A run still open at
+           the end of a word continues into the next one. */
+        while(pos < BITMAP_WORD_BITS) {
+            bitmap_word rest;
+
+            if(!open) {
+                rest = word >> pos;
+                if(rest == 0)
+                    break;
+
+                pos += bit_ctz(rest);
+                run_start = base + pos;
+                open = 1;
+            } else {
+                rest = ~word >> pos;
+                if(rest == 0)
+                    break;
+
+                pos += bit_ctz(rest);
+                open = 0;
+
+                if(!bitmap_run_append(runs, count, capacity, y, run_start,
+                                      base + pos))
+                {
+                    return 0;
+                }
+            }
+        }
+    }
+
+    /* The padding bits are clear, so only a run reaching the very end of a
+       full last word is still open here. */
+    if(open && !bitmap_run_append(runs, count, capacity, y, run_start,
+                                  map->width))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+int
+bitmap_source_row_runs(const void *source,
+                       int y,
+                       bitmap_run **runs,
+                       size_t *count,
+                       size_t *capacity)
+{
+    return bitmap_row_runs(source, y, runs, count, capacity);
+}
+
+bitmap_region_list*
+bitmap_find_all_run_regions(const bitmap *map,
+                            bitmap_connectivity connectivity)
+{
+    if(map == NULL || map->data == NULL)
+        return NULL;
+
+    return bitmap_find_all_source_run_regions(map, map->width, map->height,
+                                              bitmap_source_row_runs,
+                                              connectivity);
+}
+
+bitmap_region_list*
+bitmap_find_all_source_run_regions(const void *source,
+                                   int width,
+                                   int height,
+                                   bitmap_row_runs_func row_runs,
+                                   bitmap_connectivity connectivity)
+{
+    bitmap_run_scan scan;
+    bitmap_region_list *result = NULL;
+    size_t *offsets = NULL;
+    region_label region_count;
+
+    (void)width;
+
+    if(source == NULL || !bitmap_run_scan_init(&scan, 0))
+        return NULL;
+
+    if(bitmap_run_scan_source(&scan, source, height, row_runs, connectivity,
+                              &region_count))
+    {
+        result = bitmap_region_list_alloc(region_count, scan.run_count);
+        offsets = malloc(((size_t)region_count + 1) * sizeof(*offsets));
+
+        if(result != NULL && offsets != NULL) {
+            bitmap_run_scan_regions(&scan, region_count, result, offsets);
+        } else {
+            bitmap_region_list_free(result);
+            result = NULL;
+        }
+    }
+
+    free(offsets);
+    bitmap_run_scan_free(&scan);
+
+    return result;
+}
+
+int
+bitmap_run_scan_init(bitmap_run_scan *scan,
+                     size_t run_capacity)
+{
+    scan->runs = NULL;
+    scan->run_count = 0;
+    scan->run_capacity = 0;
+    scan->run_labels = NULL;
+    scan->label_capacity = 0;
+
+    if(!union_find_init(&scan->uf, (run_capacity > 63)
+                                   ? (region_label)run_capacity + 1 : 64))
+    {
+        return 0;
+    }
+
+    if(run_capacity != 0) {
+        scan->runs = malloc(run_capacity * sizeof(*scan->runs));
+        scan->run_labels = malloc(run_capacity * sizeof(*scan->run_labels));
+        if(scan->runs == NULL || scan->run_labels == NULL) {
+            bitmap_run_scan_free(scan);
+            return 0;
+        }
+
+        scan->run_capacity = scan->label_capacity = run_capacity;
+    }
+
+    return 1;
+}
+
+void
+bitmap_run_scan_free(bitmap_run_scan *scan)
+{
+    free(scan->runs);
+    free(scan->run_labels);
+    union_find_free(&scan->uf);
+
+    scan->runs = NULL;
+    scan->run_labels = NULL;
+    scan->run_count = scan->run_capacity = scan->label_capacity = 0;
+}
+
+int
+bitmap_run_scan_source(bitmap_run_scan *scan,
+                       const void *source,
+                       int height,
+                       bitmap_row_runs_func row_runs,
+                       bitmap_connectivity connectivity,
+                       region_label *region_count)
+{
+    size_t prev_start = 0, prev_end = 0, i, j, k;
+    int y, reach;
+
+    /* How far past its ends a run reaches into the next row */
+    reach = (connectivity == BITMAP_CONNECTIVITY_8) ? 1 : 0;
+
+    scan->run_count = 0;
+    union_find_clear(&scan->uf);
+
+    for(y = 0; y < height; y++) {
+        const bitmap_run *runs;
+        region_label *labels;
+        size_t cur_start = scan->run_count;
+
+        if(!row_runs(source, y, &scan->runs, &scan->run_count,
+                     &scan->run_capacity))
+        {
+            return 0;
+        }
+
+        /* Keep room for a label per run */
+        if(scan->label_capacity < scan->run_capacity) {
+            region_label *new_labels =
+                realloc(scan->run_labels,
+                        scan->run_capacity * sizeof(*new_labels));
+            if(new_labels == NULL)
+                return 0;
+
+            scan->run_labels = new_labels;
+            scan->label_capacity = scan->run_capacity;
+        }
+
+        runs = scan->runs;
+        labels = scan->run_labels;
+
+        /* Both rows' runs are sorted by position, so the touching runs of
+           the previous row are found walking both in step. */
+        j = prev_start;
+        for(i = cur_start; i < scan->run_count; i++) {
+            const bitmap_run *cur = &runs[i];
+
+            while(j < prev_end && runs[j].x_end + reach <= cur->x_start)
+                j++;
+
+            labels[i] = 0;
+            for(k = j; k < prev_end && runs[k].x_start < cur->x_end + reach;
+                k++)
+            {
+                if(labels[i] == 0)
+                    labels[i] = labels[k];
+                else if(labels[i] != labels[k])
+                    union_find_union(&scan->uf, labels[i], labels[k]);
+            }
+
+            if(labels[i] == 0) {
+                labels[i] = union_find_make_set(&scan->uf);
+                if(labels[i] == 0)
+                    return 0;
+            }
+        }
+
+        prev_start = cur_start;
+        prev_end = scan->run_count;
+    }
+
+    *region_count = union_find_flatten(&scan->uf);
+
+    return 1;
+}
+
+void
+bitmap_run_scan_regions(const bitmap_run_scan *scan,
+                        region_label region_count,
+                        bitmap_region_list *list,
+                        size_t *offsets)
+{
+    region_label label;
+    size_t i;
+
+    list->region_count = region_count;
+    list->run_count = scan->run_count;
+
+    for(label = 0; label < region_count; label++) {
+        list->regions[label].run_count = 0;
+        list->regions[label].area = 0;
+    }
+
+    for(i = 0; i < scan->run_count; i++) {
+        bitmap_region *region =
+            &list->regions[bitmap_run_scan_region(scan, i) - 1];
+
+        region->run_count++;
+        region->area += scan->runs[i].x_end - scan->runs[i].x_start;
+    }
+
+    /* Place each region's runs after the previous region's, keeping them in
+       row-major order. */
+    offsets[0] = 0;
+    for(label = 0; label < region_count; label++) {
+        list->regions[label].runs = list->runs + offsets[label];
+        offsets[label + 1] = offsets[label] + list->regions[label].run_count;
+    }
+
+    for(i = 0; i < scan->run_count; i++)
+        list->runs[offsets[bitmap_run_scan_region(scan, i) - 1]++] =
+            scan->runs[i];
+}
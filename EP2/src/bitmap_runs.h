@@ -0,0 +1,209 @@
+/** @file bitmap_runs.h
+ *
+ * Run-length based connected component labeling
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_RUNS_H
+#define BITMAP_RUNS_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+#include "union_find.h"
+
+/**
+ * Function appending the runs of a row of some source of points to an array,
+ * with the same parameters as bitmap_row_runs(). The runs must be sorted by
+ * position.
+ */
+typedef int (*bitmap_row_runs_func)(const void *source,
+                                    int y,
+                                    bitmap_run **runs,
+                                    size_t *count,
+                                    size_t *capacity);
+
+/**
+ * Runs of a source of points, each labeled in a union-find whose sets are the
+ * regions. The arrays only ever grow, so a scan reused for source after
+ * source stops allocating memory once it fits the largest one.
+ */
+typedef struct {
+    /** Runs of the source, row by row */
+    bitmap_run *runs;
+    /** Number of runs */
+    size_t run_count;
+    /** Number of runs the runs array has room for */
+    size_t run_capacity;
+    /** Label of each run in the union-find */
+    region_label *run_labels;
+    /** Number of labels the run_labels array has room for */
+    size_t label_capacity;
+    /** Sets of labels making up each region */
+    union_find uf;
+} bitmap_run_scan;
+
+/**
+ * Retrieves the region of a run of a scan, from 1 up to the number of
+ * regions
+ */
+#define bitmap_run_scan_region(scan, run) \
+    ((scan)->uf.parent[(scan)->run_labels[run]])
+
+/**
+ * Appends a run to an array of runs, growing it if needed
+ *
+ * @param runs     Pointer to a pointer to an array of runs, that will be
+ *                 reallocated as needed
+ * @param count    Pointer to the number of runs in the array
+ * @param capacity Pointer to the number of runs the array has room for
+ * @param y        0-based position of the run's row in the y-axis
+ * @param x_start  Position of the first point of the run in the x-axis
+ * @param x_end    Position one past the last point of the run in the x-axis
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+bitmap_run_append(bitmap_run **runs,
+                  size_t *count,
+                  size_t *capacity,
+                  int y,
+                  int x_start,
+                  int x_end);
+
+/**
+ * Appends the runs of a row of a bitmap to an array, scanning the packed
+ * words for run boundaries with bit scan instructions.
+ *
+ * @param map      The bitmap to use
+ * @param y        0-based position of the row in the y-axis
+ * @param runs     Pointer to a pointer to an array of runs, that will be
+ *                 reallocated as needed
+ * @param count    Pointer to the number of runs in the array
+ * @param capacity Pointer to the number of runs the array has room for
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+bitmap_row_runs(const bitmap *map,
+                int y,
+                bitmap_run **runs,
+                size_t *count,
+                size_t *capacity);
+
+/**
+ * bitmap_row_runs() as a bitmap_row_runs_func, for a source that is a
+ * bitmap.
+ */
+int
+bitmap_source_row_runs(const void *source,
+                       int y,
+                       bitmap_run **runs,
+                       size_t *count,
+                       size_t *capacity);
+
+/**
+ * Retrieves all the connected regions of a bitmap as lists of runs.
+ *
+ * The runs of each row are extracted first, and then runs that touch runs of
+ * the previous row are merged into the same region with a union-find: with
+ * 4-connectivity runs touch when they overlap, with 8-connectivity when they
+ * overlap or meet diagonally. The work done scales with the number of runs
+ * instead of the number of points. Regions are ordered as in
+ * bitmap_find_all_regions().
+ *
+ * @param map          The bitmap to use. It is not modified.
+ * @param connectivity Connectivity of the regions
+ *
+ * @returns The list of regions, or NULL on error
+ */
+bitmap_region_list*
+bitmap_find_all_run_regions(const bitmap *map,
+                            bitmap_connectivity connectivity);
+
+/**
+ * Retrieves all the connected regions of any source of points that can
+ * produce runs one row at a time, in the same way as
+ * bitmap_find_all_run_regions().
+ *
+ * @param source       The source of points, passed on to row_runs
+ * @param width        Width of the source
+ * @param height       Height of the source
+ * @param row_runs     Function producing the runs of each row of the source
+ * @param connectivity Connectivity of the regions
+ *
+ * @returns The list of regions, or NULL on error
+ */
+bitmap_region_list*
+bitmap_find_all_source_run_regions(const void *source,
+                                   int width,
+                                   int height,
+                                   bitmap_row_runs_func row_runs,
+                                   bitmap_connectivity connectivity);
+
+/**
+ * Initializes an empty scan
+ *
+ * @param scan         The scan to initialize
+ * @param run_capacity Number of runs to reserve room for, with their labels.
+ *                     The arrays grow as needed past it.
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+bitmap_run_scan_init(bitmap_run_scan *scan,
+                     size_t run_capacity);
+
+/**
+ * Frees the memory of a scan
+ *
+ * @param scan The scan to free
+ */
+void
+bitmap_run_scan_free(bitmap_run_scan *scan);
+
+/**
+ * Extracts the runs of every row of a source of points into a scan, and
+ * merges the runs that touch runs of the previous row into the same region,
+ * as described in bitmap_find_all_run_regions(). The previous contents of
+ * the scan are discarded.
+ *
+ * Regions are numbered from 1 in the order their first run is found, see
+ * bitmap_run_scan_region().
+ *
+ * @param scan         The scan to fill
+ * @param source       The source of points, passed on to row_runs
+ * @param height       Height of the source
+ * @param row_runs     Function producing the runs of each row of the source
+ * @param connectivity Connectivity of the regions
+ * @param region_count Receives the number of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+bitmap_run_scan_source(bitmap_run_scan *scan,
+                       const void *source,
+                       int height,
+                       bitmap_row_runs_func row_runs,
+                       bitmap_connectivity connectivity,
+                       region_label *region_count);
+
+/**
+ * Groups the runs of a scan by region into a list of regions, keeping each
+ * region's runs in row-major order
+ *
+ * @param scan         The scan to use
+ * @param region_count Number of regions of the scan
+ * @param list         The list to fill, with room for region_count regions
+ *                     and for all runs of the scan
+ * @param offsets      Scratch array of room for region_count + 1 positions
+ */
+void
+bitmap_run_scan_regions(const bitmap_run_scan *scan,
+                        region_label region_count,
+                        bitmap_region_list *list,
+                        size_t *offsets);
+
+#endif /* BITMAP_RUNS_H */
@@ -0,0 +1,566 @@
+/** @file bitmap_stream.c
+ *
+ * Streaming region labeling, one row at a time
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "bitmap.h"
+#include "bitmap_runs.h"
+#include "union_find.h"
+#include "region_features.h"
+#include "bitmap_stream.h"
+
+/**
+ * @internal
+ *
+ * Working state of the streaming labeler. Labels only live for two rows: the
+ * regions touching the previous row are numbered from 1 to live_count, and
+ * the union-find is rebuilt from those for every new row.
+ */
+typedef struct {
+    /** Runs of the previous row */
+    bitmap_run *prev_runs;
+    size_t prev_count, prev_capacity;
+    /** Label of each run of the previous row, from 1 to live_count */
+    region_label *prev_labels;
+    size_t prev_label_capacity;
+
+    /** Runs of the current row */
+    bitmap_run *cur_runs;
+    size_t cur_count, cur_capacity;
+    /** Label of each run of the current row */
+    region_label *cur_labels;
+    size_t cur_label_capacity;
+
+    /** How far past its ends a run reaches into the next row: 1 with
+        8-connectivity, 0 otherwise */
+    int reach;
+
+    /** Number of regions touching the previous row */
+    region_label live_count;
+    /** Connectivity between the live regions and the current row's runs */
+    union_find uf;
+
+    /** Features of each label in the union-find */
+    region_features *features;
+    /** Scratch array, one entry per label in the union-find */
+    region_label *compact;
+    /** Number of entries features and compact have room for */
+    size_t label_capacity;
+} bitmap_stream__;
+
+/**
+ * @internal
+ *
+ * Reads the next row of a bitmap into a single-row bitmap
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+bitmap_stream_read_row__(FILE *infile,
+                         bitmap *row,
+                         int y)
+{
+    bitmap_word *data = bitmap_row(row, 0), word = 0;
+    int x = 0;
+
+    while(x < row->width) {
+        int c = getc(infile);
+        if(c == EOF) {
+            fprintf(stderr, "ERROR: Missing bits in row %d, col %d.\n", y, x);
+            return 0;
+        }
+
+        if(isspace(c))
+            continue;
+
+        switch(c) {
+        case '0':
+            break;
+        case '1':
+            word |= (bitmap_word)1 << (x % BITMAP_WORD_BITS);
+            break;
+        default:
+            fprintf(stderr, "ERROR: Invalid bitmap char '%c'.\n", c);
+            return 0;
+        }
+
+        if(++x % BITMAP_WORD_BITS == 0 || x >= row->width) {
+            data[(x - 1) / BITMAP_WORD_BITS] = word;
+            word = 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Grows an array of labels to hold at least a certain number of entries
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+static int
+bitmap_stream_reserve_labels__(region_label **labels,
+                               size_t *capacity,
+                               size_t count)
+{
+    region_label *new_labels;
+
+    if(*capacity >= count)
+        return 1;
+
+    new_labels = realloc(*labels, count * sizeof(*new_labels));
+    if(new_labels == NULL)
+        return 0;
+
+    *labels = new_labels;
+    *capacity = count;
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * Creates a label for a run that does not touch any live region
+ *
+ * @returns The new label, or 0 on memory allocation failure
+ */
+static region_label
+bitmap_stream_new_label__(bitmap_stream__ *stream,
+                          const bitmap_run *run)
+{
+    region_label label = union_find_make_set(&stream->uf);
+
+    if(label == 0)
+        return 0;
+
+    /* Keep the per-label arrays as large as the union-find */
+    if(stream->label_capacity < stream->uf.capacity) {
+        size_t new_capacity = stream->uf.capacity;
+        region_features *new_features;
+
+        new_features = realloc(stream->features,
+                               new_capacity * sizeof(*new_features));
+        if(new_features == NULL)
+            return 0;
+        stream->features = new_features;
+
+        if(!bitmap_stream_reserve_labels__(&stream->compact,
+                                           &stream->label_capacity,
+                                           new_capacity))
+        {
+            return 0;
+        }
+    }
+
+    region_features_init(&stream->features[label], run);
+
+    return label;
+}
+
+/**
+ * @internal
+ *
+ * Labels the runs of the current row against the previous row's, reports the
+ * regions that did not reach the current row and renumbers the rest.
+ *
+ * @returns The number of regions reported, or (size_t)-1 on memory allocation
+ *          failure
+ */
+static size_t
+bitmap_stream_label_row__(bitmap_stream__ *stream,
+                          bitmap_region_callback callback,
+                          void *arg)
+{
+    const bitmap_run *prev_runs = stream->prev_runs;
+    region_label *prev_labels = stream->prev_labels,
+                 *cur_labels = stream->cur_labels,
+                 *compact, label, live_count = 0;
+    region_features *features = stream->features;
+    size_t i, j = 0, k, reported = 0;
+
+    union_find_clear(&stream->uf);
+    for(label = 1; label <= stream->live_count; label++)
+        union_find_make_set(&stream->uf);
+
+    /* Same walk as bitmap_find_all_run_regions(), one row at a time */
+    for(i = 0; i < stream->cur_count; i++) {
+        const bitmap_run *cur = &stream->cur_runs[i];
+
+        while(j < stream->prev_count
+              && prev_runs[j].x_end + stream->reach <= cur->x_start)
+        {
+            j++;
+        }
+
+        cur_labels[i] = 0;
+        for(k = j; k < stream->prev_count
+                   && prev_runs[k].x_start < cur->x_end + stream->reach; k++)
+        {
+            int start = (cur->x_start > prev_runs[k].x_start)
+                        ? cur->x_start : prev_runs[k].x_start,
+                end = (cur->x_end < prev_runs[k].x_end)
+                      ? cur->x_end : prev_runs[k].x_end;
+
+            /* Runs touching only diagonally share no sides, and end up
+               with end == start */
+            region_features_add_contact(&features[prev_labels[k]],
+                                        (size_t)(end - start));
+
+            if(cur_labels[i] == 0)
+                cur_labels[i] = prev_labels[k];
+            else if(cur_labels[i] != prev_labels[k])
+                union_find_union(&stream->uf, cur_labels[i], prev_labels[k]);
+        }
+
+        if(cur_labels[i] != 0) {
+            region_features_add_run(&features[cur_labels[i]], cur);
+        } else {
+            cur_labels[i] = bitmap_stream_new_label__(stream, cur);
+            if(cur_labels[i] == 0)
+                return (size_t)-1;
+
+            /* Might have moved */
+            features = stream->features;
+        }
+    }
+
+    compact = stream->compact;
+
+    /* Fold every label's features into its root. Roots come before the
+       labels under them, and are never merged into anything else. */
+    for(label = 1; label < stream->uf.count; label++) {
+        region_label root = union_find_find(&stream->uf, label);
+
+        compact[label] = 0;
+        if(root != label)
+            region_features_merge(&features[root], &features[label]);
+    }
+
+    for(i = 0; i < stream->cur_count; i++) {
+        cur_labels[i] = union_find_find(&stream->uf, cur_labels[i]);
+        compact[cur_labels[i]] = 1;
+    }
+
+    /* Regions that did not reach this row can't grow anymore. The others are
+       renumbered from 1, and their features moved down to match. */
+    for(label = 1; label < stream->uf.count; label++) {
+        if(stream->uf.parent[label] != label)
+            continue;
+
+        if(compact[label] == 0) {
+            callback(&features[label], arg);
+            reported++;
+        } else {
+            compact[label] = ++live_count;
+            features[live_count] = features[label];
+        }
+    }
+
+    for(i = 0; i < stream->cur_count; i++)
+        cur_labels[i] = compact[cur_labels[i]];
+
+    stream->live_count = live_count;
+
+    return reported;
+}
+
+/**
+ * @internal
+ *
+ * Frees the memory used by the streaming labeler
+ */
+static void
+bitmap_stream_free__(bitmap_stream__ *stream)
+{
+    free(stream->prev_runs);
+    free(stream->prev_labels);
+    free(stream->cur_runs);
+    free(stream->cur_labels);
+    free(stream->features);
+    free(stream->compact);
+    union_find_free(&stream->uf);
+}
+
+int
+bitmap_stream_source_regions(const void *source,
+                             int width,
+                             int height,
+                             bitmap_row_runs_func row_runs,
+                             bitmap_connectivity connectivity,
+                             bitmap_region_callback callback,
+                             void *arg,
+                             size_t *region_count)
+{
+    bitmap_stream__ stream;
+    size_t regions = 0, reported;
+    region_label label;
+    int y;
+
+    if(region_count != NULL)
+        *region_count = 0;
+
+    memset(&stream, 0, sizeof(stream));
+    stream.reach = (connectivity == BITMAP_CONNECTIVITY_8) ? 1 : 0;
+
+    if(!union_find_init(&stream.uf, width / 2 + 1))
+        goto error;
+
+    for(y = 0; y < height; y++) {
+        bitmap_run *swap_runs;
+        region_label *swap_labels;
+        size_t swap_size;
+
+        stream.cur_count = 0;
+        if(!row_runs(source, y, &stream.cur_runs, &stream.cur_count,
+                     &stream.cur_capacity)
+           || !bitmap_stream_reserve_labels__(&stream.cur_labels,
+                                              &stream.cur_label_capacity,
+                                              stream.cur_capacity))
+        {
+            goto error;
+        }
+
+        reported = bitmap_stream_label_row__(&stream, callback, arg);
+        if(reported == (size_t)-1)
+            goto error;
+
+        regions += reported;
+
+        /* The current row becomes the previous one */
+        swap_runs = stream.prev_runs;
+        stream.prev_runs = stream.cur_runs;
+        stream.cur_runs = swap_runs;
+
+        swap_size = stream.prev_capacity;
+        stream.prev_capacity = stream.cur_capacity;
+        stream.cur_capacity = swap_size;
+
+        stream.prev_count = stream.cur_count;
+
+        swap_labels = stream.prev_labels;
+        stream.prev_labels = stream.cur_labels;
+        stream.cur_labels = swap_labels;
+
+        swap_size = stream.prev_label_capacity;
+        stream.prev_label_capacity = stream.cur_label_capacity;
+        stream.cur_label_capacity = swap_size;
+    }
+
+    /* Whatever still touches the last row ends with it */
+    for(label = 1; label <= stream.live_count; label++)
+        callback(&stream.features[label], arg);
+
+    regions += stream.live_count;
+
+    if(region_count != NULL)
+        *region_count = regions;
+
+    bitmap_stream_free__(&stream);
+    return 1;
+
+error:
+    bitmap_stream_free__(&stream);
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * Rows read from a file, one at a time, for bitmap_stream_regions()
+ */
+typedef struct {
+    /** The file to read from */
+    FILE *file;
+    /** A single row of the bitmap, as read from the file */
+    bitmap *row;
+} bitmap_stream_file__;
+
+/**
+ * @internal
+ *
+ * Reads the next row of a file and appends its runs, as a
+ * bitmap_row_runs_func. Rows must be asked for in order.
+ */
+static int
+bitmap_stream_file_row_runs__(const void *source,
+                              int y,
+                              bitmap_run **runs,
+                              size_t *count,
+                              size_t *capacity)
+{
+    const bitmap_stream_file__ *file = source;
+    size_t first = *count, i;
+
+    if(!bitmap_stream_read_row__(file->file, file->row, y)
+       || !bitmap_row_runs(file->row, 0, runs, count, capacity))
+    {
+        return 0;
+    }
+
+    for(i = first; i < *count; i++)
+        (*runs)[i].y = y;
+
+    return 1;
+}
+
+int
+bitmap_stream_regions(FILE *infile,
+                      bitmap_connectivity connectivity,
+                      bitmap_region_callback callback,
+                      void *arg,
+                      size_t *region_count)
+{
+    bitmap_stream_file__ file;
+    unsigned int width, height;
+    int ok;
+
+    if(region_count != NULL)
+        *region_count = 0;
+
+    if(fscanf(infile, "%u %u", &height, &width) != 2
+       || width == 0 || height == 0)
+    {
+        return 0;
+    }
+
+    file.file = infile;
+    file.row = bitmap_new(width, 1);
+    if(file.row == NULL)
+        return -1;
+
+    ok = bitmap_stream_source_regions(&file, width, height,
+                                      bitmap_stream_file_row_runs__,
+                                      connectivity, callback, arg,
+                                      region_count);
+
+    bitmap_free(file.row);
+
+    return ok ? 1 : -1;
+}
+
+/**
+ * @internal
+ *
+ * Features of the regions found so far by bitmap_find_all_source_features()
+ */
+typedef struct {
+    region_features *features;
+    size_t count, capacity;
+    /** Set if memory ran out at any point */
+    int failed;
+} bitmap_features_list__;
+
+/**
+ * @internal
+ *
+ * Appends the features of a region to a bitmap_features_list__, as a
+ * bitmap_region_callback
+ */
+static void
+bitmap_features_append__(const region_features *features,
+                         void *arg)
+{
+    bitmap_features_list__ *list = arg;
+
+    if(list->failed)
+        return;
+
+    if(list->count == list->capacity) {
+        size_t new_capacity = (list->capacity != 0) ? list->capacity * 2 : 64;
+        region_features *new_features;
+
+        new_features = realloc(list->features,
+                               new_capacity * sizeof(*new_features));
+        if(new_features == NULL) {
+            list->failed = 1;
+            return;
+        }
+
+        list->features = new_features;
+        list->capacity = new_capacity;
+    }
+
+    list->features[list->count++] = *features;
+}
+
+/**
+ * @internal
+ *
+ * Orders the features of regions by the position of their first point in
+ * row-major order, for qsort()
+ */
+static int
+bitmap_features_compare__(const void *a,
+                          const void *b)
+{
+    const region_features *fa = a, *fb = b;
+
+    if(fa->first_y != fb->first_y)
+        return (fa->first_y < fb->first_y) ? -1 : 1;
+    if(fa->first_x != fb->first_x)
+        return (fa->first_x < fb->first_x) ? -1 : 1;
+
+    return 0;
+}
+
+int
+bitmap_find_all_source_features(const void *source,
+                                int width,
+                                int height,
+                                bitmap_row_runs_func row_runs,
+                                bitmap_connectivity connectivity,
+                                region_features **features,
+                                size_t *region_count)
+{
+    bitmap_features_list__ list;
+
+    list.features = NULL;
+    list.count = list.capacity = 0;
+    list.failed = 0;
+
+    if(!bitmap_stream_source_regions(source, width, height, row_runs,
+                                     connectivity, bitmap_features_append__,
+                                     &list, NULL)
+       || list.failed)
+    {
+        free(list.features);
+        return 0;
+    }
+
+    /* Regions come out as they end: put them back in the usual order. No two
+       regions share a first point, so the order is well defined. */
+    if(list.count > 1) {
+        qsort(list.features, list.count, sizeof(*list.features),
+              bitmap_features_compare__);
+    }
+
+    *features = list.features;
+    *region_count = list.count;
+
+    return 1;
+}
+
+int
+bitmap_find_all_features(const bitmap *map,
+                         bitmap_connectivity connectivity,
+                         region_features **features,
+                         size_t *region_count)
+{
+    if(map == NULL || map->data == NULL)
+        return 0;
+
+    return bitmap_find_all_source_features(map, map->width, map->height,
+                                           bitmap_source_row_runs, connectivity,
+                                           features, region_count);
+}
@@ -0,0 +1,125 @@
+/** @file bitmap_stream.h
+ *
+ * Streaming region labeling, one row at a time
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_STREAM_H
+#define BITMAP_STREAM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bitmap.h"
+#include "bitmap_runs.h"
+#include "region_features.h"
+
+/**
+ * Function called for every region found by bitmap_stream_regions()
+ *
+ * @param features The region's features. Only valid during the call.
+ * @param arg      The argument given to bitmap_stream_regions()
+ */
+typedef void (*bitmap_region_callback)(const region_features *features,
+                                       void *arg);
+
+/**
+ * Finds the connected regions of any source of points that can produce runs
+ * one row at a time, holding only two rows of runs at once. Rows are asked for
+ * in order, each exactly once, so the source may be read as it goes.
+ *
+ * Each region is reported as soon as a row without any of its points is
+ * found, which means regions come out in the order they end, not in the order
+ * they start.
+ *
+ * @param source       The source of points, passed on to row_runs
+ * @param width        Width of the source
+ * @param height       Height of the source
+ * @param row_runs     Function producing the runs of each row of the source
+ * @param connectivity Connectivity of the regions
+ * @param callback     Function to call for every region found
+ * @param arg          Argument to pass to the callback
+ * @param region_count If not NULL, receives the number of regions found
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+bitmap_stream_source_regions(const void *source,
+                             int width,
+                             int height,
+                             bitmap_row_runs_func row_runs,
+                             bitmap_connectivity connectivity,
+                             bitmap_region_callback callback,
+                             void *arg,
+                             size_t *region_count);
+
+/**
+ * Reads a bitmap in the same format as bitmap_read() and finds its
+ * connected regions without ever holding the whole bitmap in memory.
+ *
+ * Only the runs of the previous row and the regions that touch them are kept,
+ * so memory use depends on the width of the bitmap and not on its height.
+ * See bitmap_stream_source_regions().
+ *
+ * @param infile       The file to read from
+ * @param connectivity Connectivity of the regions
+ * @param callback     Function to call for every region found
+ * @param arg          Argument to pass to the callback
+ * @param region_count If not NULL, receives the number of regions found
+ *
+ * @returns 1 if a bitmap was read, 0 if the input ended or a bitmap of width
+ *          or height 0 was found, -1 on errors
+ */
+int
+bitmap_stream_regions(FILE *infile,
+                      bitmap_connectivity connectivity,
+                      bitmap_region_callback callback,
+                      void *arg,
+                      size_t *region_count);
+
+/**
+ * Computes the features of all the connected regions of a source of points
+ * while labeling it, without ever building lists of points or runs.
+ * Regions are ordered as in bitmap_find_all_regions().
+ *
+ * @param source       The source of points, passed on to row_runs
+ * @param width        Width of the source
+ * @param height       Height of the source
+ * @param row_runs     Function producing the runs of each row of the source
+ * @param connectivity Connectivity of the regions
+ * @param features     Receives an array with the features of each region.
+ *                     free() it after you're done.
+ * @param region_count Receives the number of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+bitmap_find_all_source_features(const void *source,
+                                int width,
+                                int height,
+                                bitmap_row_runs_func row_runs,
+                                bitmap_connectivity connectivity,
+                                region_features **features,
+                                size_t *region_count);
+
+/**
+ * Computes the features of all the connected regions of a bitmap. See
+ * bitmap_find_all_source_features().
+ *
+ * @param map          The bitmap to use. It is not modified.
+ * @param connectivity Connectivity of the regions
+ * @param features     Receives an array with the features of each region.
+ *                     free() it after you're done.
+ * @param region_count Receives the number of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+int
+bitmap_find_all_features(const bitmap *map,
+                         bitmap_connectivity connectivity,
+                         region_features **features,
+                         size_t *region_count);
+
+#endif /* BITMAP_STREAM_H */
@@ -0,0 +1,538 @@
+/** @file bitmap_tiled.c
+ *
+ * Bitmaps stored as square tiles, and labeling them one tile at a time
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "bitops.h"
+#include "bitmap_label.h"
+#include "union_find.h"
+#include "parallel.h"
+#include "bitmap_tiled.h"
+
+/** Most runs a row of a tile can have: every other point set */
+#define BITMAP_TILE_MAX_RUNS (BITMAP_TILE_SIZE / 2)
+
+/** Number of row positions kept for each tile: one per row and the end */
+#define BITMAP_TILE_ROW_STARTS (BITMAP_TILE_SIZE + 1)
+
+/** State shared by the tasks labeling the tiles of a bitmap */
+typedef struct {
+    const bitmap_tiled *tiled;
+    /** 1 if diagonal neighbours are connected, 0 otherwise */
+    int reach;
+    /** Sets of runs, run n having label n + 1 */
+    union_find uf;
+    /**
+     * Label of the first run of each row of each tile, and one past the last
+     * run of the tile
+     */
+    region_label *row_starts;
+    /** Number of runs of each tile */
+    region_label *tile_runs;
+    /** Labels of the points, width * height in row-major order */
+    region_label *labels;
+} bitmap_tiled_state;
+
+bitmap_tiled*
+bitmap_tiled_new(int width,
+                 int height)
+{
+    bitmap_tiled *tiled;
+
+    if(width <= 0 || height <= 0)
+        return NULL;
+
+    tiled = malloc(sizeof(*tiled));
+    if(tiled == NULL)
+        return NULL;
+
+    tiled->width = width;
+    tiled->height = height;
+    tiled->tiles_x = (width + BITMAP_TILE_SIZE - 1) / BITMAP_TILE_SIZE;
+    tiled->tiles_y = (height + BITMAP_TILE_SIZE - 1) / BITMAP_TILE_SIZE;
+
+    tiled->data = calloc((size_t)tiled->tiles_x * tiled->tiles_y
+                         * BITMAP_TILE_SIZE, sizeof(*tiled->data));
+    if(tiled->data == NULL) {
+        free(tiled);
+        return NULL;
+    }
+
+    return tiled;
+}
+
+void
+bitmap_tiled_free(bitmap_tiled *tiled)
+{
+    if(tiled != NULL) {
+        free(tiled->data);
+        free(tiled);
+    }
+}
+
+bitmap_tiled*
+bitmap_tiled_from_bitmap(const bitmap *map)
+{
+    bitmap_tiled *tiled;
+    int tx, y;
+
+    if(map == NULL || map->data == NULL)
+        return NULL;
+
+    tiled = bitmap_tiled_new(map->width, map->height);
+    if(tiled == NULL)
+        return NULL;
+
+    /* Words of a bitmap row line up with the tile columns, so the copy is
+       word by word */
+    for(y = 0; y < map->height; y++) {
+        const bitmap_word *row = bitmap_row(map, y);
+
+        for(tx = 0; tx < tiled->tiles_x; tx++) {
+            bitmap_tile(tiled, tx, y / BITMAP_TILE_SIZE)
+                [y % BITMAP_TILE_SIZE] = row[tx];
+        }
+    }
+
+    return tiled;
+}
+
+bitmap*
+bitmap_tiled_to_bitmap(const bitmap_tiled *tiled)
+{
+    bitmap *map;
+    int tx, y;
+
+    if(tiled == NULL || tiled->data == NULL)
+        return NULL;
+
+    map = bitmap_new(tiled->width, tiled->height);
+    if(map == NULL)
+        return NULL;
+
+    for(y = 0; y < map->height; y++) {
+        bitmap_word *row = bitmap_row(map, y);
+
+        for(tx = 0; tx < tiled->tiles_x; tx++) {
+            row[tx] = bitmap_tile(tiled, tx, y / BITMAP_TILE_SIZE)
+                          [y % BITMAP_TILE_SIZE];
+        }
+    }
+
+    return map;
+}
+
+image_bit
+bitmap_tiled_getbit(const bitmap_tiled *tiled,
+                    int x,
+                    int y)
+{
+    if(tiled == NULL || tiled->data == NULL
+       || x < 0 || x >= tiled->width
+       || y < 0 || y >= tiled->height)
+    {
+        return 0;
+    }
+
+    return (bitmap_tile(tiled, x / BITMAP_TILE_SIZE, y / BITMAP_TILE_SIZE)
+                [y % BITMAP_TILE_SIZE] >> (x % BITMAP_TILE_SIZE)) & 1;
+}
+
+void
+bitmap_tiled_setbit(bitmap_tiled *tiled,
+                    int x,
+                    int y,
+                    image_bit value)
+{
+    bitmap_word *word;
+
+    if(tiled == NULL || tiled->data == NULL
+       || x < 0 || x >= tiled->width
+       || y < 0 || y >= tiled->height)
+    {
+        return;
+    }
+
+    word = &bitmap_tile(tiled, x / BITMAP_TILE_SIZE, y / BITMAP_TILE_SIZE)
+                [y % BITMAP_TILE_SIZE];
+
+    if(value)
+        *word |= (bitmap_word)1 << (x % BITMAP_TILE_SIZE);
+    else
+        *word &= ~((bitmap_word)1 << (x % BITMAP_TILE_SIZE));
+}
+
+/**
+ * @internal
+ *
+ * Counts the runs of a word
+ */
+static region_label
+bitmap_tiled_count_runs__(bitmap_word word)
+{
+    /* A run starts at every set bit whose lower neighbour is clear */
+    return bit_popcount(word & ~(word << 1));
+}
+
+/**
+ * @internal
+ *
+ * Splits a word in runs
+ *
+ * @param word   The word
+ * @param starts Array of BITMAP_TILE_MAX_RUNS positions that will receive
+ *               the first bit of each run
+ * @param ends   Array of BITMAP_TILE_MAX_RUNS positions that will receive the
+ *               position one past the last bit of each run
+ *
+ * @returns The number of runs
+ */
+static int
+bitmap_tiled_runs__(bitmap_word word,
+                    int *starts,
+                    int *ends)
+{
+    int count = 0;
+
+    while(word != 0) {
+        int start = bit_ctz(word), end;
+        bitmap_word rest = ~word & (~(bitmap_word)0 << start);
+
+        end = (rest != 0) ? bit_ctz(rest) : BITMAP_TILE_SIZE;
+
+        starts[count] = start;
+        ends[count] = end;
+        count++;
+
+        word = (end < BITMAP_TILE_SIZE) ? word & (~(bitmap_word)0 << end) : 0;
+    }
+
+    return count;
+}
+
+/**
+ * @internal
+ *
+ * Merges the runs of two vertically adjacent words that touch each other
+ *
+ * @param uf          The union-find of the runs
+ * @param upper       The upper word
+ * @param upper_first Label of the first run of the upper word
+ * @param lower       The lower word
+ * @param lower_first Label of the first run of the lower word
+ * @param reach       1 if diagonal neighbours are connected, 0 otherwise
+ */
+static void
+bitmap_tiled_merge_words__(union_find *uf,
+                           bitmap_word upper,
+                           region_label upper_first,
+                           bitmap_word lower,
+                           region_label lower_first,
+                           int reach)
+{
+    int upper_starts[BITMAP_TILE_MAX_RUNS], upper_ends[BITMAP_TILE_MAX_RUNS],
+        lower_starts[BITMAP_TILE_MAX_RUNS], lower_ends[BITMAP_TILE_MAX_RUNS];
+    int upper_count, lower_count, i = 0, j = 0;
+
+    /* Nothing can touch without a common, or with 8-connectivity adjacent,
+       point */
+    if((upper & (lower | (reach ? (lower << 1) | (lower >> 1) : 0))) == 0)
+        return;
+
+    upper_count = bitmap_tiled_runs__(upper, upper_starts, upper_ends);
+    lower_count = bitmap_tiled_runs__(lower, lower_starts, lower_ends);
+
+    while(i < upper_count && j < lower_count) {
+        if(upper_ends[i] + reach <= lower_starts[j]) {
+            i++;
+        } else if(lower_ends[j] + reach <= upper_starts[i]) {
+            j++;
+        } else {
+            union_find_union(uf, upper_first + i, lower_first + j);
+
+            if(upper_ends[i] < lower_ends[j])
+                i++;
+            else
+                j++;
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * Counts the runs of a tile
+ *
+ * @param arg   Pointer to the bitmap_tiled_state
+ * @param index Index of the tile
+ */
+static void
+bitmap_tiled_count_tile__(void *arg,
+                          size_t index)
+{
+    bitmap_tiled_state *state = arg;
+    const bitmap_word *tile = state->tiled->data + index * BITMAP_TILE_SIZE;
+    region_label count = 0;
+    int r;
+
+    for(r = 0; r < BITMAP_TILE_SIZE; r++)
+        count += bitmap_tiled_count_runs__(tile[r]);
+
+    state->tile_runs[index] = count;
+}
+
+/**
+ * @internal
+ *
+ * Labels the runs of a tile on their own. Each tile only touches the labels
+ * of its own runs, so tiles can be labeled at the same time.
+ *
+ * @param arg   Pointer to the bitmap_tiled_state
+ * @param index Index of the tile
+ */
+static void
+bitmap_tiled_label_tile__(void *arg,
+                          size_t index)
+{
+    bitmap_tiled_state *state = arg;
+    const bitmap_word *tile = state->tiled->data + index * BITMAP_TILE_SIZE;
+    region_label *starts = state->row_starts + index * BITMAP_TILE_ROW_STARTS;
+    int r;
+
+    for(r = 0; r < BITMAP_TILE_SIZE; r++)
+        starts[r + 1] = starts[r] + bitmap_tiled_count_runs__(tile[r]);
+
+    for(r = 1; r < BITMAP_TILE_SIZE; r++) {
+        bitmap_tiled_merge_words__(&state->uf, tile[r - 1], starts[r - 1],
+                                   tile[r], starts[r], state->reach);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Merges the labels of the runs touching across the borders of a tile with
+ * the tiles to its right and below it
+ */
+static void
+bitmap_tiled_merge_borders__(bitmap_tiled_state *state,
+                             int tx,
+                             int ty)
+{
+    const bitmap_tiled *tiled = state->tiled;
+    const bitmap_word *tile = bitmap_tile(tiled, tx, ty), *other;
+    const region_label *starts, *other_starts;
+    int r, dr;
+
+    starts = state->row_starts
+             + ((size_t)ty * tiled->tiles_x + tx) * BITMAP_TILE_ROW_STARTS;
+
+    /* The last run of a row touching the right border is the row's last
+       one, and the one touching the left border is the row's first one */
+    if(tx + 1 < tiled->tiles_x) {
+        other = bitmap_tile(tiled, tx + 1, ty);
+        other_starts = starts + BITMAP_TILE_ROW_STARTS;
+
+        for(r = 0; r < BITMAP_TILE_SIZE; r++) {
+            if(!(tile[r] >> (BITMAP_TILE_SIZE - 1)))
+                continue;
+
+            for(dr = -state->reach; dr <= state->reach; dr++) {
+                if(r + dr >= 0 && r + dr < BITMAP_TILE_SIZE
+                   && (other[r + dr] & 1))
+                {
+                    union_find_union(&state->uf, starts[r + 1] - 1,
+                                     other_starts[r + dr]);
+                }
+            }
+        }
+    }
+
+    if(ty + 1 < tiled->tiles_y) {
+        other = bitmap_tile(tiled, tx, ty + 1);
+        other_starts = starts
+                       + (size_t)tiled->tiles_x * BITMAP_TILE_ROW_STARTS;
+
+        bitmap_tiled_merge_words__(&state->uf, tile[BITMAP_TILE_SIZE - 1],
+                                   starts[BITMAP_TILE_SIZE - 1], other[0],
+                                   other_starts[0], state->reach);
+
+        /* Diagonals across the corner shared by four tiles */
+        if(state->reach && tx + 1 < tiled->tiles_x) {
+            const bitmap_word *right = bitmap_tile(tiled, tx + 1, ty),
+                              *below_right = bitmap_tile(tiled, tx + 1,
+                                                         ty + 1);
+            const region_label *right_starts = starts + BITMAP_TILE_ROW_STARTS,
+                               *below_right_starts = other_starts
+                                                     + BITMAP_TILE_ROW_STARTS;
+
+            if((tile[BITMAP_TILE_SIZE - 1] >> (BITMAP_TILE_SIZE - 1))
+               && (below_right[0] & 1))
+            {
+                union_find_union(&state->uf, starts[BITMAP_TILE_SIZE] - 1,
+                                 below_right_starts[0]);
+            }
+
+            if((right[BITMAP_TILE_SIZE - 1] & 1)
+               && (other[0] >> (BITMAP_TILE_SIZE - 1)))
+            {
+                union_find_union(&state->uf,
+                                 right_starts[BITMAP_TILE_SIZE - 1],
+                                 other_starts[1] - 1);
+            }
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * Writes the final labels of the points of a tile
+ *
+ * @param arg   Pointer to the bitmap_tiled_state
+ * @param index Index of the tile
+ */
+static void
+bitmap_tiled_write_tile__(void *arg,
+                          size_t index)
+{
+    bitmap_tiled_state *state = arg;
+    const bitmap_tiled *tiled = state->tiled;
+    const bitmap_word *tile = tiled->data + index * BITMAP_TILE_SIZE;
+    const region_label *starts = state->row_starts
+                                 + index * BITMAP_TILE_ROW_STARTS;
+    int tx = (int)(index % tiled->tiles_x),
+        ty = (int)(index / tiled->tiles_x);
+    int r;
+
+    for(r = 0; r < BITMAP_TILE_SIZE; r++) {
+        int y = ty * BITMAP_TILE_SIZE + r, x_base = tx * BITMAP_TILE_SIZE,
+            width = tiled->width - x_base, b;
+        bitmap_word word = tile[r], ends = word & ~(word >> 1);
+        const region_label *parent = state->uf.parent + starts[r];
+        region_label *row;
+
+        if(y >= tiled->height)
+            break;
+
+        if(width > BITMAP_TILE_SIZE)
+            width = BITMAP_TILE_SIZE;
+
+        row = state->labels + (size_t)y * tiled->width + x_base;
+
+        /* Runs are found in the same order they were counted in. Moving past
+           the last run of the tile reads the sentinel run, never written. */
+        for(b = 0; b < width; b++) {
+            region_label set = (region_label)((word >> b) & 1);
+
+            row[b] = *parent & (0 - set);
+            parent += (ends >> b) & 1;
+        }
+    }
+}
+
+label_image*
+bitmap_tiled_label(const bitmap_tiled *tiled,
+                   bitmap_connectivity connectivity,
+                   unsigned int threads)
+{
+    bitmap_tiled_state state;
+    region_label *order = NULL, run_count = 0, region_count = 0, label;
+    size_t tile_count, t;
+    label_image *image = NULL;
+    int tx, ty, y;
+
+    if(tiled == NULL || tiled->data == NULL)
+        return NULL;
+
+    tile_count = (size_t)tiled->tiles_x * tiled->tiles_y;
+
+    state.tiled = tiled;
+    state.reach = (connectivity == BITMAP_CONNECTIVITY_8);
+    state.uf.parent = NULL;
+    state.tile_runs = malloc(tile_count * sizeof(*state.tile_runs));
+    state.row_starts = malloc(tile_count * BITMAP_TILE_ROW_STARTS
+                              * sizeof(*state.row_starts));
+    state.labels = malloc((size_t)tiled->width * tiled->height
+                          * sizeof(*state.labels));
+
+    if(state.tile_runs == NULL || state.row_starts == NULL
+       || state.labels == NULL)
+    {
+        goto out;
+    }
+
+    /* Each tile's runs get a consecutive range of labels */
+    parallel_run(bitmap_tiled_count_tile__, &state, tile_count, threads);
+
+    for(t = 0; t < tile_count; t++) {
+        state.row_starts[t * BITMAP_TILE_ROW_STARTS] = run_count + 1;
+        run_count += state.tile_runs[t];
+    }
+
+    /* One more run past the last one, for bitmap_tiled_write_tile__() */
+    if(!union_find_init(&state.uf, run_count + 2))
+        goto out;
+
+    for(label = 1; label <= run_count + 1; label++)
+        union_find_make_set(&state.uf);
+
+    parallel_run(bitmap_tiled_label_tile__, &state, tile_count, threads);
+
+    for(ty = 0; ty < tiled->tiles_y; ty++)
+        for(tx = 0; tx < tiled->tiles_x; tx++)
+            bitmap_tiled_merge_borders__(&state, tx, ty);
+
+    /* Point every run straight at its root. Parents always come before
+       their children, so a single pass is enough. */
+    for(label = 1; label <= run_count; label++)
+        state.uf.parent[label] = state.uf.parent[state.uf.parent[label]];
+
+    /* Number the regions in the order their first run is found in a
+       row-major scan of the whole bitmap, as the other labelers do */
+    order = calloc(run_count + 2, sizeof(*order));
+    if(order == NULL)
+        goto out;
+
+    for(y = 0; y < tiled->height; y++) {
+        for(tx = 0; tx < tiled->tiles_x; tx++) {
+            const region_label *starts =
+                state.row_starts
+                + ((size_t)(y / BITMAP_TILE_SIZE) * tiled->tiles_x + tx)
+                  * BITMAP_TILE_ROW_STARTS;
+            int r = y % BITMAP_TILE_SIZE;
+
+            for(label = starts[r]; label < starts[r + 1]; label++) {
+                region_label root = state.uf.parent[label];
+
+                if(order[root] == 0)
+                    order[root] = ++region_count;
+            }
+        }
+    }
+
+    for(label = 1; label <= run_count + 1; label++)
+        state.uf.parent[label] = order[state.uf.parent[label]];
+
+    parallel_run(bitmap_tiled_write_tile__, &state, tile_count, threads);
+
+    image = label_image_wrap(state.labels, tiled->width, tiled->height,
+                             region_count);
+    state.labels = NULL;
+
+out:
+    free(order);
+    free(state.labels);
+    free(state.row_starts);
+    free(state.tile_runs);
+    union_find_free(&state.uf);
+
+    return image;
+}
@@ -0,0 +1,141 @@
+/** @file bitmap_tiled.h
+ *
+ * Bitmaps stored as square tiles, and labeling them one tile at a time
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_TILED_H
+#define BITMAP_TILED_H
+
+#include "bitmap.h"
+#include "bitmap_label.h"
+
+/** Width and height of a tile, in points: one bitmap_word per tile row */
+#define BITMAP_TILE_SIZE BITMAP_WORD_BITS
+
+/**
+ * Type for a matrix of bits stored as tiles of BITMAP_TILE_SIZE x
+ * BITMAP_TILE_SIZE points.
+ *
+ * Each tile is a block of BITMAP_TILE_SIZE words, one per row of the tile,
+ * packed in the same way as the rows of a bitmap. Tiles are stored in
+ * row-major order. A point and all of its neighbours inside the same tile
+ * are then at most 512 bytes apart, instead of a whole row of the bitmap
+ * apart vertically. Bits past the width or height are always zero.
+ */
+typedef struct {
+    /** Width of the bitmap */
+    int width;
+    /** Height of the bitmap */
+    int height;
+    /** Number of tiles in each row of tiles */
+    int tiles_x;
+    /** Number of rows of tiles */
+    int tiles_y;
+    /** Pointer to an array containing the tiles_x * tiles_y tiles */
+    bitmap_word *data;
+} bitmap_tiled;
+
+/**
+ * Retrieves a pointer to a tile of a tiled bitmap
+ *
+ * @param tiled The tiled bitmap to use
+ * @param tx    0-based position of the tile in the x-axis
+ * @param ty    0-based position of the tile in the y-axis
+ *
+ * @returns Pointer to the first of the BITMAP_TILE_SIZE words of the tile
+ */
+#define bitmap_tile(tiled, tx, ty) \
+    ((tiled)->data + ((size_t)(ty) * (tiled)->tiles_x + (tx)) \
+                     * BITMAP_TILE_SIZE)
+
+/**
+ * Creates a new tiled bitmap with all bits cleared
+ *
+ * @param width  Width of the bitmap
+ * @param height Height of the bitmap
+ *
+ * @returns The new tiled bitmap, or NULL on error
+ */
+bitmap_tiled*
+bitmap_tiled_new(int width,
+                 int height);
+
+/**
+ * Frees a tiled bitmap and its associated data
+ *
+ * @param tiled A tiled bitmap to free
+ */
+void
+bitmap_tiled_free(bitmap_tiled *tiled);
+
+/**
+ * Creates a tiled copy of a bitmap
+ *
+ * @param map The bitmap to copy
+ *
+ * @returns The new tiled bitmap, or NULL on error
+ */
+bitmap_tiled*
+bitmap_tiled_from_bitmap(const bitmap *map);
+
+/**
+ * Creates a row-major copy of a tiled bitmap
+ *
+ * @param tiled The tiled bitmap to copy
+ *
+ * @returns The new bitmap, or NULL on error
+ */
+bitmap*
+bitmap_tiled_to_bitmap(const bitmap_tiled *tiled);
+
+/**
+ * Retrieves the value of a single bit from a tiled bitmap
+ *
+ * @param tiled The tiled bitmap to use
+ * @param x     0-base coordinate of the bit in the x-axis
+ * @param y     0-base coordinate of the bit in the y-axis
+ *
+ * @returns The value of the bit, or 0 if the coordinates are out of range
+ */
+image_bit
+bitmap_tiled_getbit(const bitmap_tiled *tiled,
+                    int x,
+                    int y);
+
+/**
+ * Sets the value of a single bit from a tiled bitmap
+ *
+ * @param tiled The tiled bitmap to use
+ * @param x     0-base coordinate of the bit in the x-axis
+ * @param y     0-base coordinate of the bit in the y-axis
+ * @param value The new value to attribute to the bit
+ */
+void
+bitmap_tiled_setbit(bitmap_tiled *tiled,
+                    int x,
+                    int y,
+                    image_bit value);
+
+/**
+ * Labels the regions of a tiled bitmap one tile at a time.
+ *
+ * The runs of each tile are labeled on their own, in parallel, so the rows
+ * being compared are always in the same small block of memory. The labels
+ * of neighbouring tiles are then merged along the tile borders, and written
+ * out tile by tile. Labels are the same as bitmap_label() gives.
+ *
+ * @param tiled        The tiled bitmap to use
+ * @param connectivity Connectivity of the regions
+ * @param threads      Maximum number of threads to use
+ *
+ * @returns The label image, or NULL on error
+ */
+label_image*
+bitmap_tiled_label(const bitmap_tiled *tiled,
+                   bitmap_connectivity connectivity,
+                   unsigned int threads);
+
+#endif /* BITMAP_TILED_H */
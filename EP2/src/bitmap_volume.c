@@ -0,0 +1,520 @@
+/** @file bitmap_volume.c
+ *
+ * Volumes of voxels made of stacked bitmap slices, and labeling their
+ * connected regions
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "bitmap_reader.h"
+#include "bitmap_runs.h"
+#include "union_find.h"
+#include "parallel.h"
+#include "bitmap_volume.h"
+
+/**
+ * @internal
+ *
+ * State shared by the tasks labeling the slices of a volume
+ */
+typedef struct {
+    /** The runs being labeled, run n having label n + 1 */
+    volume_labels *labels;
+    /** Sets of runs making up each region */
+    union_find uf;
+    /** Connectivity of the regions */
+    volume_connectivity connectivity;
+    /** Distance between the slices merged in the current round */
+    int span;
+} volume_state__;
+
+bitmap_volume*
+bitmap_volume_new(int width,
+                  int height,
+                  int depth)
+{
+    bitmap_volume *vol;
+
+    if(width <= 0 || height <= 0 || depth <= 0)
+        return NULL;
+
+    vol = malloc(sizeof(*vol));
+    if(vol == NULL)
+        return NULL;
+
+    vol->width = width;
+    vol->height = height;
+    vol->depth = depth;
+    vol->stride = BITMAP_STRIDE(width);
+
+    vol->data = calloc(vol->stride * height * depth, sizeof(*vol->data));
+    if(vol->data == NULL) {
+        free(vol);
+        return NULL;
+    }
+
+    return vol;
+}
+
+void
+bitmap_volume_free(bitmap_volume *vol)
+{
+    if(vol != NULL) {
+        free(vol->data);
+        free(vol);
+    }
+}
+
+image_bit
+bitmap_volume_getbit(const bitmap_volume *vol,
+                     int x,
+                     int y,
+                     int z)
+{
+    if(vol == NULL || vol->data == NULL
+       || x < 0 || x >= vol->width
+       || y < 0 || y >= vol->height
+       || z < 0 || z >= vol->depth)
+    {
+        return 0;
+    }
+
+    return (bitmap_volume_row(vol, y, z)[x / BITMAP_WORD_BITS]
+            >> (x % BITMAP_WORD_BITS)) & 1;
+}
+
+void
+bitmap_volume_setbit(bitmap_volume *vol,
+                     int x,
+                     int y,
+                     int z,
+                     image_bit value)
+{
+    bitmap_word *word;
+
+    if(vol == NULL || vol->data == NULL
+       || x < 0 || x >= vol->width
+       || y < 0 || y >= vol->height
+       || z < 0 || z >= vol->depth)
+    {
+        return;
+    }
+
+    word = &bitmap_volume_row(vol, y, z)[x / BITMAP_WORD_BITS];
+
+    if(value)
+        *word |= (bitmap_word)1 << (x % BITMAP_WORD_BITS);
+    else
+        *word &= ~((bitmap_word)1 << (x % BITMAP_WORD_BITS));
+}
+
+void
+bitmap_volume_slice(const bitmap_volume *vol,
+                    int z,
+                    bitmap *slice)
+{
+    slice->width = vol->width;
+    slice->height = vol->height;
+    slice->stride = vol->stride;
+    slice->data = bitmap_volume_row(vol, 0, z);
+}
+
+bitmap_volume*
+bitmap_volume_read(bitmap_reader *reader)
+{
+    bitmap_volume *vol;
+    int width, height, depth, z;
+
+    if(!bitmap_reader_read_volume_header(reader, &width, &height, &depth))
+        return NULL;
+
+    vol = bitmap_volume_new(width, height, depth);
+    if(vol == NULL)
+        return NULL;
+
+    for(z = 0; z < depth; z++) {
+        bitmap *slice = bitmap_reader_read_slice(reader, width, height);
+
+        if(slice == NULL) {
+            bitmap_volume_free(vol);
+            return NULL;
+        }
+
+        memcpy(bitmap_volume_row(vol, 0, z), slice->data,
+               vol->stride * height * sizeof(*vol->data));
+        bitmap_free(slice);
+    }
+
+    return vol;
+}
+
+/**
+ * @internal
+ *
+ * Joins the runs of two rows that touch each other
+ *
+ * @param uf      The union-find of the runs
+ * @param runs    All the runs
+ * @param a_first Position of the first run of one row
+ * @param a_end   Position one past the last run of that row
+ * @param b_first Position of the first run of the other row
+ * @param b_end   Position one past the last run of the other row
+ * @param reach   1 if runs meeting diagonally touch, 0 otherwise
+ */
+static void
+volume_merge_rows__(union_find *uf,
+                    const bitmap_run *runs,
+                    size_t a_first,
+                    size_t a_end,
+                    size_t b_first,
+                    size_t b_end,
+                    int reach)
+{
+    size_t i = a_first, j = b_first;
+
+    /* Both rows are sorted by position, so they are walked in step */
+    while(i < a_end && j < b_end) {
+        if(runs[i].x_end + reach <= runs[j].x_start) {
+            i++;
+        } else if(runs[j].x_end + reach <= runs[i].x_start) {
+            j++;
+        } else {
+            union_find_union(uf, (region_label)(i + 1),
+                             (region_label)(j + 1));
+
+            if(runs[i].x_end < runs[j].x_end)
+                i++;
+            else
+                j++;
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * Joins the touching runs of consecutive rows of a slice. Only labels of the
+ * slice's own runs are touched, so slices can be labeled at the same time.
+ *
+ * @param arg   Pointer to the volume_state__
+ * @param index The slice
+ */
+static void
+volume_label_slice__(void *arg,
+                     size_t index)
+{
+    volume_state__ *state = arg;
+    const volume_labels *labels = state->labels;
+    const size_t *row_first = labels->row_first + index * labels->height;
+    int reach = (state->connectivity != VOLUME_CONNECTIVITY_6), y;
+
+    for(y = 1; y < labels->height; y++) {
+        volume_merge_rows__(&state->uf, labels->runs,
+                            row_first[y - 1], row_first[y],
+                            row_first[y], row_first[y + 1], reach);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Joins the touching runs of the slices on both sides of a face. Every face
+ * of a round lies between two blocks of state->span slices already labeled,
+ * which no other face of the round touches.
+ *
+ * @param arg   Pointer to the volume_state__
+ * @param index The face's position in the round
+ */
+static void
+volume_merge_face__(void *arg,
+                    size_t index)
+{
+    volume_state__ *state = arg;
+    const volume_labels *labels = state->labels;
+    size_t z = (size_t)state->span * (2 * index + 1);
+    const size_t *front = labels->row_first + (z - 1) * labels->height,
+                 *back = labels->row_first + z * labels->height;
+    int edges = (state->connectivity != VOLUME_CONNECTIVITY_6),
+        corners = (state->connectivity == VOLUME_CONNECTIVITY_26), y;
+
+    for(y = 0; y < labels->height; y++) {
+        /* Voxels right behind each other share a face, and with 18- or
+           26-connectivity those one step to the side share an edge */
+        volume_merge_rows__(&state->uf, labels->runs, front[y], front[y + 1],
+                            back[y], back[y + 1], edges);
+
+        if(!edges)
+            continue;
+
+        /* Up or down a row, only corners touch diagonally */
+        if(y > 0) {
+            volume_merge_rows__(&state->uf, labels->runs, front[y - 1],
+                                front[y], back[y], back[y + 1], corners);
+        }
+        if(y + 1 < labels->height) {
+            volume_merge_rows__(&state->uf, labels->runs, front[y + 1],
+                                front[y + 2], back[y], back[y + 1], corners);
+        }
+    }
+}
+
+volume_labels*
+volume_label_source(const void *source,
+                    int width,
+                    int height,
+                    int depth,
+                    volume_slice_runs_func slice_runs,
+                    volume_connectivity connectivity,
+                    unsigned int threads)
+{
+    volume_state__ state;
+    volume_labels *labels;
+    size_t run_capacity = 0, i;
+    region_label label;
+    int y, z;
+
+    if(source == NULL || width <= 0 || height <= 0 || depth <= 0)
+        return NULL;
+
+    labels = calloc(1, sizeof(*labels));
+    if(labels == NULL)
+        return NULL;
+
+    labels->width = width;
+    labels->height = height;
+    labels->depth = depth;
+
+    state.labels = labels;
+    state.uf.parent = NULL;
+    state.connectivity = connectivity;
+
+    labels->row_first = malloc(((size_t)height * depth + 1)
+                               * sizeof(*labels->row_first));
+    if(labels->row_first == NULL)
+        goto error;
+
+    /* Only the runs are kept, not the slices they come from */
+    for(z = 0; z < depth; z++) {
+        size_t first = labels->run_count, *row_first;
+
+        if(!slice_runs(source, z, &labels->runs, &labels->run_count,
+                       &run_capacity))
+        {
+            goto error;
+        }
+
+        row_first = labels->row_first + (size_t)z * height;
+        i = first;
+        for(y = 0; y < height; y++) {
+            row_first[y] = i;
+            while(i < labels->run_count && labels->runs[i].y == y)
+                i++;
+        }
+
+        if(i != labels->run_count)
+            goto error;
+    }
+
+    labels->row_first[(size_t)height * depth] = labels->run_count;
+
+    if(!union_find_init(&state.uf, (region_label)(labels->run_count + 1)))
+        goto error;
+
+    for(i = 0; i < labels->run_count; i++)
+        union_find_make_set(&state.uf);
+
+    parallel_run(volume_label_slice__, &state, depth, threads);
+
+    for(state.span = 1; state.span < depth; state.span *= 2) {
+        parallel_run(volume_merge_face__, &state,
+                     (depth - 1 - state.span) / (2 * state.span) + 1,
+                     threads);
+    }
+
+    labels->region_count = union_find_flatten(&state.uf);
+
+    /* The final label of run n is the parent of label n + 1 */
+    memmove(state.uf.parent, state.uf.parent + 1,
+            labels->run_count * sizeof(*state.uf.parent));
+    labels->labels = state.uf.parent;
+    state.uf.parent = NULL;
+
+    labels->sizes = calloc(labels->region_count + 1, sizeof(*labels->sizes));
+    if(labels->sizes == NULL)
+        goto error;
+
+    for(i = 0; i < labels->run_count; i++) {
+        label = labels->labels[i];
+        labels->sizes[label - 1] += labels->runs[i].x_end
+                                    - labels->runs[i].x_start;
+    }
+
+    union_find_free(&state.uf);
+    return labels;
+
+error:
+    union_find_free(&state.uf);
+    volume_labels_free(labels);
+
+    return NULL;
+}
+
+/**
+ * @internal
+ *
+ * Appends the runs of a slice of a volume, as a volume_slice_runs_func
+ */
+static int
+bitmap_volume_slice_runs__(const void *source,
+                           int z,
+                           bitmap_run **runs,
+                           size_t *count,
+                           size_t *capacity)
+{
+    bitmap slice;
+    int y;
+
+    bitmap_volume_slice(source, z, &slice);
+
+    for(y = 0; y < slice.height; y++) {
+        if(!bitmap_row_runs(&slice, y, runs, count, capacity))
+            return 0;
+    }
+
+    return 1;
+}
+
+volume_labels*
+bitmap_volume_label(const bitmap_volume *vol,
+                    volume_connectivity connectivity,
+                    unsigned int threads)
+{
+    if(vol == NULL || vol->data == NULL)
+        return NULL;
+
+    return volume_label_source(vol, vol->width, vol->height, vol->depth,
+                               bitmap_volume_slice_runs__, connectivity,
+                               threads);
+}
+
+/**
+ * @internal
+ *
+ * Slices read from a reader, one at a time, for volume_read_label()
+ */
+typedef struct {
+    bitmap_reader *reader;
+    int width;
+    int height;
+} volume_reader__;
+
+/**
+ * @internal
+ *
+ * Reads the next slice and appends its runs, as a volume_slice_runs_func
+ */
+static int
+volume_reader_slice_runs__(const void *source,
+                           int z,
+                           bitmap_run **runs,
+                           size_t *count,
+                           size_t *capacity)
+{
+    const volume_reader__ *volume_reader = source;
+    bitmap *slice;
+    int y, ok = 1;
+
+    (void)z;
+
+    slice = bitmap_reader_read_slice(volume_reader->reader,
+                                     volume_reader->width,
+                                     volume_reader->height);
+    if(slice == NULL)
+        return 0;
+
+    for(y = 0; y < slice->height && ok; y++)
+        ok = bitmap_row_runs(slice, y, runs, count, capacity);
+
+    bitmap_free(slice);
+    return ok;
+}
+
+int
+volume_read_label(bitmap_reader *reader,
+                  volume_connectivity connectivity,
+                  unsigned int threads,
+                  volume_labels **labels)
+{
+    volume_reader__ volume_reader;
+    int depth;
+
+    *labels = NULL;
+
+    if(!bitmap_reader_read_volume_header(reader, &volume_reader.width,
+                                         &volume_reader.height, &depth))
+    {
+        return 0;
+    }
+
+    volume_reader.reader = reader;
+
+    *labels = volume_label_source(&volume_reader, volume_reader.width,
+                                  volume_reader.height, depth,
+                                  volume_reader_slice_runs__, connectivity,
+                                  threads);
+
+    return (*labels != NULL) ? 1 : -1;
+}
+
+void
+volume_labels_free(volume_labels *labels)
+{
+    if(labels != NULL) {
+        free(labels->runs);
+        free(labels->row_first);
+        free(labels->labels);
+        free(labels->sizes);
+        free(labels);
+    }
+}
+
+region_label
+volume_labels_get(const volume_labels *labels,
+                  int x,
+                  int y,
+                  int z)
+{
+    size_t low, high, row;
+
+    if(labels == NULL
+       || x < 0 || x >= labels->width
+       || y < 0 || y >= labels->height
+       || z < 0 || z >= labels->depth)
+    {
+        return 0;
+    }
+
+    row = (size_t)z * labels->height + y;
+    low = labels->row_first[row];
+    high = labels->row_first[row + 1];
+
+    /* Binary search for the last run starting at or before x */
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if(labels->runs[mid].x_start <= x)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if(low > labels->row_first[row] && labels->runs[low - 1].x_end > x)
+        return labels->labels[low - 1];
+
+    return 0;
+}
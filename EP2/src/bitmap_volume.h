@@ -0,0 +1,269 @@
+/** @file bitmap_volume.h
+ *
+ * Volumes of voxels made of stacked bitmap slices, and labeling their
+ * connected regions
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITMAP_VOLUME_H
+#define BITMAP_VOLUME_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+#include "bitmap_reader.h"
+#include "union_find.h"
+
+/** Which neighbours of a voxel belong to the same region when set */
+typedef enum {
+    /** Only the 6 neighbours sharing a face */
+    VOLUME_CONNECTIVITY_6 = 6,
+    /** The 18 neighbours sharing a face or an edge */
+    VOLUME_CONNECTIVITY_18 = 18,
+    /** All 26 neighbours, sharing a face, an edge or a corner */
+    VOLUME_CONNECTIVITY_26 = 26
+} volume_connectivity;
+
+/**
+ * Type for a volume of bits: depth slices of height rows each, packed as in
+ * a bitmap one slice after the other.
+ */
+typedef struct {
+    /** Width of the volume */
+    int width;
+    /** Height of the volume */
+    int height;
+    /** Depth of the volume: its number of slices */
+    int depth;
+    /** Number of words in each row */
+    size_t stride;
+    /** Pointer to an array containing the stride * height * depth words */
+    bitmap_word *data;
+} bitmap_volume;
+
+/**
+ * Retrieves a pointer to the words of a row of a volume
+ *
+ * @param vol The volume to use
+ * @param y   0-based position of the row in the y-axis
+ * @param z   0-based position of the row's slice in the z-axis
+ *
+ * @returns Pointer to the first of the vol->stride words of the row
+ */
+#define bitmap_volume_row(vol, y, z) \
+    ((vol)->data + ((size_t)(z) * (vol)->height + (y)) * (vol)->stride)
+
+/**
+ * Function appending the runs of every row of a slice of some source of
+ * voxels to an array, sorted by row and then by position. The y of each run
+ * is its row in the slice. Slices are asked for in order, each exactly once.
+ */
+typedef int (*volume_slice_runs_func)(const void *source,
+                                      int z,
+                                      bitmap_run **runs,
+                                      size_t *count,
+                                      size_t *capacity);
+
+/**
+ * The connected regions of a volume, as the label of each of its runs
+ */
+typedef struct {
+    /** Width of the volume */
+    int width;
+    /** Height of the volume */
+    int height;
+    /** Depth of the volume */
+    int depth;
+    /** Number of regions. Labels go from 1 to it. */
+    region_label region_count;
+    /**
+     * Runs of every slice, one slice after the other and row by row. The y
+     * of each run is its row in its slice.
+     */
+    bitmap_run *runs;
+    /** Number of runs */
+    size_t run_count;
+    /**
+     * Position of the first run of each row, row y of slice z being entry
+     * z * height + y, followed by run_count
+     */
+    size_t *row_first;
+    /** Label of each run */
+    region_label *labels;
+    /** Number of voxels of each region, the one with label l at l - 1 */
+    size_t *sizes;
+} volume_labels;
+
+/**
+ * Creates a new volume with all bits cleared
+ *
+ * @param width  Width of the volume
+ * @param height Height of the volume
+ * @param depth  Depth of the volume
+ *
+ * @returns The new volume, or NULL on error
+ */
+bitmap_volume*
+bitmap_volume_new(int width,
+                  int height,
+                  int depth);
+
+/**
+ * Frees a volume and its associated data
+ *
+ * @param vol A volume to free
+ */
+void
+bitmap_volume_free(bitmap_volume *vol);
+
+/**
+ * Retrieves the value of a single voxel of a volume
+ *
+ * @param vol The volume to use
+ * @param x   0-base coordinate of the voxel in the x-axis
+ * @param y   0-base coordinate of the voxel in the y-axis
+ * @param z   0-base coordinate of the voxel in the z-axis
+ *
+ * @returns The value of the voxel, or 0 if the coordinates are out of range
+ */
+image_bit
+bitmap_volume_getbit(const bitmap_volume *vol,
+                     int x,
+                     int y,
+                     int z);
+
+/**
+ * Sets the value of a single voxel of a volume
+ *
+ * @param vol   The volume to use
+ * @param x     0-base coordinate of the voxel in the x-axis
+ * @param y     0-base coordinate of the voxel in the y-axis
+ * @param z     0-base coordinate of the voxel in the z-axis
+ * @param value The new value to attribute to the voxel
+ */
+void
+bitmap_volume_setbit(bitmap_volume *vol,
+                     int x,
+                     int y,
+                     int z,
+                     image_bit value);
+
+/**
+ * Makes a bitmap that views a slice of a volume, sharing its memory. Don't
+ * free the bitmap's data.
+ *
+ * @param vol   The volume to use
+ * @param z     0-base coordinate of the slice in the z-axis
+ * @param slice Receives the view of the slice
+ */
+void
+bitmap_volume_slice(const bitmap_volume *vol,
+                    int z,
+                    bitmap *slice);
+
+/**
+ * Reads a whole volume of stacked slices. See
+ * bitmap_reader_read_volume_header() for the format.
+ *
+ * @param reader The reader to use
+ *
+ * @returns The read volume, or NULL at the end of the input and on errors
+ */
+bitmap_volume*
+bitmap_volume_read(bitmap_reader *reader);
+
+/**
+ * Labels the connected regions of any source of voxels that can produce
+ * runs one slice at a time.
+ *
+ * The runs of every slice are read first, in order, so the source may only
+ * hold one slice at a time. Then each slice's runs are joined with the
+ * overlapping runs of the rows next to them, in parallel, since every slice
+ * has labels of its own. Slices are then merged across their faces in
+ * rounds, the first one joining slices 0-1, 2-3..., the second one the pairs
+ * of slices 1-2, 5-6... and so on: faces merged in the same round never
+ * touch the same regions, so they are merged in parallel as well. Memory
+ * scales with the number of runs and not with the number of voxels.
+ *
+ * Regions are numbered in the order their first voxel is found, going
+ * through the slices in order and each of them in row-major order.
+ *
+ * @param source       The source of voxels, passed on to slice_runs
+ * @param width        Width of the source
+ * @param height       Height of the source
+ * @param depth        Depth of the source
+ * @param slice_runs   Function producing the runs of each slice
+ * @param connectivity Connectivity of the regions
+ * @param threads      Maximum number of threads to use
+ *
+ * @returns The labels, or NULL on error
+ */
+volume_labels*
+volume_label_source(const void *source,
+                    int width,
+                    int height,
+                    int depth,
+                    volume_slice_runs_func slice_runs,
+                    volume_connectivity connectivity,
+                    unsigned int threads);
+
+/**
+ * Labels the connected regions of a volume. See volume_label_source().
+ *
+ * @param vol          The volume to use
+ * @param connectivity Connectivity of the regions
+ * @param threads      Maximum number of threads to use
+ *
+ * @returns The labels, or NULL on error
+ */
+volume_labels*
+bitmap_volume_label(const bitmap_volume *vol,
+                    volume_connectivity connectivity,
+                    unsigned int threads);
+
+/**
+ * Reads the next volume of stacked slices and labels its connected regions,
+ * holding a single slice in memory at a time. See volume_label_source().
+ *
+ * @param reader       The reader to use
+ * @param connectivity Connectivity of the regions
+ * @param threads      Maximum number of threads to use
+ * @param labels       Receives the labels
+ *
+ * @returns 1 if a volume was read, 0 if the input ended or a volume with any
+ *          size of 0 was found, -1 on errors
+ */
+int
+volume_read_label(bitmap_reader *reader,
+                  volume_connectivity connectivity,
+                  unsigned int threads,
+                  volume_labels **labels);
+
+/**
+ * Frees the labels of a volume
+ *
+ * @param labels The labels to free
+ */
+void
+volume_labels_free(volume_labels *labels);
+
+/**
+ * Retrieves the label of a single voxel
+ *
+ * @param labels The labels to use
+ * @param x      0-base coordinate of the voxel in the x-axis
+ * @param y      0-base coordinate of the voxel in the y-axis
+ * @param z      0-base coordinate of the voxel in the z-axis
+ *
+ * @returns The label, or 0 if the voxel is not set or the coordinates are
+ *          out of range
+ */
+region_label
+volume_labels_get(const volume_labels *labels,
+                  int x,
+                  int y,
+                  int z);
+
+#endif /* BITMAP_VOLUME_H */
@@ -0,0 +1,57 @@
+/** @file bitops.c
+ *
+ * Bit scanning and counting over bitmap words, for compilers without
+ * builtins for them
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include "bitmap.h"
+#include "bitops.h"
+
+#if !defined(__GNUC__)
+
+int
+bit_ctz(bitmap_word w)
+{
+    int n = 0;
+
+    while((w & 1) == 0) {
+        w >>= 1;
+        n++;
+    }
+
+    return n;
+}
+
+int
+bit_clz(bitmap_word w)
+{
+    int n = 0;
+
+    while((w & ((bitmap_word)1 << (BITMAP_WORD_BITS - 1))) == 0) {
+        w <<= 1;
+        n++;
+    }
+
+    return n;
+}
+
+int
+bit_popcount(bitmap_word w)
+{
+    int n = 0;
+
+    for(; w != 0; w &= w - 1)
+        n++;
+
+    return n;
+}
+
+#else
+
+/* ISO C forbids empty translation units */
+typedef int bitops_unused__;
+
+#endif
@@ -0,0 +1,45 @@
+/** @file bitops.h
+ *
+ * Bit scanning and counting over bitmap words
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include "bitmap.h"
+
+#if defined(__GNUC__)
+
+/**
+ * Counts the trailing zero bits of a word
+ *
+ * @param w A word, which must not be zero
+ */
+#define bit_ctz(w)      __builtin_ctzll(w)
+
+/**
+ * Counts the leading zero bits of a word
+ *
+ * @param w A word, which must not be zero
+ */
+#define bit_clz(w)      __builtin_clzll(w)
+
+/**
+ * Counts the set bits of a word
+ *
+ * @param w A word
+ */
+#define bit_popcount(w) __builtin_popcountll(w)
+
+#else
+
+int bit_ctz(bitmap_word w);
+int bit_clz(bitmap_word w);
+int bit_popcount(bitmap_word w);
+
+#endif
+
+#endif /* BITOPS_H */
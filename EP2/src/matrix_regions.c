@@ -13,6 +13,20 @@
 
 #include "utils.h"
 #include "bitmap.h"
+#include "bitmap_reader.h"
+#include "bitmap_pbm.h"
+#include "bitmap_output.h"
+#include "bitmap_euler.h"
+#include "bitmap_contour.h"
+#include "bitmap_volume.h"
+#include "bitmap_mapped.h"
+#include "region_query.h"
+#include "regions_ctx.h"
+#include "bitmap_runs.h"
+#include "bitmap_stream.h"
+#include "bitmap_tiled.h"
+#include "region_features.h"
+#include "parallel.h"
 
 /**
  * If this is set a copy of all bitmaps read in the command line will be
@@ -20,75 +34,1199 @@
  */
 #define DEBUG_PRINT_READ_BITMAP 0
 
-/** Main program entry point */
-int main(void) {
+/** Region labeling modes selectable in the command line */
+typedef enum {
+    /** Point by point, with bitmap_find_all_regions_parallel() */
+    MODE_POINTS,
+    /** Run by run, with bitmap_find_all_run_regions() */
+    MODE_RUNS,
+    /** Row by row as the input is read, with bitmap_stream_regions() */
+    MODE_STREAM,
+    /** Features only, with bitmap_find_all_features() */
+    MODE_FEATURES,
+    /** Tile by tile on a tiled copy, with bitmap_tiled_label() */
+    MODE_TILED,
+    /** Contours only, with label_image_contours() */
+    MODE_CONTOURS,
+    /** Volumes of stacked slices, with volume_read_label() */
+    MODE_VOLUME,
+    /** Binary PBM files labeled out of core, with pbm_label_mapped() */
+    MODE_MAPPED
+} labeling_mode;
+
+/** Options selected in the command line */
+typedef struct {
+    /** How regions are labeled */
+    labeling_mode mode;
+    /** Connectivity of the regions */
+    bitmap_connectivity connectivity;
+    /** Connectivity of the regions of volumes */
+    volume_connectivity volume_connectivity;
+    /** Maximum number of threads to label each matrix with */
+    unsigned int threads;
     /**
-     *Keep consuming input indefinitely: only stop when a matrix of width or
-     * height 0 is found
+     * Number of threads labeling different matrices at once, or 0 to label
+     * them one after the other
      */
-    for(;;) {
-        bitmap* map;
-        bitmap_region_list *regions;
+    unsigned int batch_threads;
+    /** If not NULL, prefix of the region mask files to write */
+    const char *mask_prefix;
+    /** If not NULL, prefix of the label map files to write */
+    const char *label_prefix;
+    /** Format of the label map files */
+    bitmap_output_format label_format;
+    /** Whether only the regions that query keeps are listed */
+    int filtered;
+    /** Which regions are listed, if filtered */
+    region_query query;
+} program_options;
 
-        map = bitmap_read(stdin);
-        if(map == NULL)
-            break;
+/**
+ * Prints the regions of a bitmap and their sizes
+ *
+ * @param out     The output to print to
+ * @param width   Width of the bitmap the regions were found in
+ * @param height  Height of the bitmap the regions were found in
+ * @param regions The list of regions, or NULL if none could be found
+ */
+static void
+print_regions(bitmap_output *out,
+              int width,
+              int height,
+              const bitmap_region_list *regions)
+{
+    char line[64];
+    size_t i;
 
-        #if DEBUG_PRINT_READ_BITMAP
-        {
-            int x, y;
+    if(regions == NULL || regions->region_count == 0) {
+        bitmap_output_puts(out, "Nenhuma regio encontrada.\n");
+        return;
+    }
 
-            for(y = 0; y < map->height; y++) {
-                for(x = 0; x < map->width; x++) {
-                    printf("%u ", (unsigned int)bitmap_getbit(map, x, y));
-                }
-                printf("\n");
-            }
+    if(regions->region_count < 26
+       && bitmap_output_regions(out, BITMAP_OUTPUT_TEXT, width, height,
+                                regions))
+    {
+        bitmap_output_puts(out, "\n");
+    }
+
+    sprintf(line, "%lu regies encontradas:\n",
+            (unsigned long)regions->region_count);
+    bitmap_output_puts(out, line);
+
+    for(i = 0; i < regions->region_count; i++) {
+        sprintf(line, "  %lu: %lu pontos\n", (unsigned long)(i + 1),
+                (unsigned long)regions->regions[i].area);
+        bitmap_output_puts(out, line);
+    }
+}
+
+/**
+ * Prints the features of regions, and the number of holes in all of them
+ *
+ * @param out          The output to print to
+ * @param features     Array with the features of each region
+ * @param region_count Number of regions
+ * @param euler        Euler number of the whole matrix
+ */
+static void
+print_features(bitmap_output *out,
+               const region_features *features,
+               size_t region_count,
+               long euler)
+{
+    char line[320];
+    size_t i;
+
+    if(region_count == 0) {
+        bitmap_output_puts(out, "Nenhuma regio encontrada.\n");
+        return;
+    }
+
+    sprintf(line, "%lu regies encontradas:\n", (unsigned long)region_count);
+    bitmap_output_puts(out, line);
+
+    for(i = 0; i < region_count; i++) {
+        const region_features *f = &features[i];
+        double x, y, mu20, mu02, mu11;
+
+        region_features_centroid(f, &x, &y);
+        region_features_moments(f, &mu20, &mu02, &mu11);
+
+        sprintf(line, "  %lu: %lu pontos, permetro %lu, colunas %d-%d, "
+                      "linhas %d-%d, centro (%.2f, %.2f), "
+                      "momentos (%.2f, %.2f, %.2f), %lu buracos\n",
+                (unsigned long)(i + 1), (unsigned long)f->area,
+                (unsigned long)f->perimeter, f->x_min, f->x_max,
+                f->y_min, f->y_max, x, y, mu20, mu02, mu11,
+                (unsigned long)region_features_holes(f));
+        bitmap_output_puts(out, line);
+    }
+
+    sprintf(line, "Nmero de Euler %ld, %lu buracos no total\n", euler,
+            (unsigned long)((long)region_count - euler));
+    bitmap_output_puts(out, line);
+}
+
+/**
+ * Computes and prints the features of the regions of a source of points
+ *
+ * @param source   The source of points
+ * @param width    Width of the source
+ * @param height   Height of the source
+ * @param row_runs Function producing the runs of each row of the source
+ * @param map      The source as a bitmap, if it is one, or NULL
+ * @param options  The options selected in the command line
+ * @param out      The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+report_features(const void *source,
+                int width,
+                int height,
+                bitmap_row_runs_func row_runs,
+                const bitmap *map,
+                const program_options *options,
+                bitmap_output *out)
+{
+    region_features *features;
+    size_t region_count, i;
+    long euler = 0;
+
+    if(!bitmap_find_all_source_features(source, width, height, row_runs,
+                                        options->connectivity, &features,
+                                        &region_count))
+    {
+        return 0;
+    }
+
+    /* Packed rows are counted directly, other sources add up the Euler
+       numbers of their regions */
+    if(map != NULL) {
+        euler = bitmap_euler_number(map, options->connectivity);
+    } else {
+        for(i = 0; i < region_count; i++)
+            euler += features[i].euler;
+    }
+
+    print_features(out, features, region_count, euler);
+    free(features);
+
+    return 1;
+}
+
+/**
+ * Writes the mask of each region to a binary PBM file, named after the
+ * positions of the matrix and of the region, both starting from 1
+ *
+ * @param prefix  Prefix of the file names
+ * @param matrix  Position of the matrix in the input
+ * @param width   Width of the bitmap the regions were found in
+ * @param height  Height of the bitmap the regions were found in
+ * @param regions The list of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+write_masks(const char *prefix,
+            unsigned long matrix,
+            int width,
+            int height,
+            const bitmap_region_list *regions)
+{
+    size_t i;
+    char *path;
+    int ok = 1;
+
+    if(regions == NULL)
+        return 1;
+
+    /* Room for two numbers of up to 20 digits, the separator and extension */
+    path = malloc(strlen(prefix) + 48);
+    if(path == NULL)
+        return 0;
+
+    for(i = 0; i < regions->region_count && ok; i++) {
+        FILE *file;
+
+        sprintf(path, "%s%lu-%lu.pbm", prefix, matrix, (unsigned long)(i + 1));
+
+        file = fopen(path, "wb");
+        if(file == NULL) {
+            ok = 0;
+        } else {
+            ok = pbm_write_region(file, width, height, &regions->regions[i]);
+            ok = (fclose(file) == 0) && ok;
         }
-        #endif
 
-        regions = bitmap_find_all_regions(map);
-        if(regions != NULL) {
-            unsigned int region_count, region_num;
-            bitmap_region_list *region_cur, *region_next;
+        if(!ok)
+            fprintf(stderr, "ERROR: Can't write '%s'.\n", path);
+    }
 
-            region_count = 0;
-            linked_list_foreach(regions, region_cur, region_next, next) {
-                region_count++;
-            }
+    free(path);
+    return ok;
+}
 
-            if(region_count < 26) {
-                char *str = bitmap_regions_print(map, regions);
-                if(str != NULL) {
-                    puts(str);
-                    free(str);
-                }
-            }
+/**
+ * Writes the labels of the regions of a matrix to a file, named after the
+ * position of the matrix, starting from 1
+ *
+ * @param prefix  Prefix of the file name
+ * @param format  Format of the file
+ * @param matrix  Position of the matrix in the input
+ * @param width   Width of the bitmap the regions were found in
+ * @param height  Height of the bitmap the regions were found in
+ * @param regions The list of regions
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+write_label_map(const char *prefix,
+                bitmap_output_format format,
+                unsigned long matrix,
+                int width,
+                int height,
+                const bitmap_region_list *regions)
+{
+    FILE *file;
+    char *path;
+    int ok = 0;
+
+    /* Room for a number of up to 20 digits and the extension */
+    path = malloc(strlen(prefix) + 32);
+    if(path == NULL)
+        return 0;
+
+    sprintf(path, "%s%lu.%s", prefix, matrix,
+            bitmap_output_extension(format));
+
+    file = fopen(path, "wb");
+    if(file != NULL) {
+        ok = bitmap_output_write(file, format, width, height, regions);
+        ok = (fclose(file) == 0) && ok;
+    }
+
+    /* Don't leave a partial file behind */
+    if(!ok) {
+        fprintf(stderr, "ERROR: Can't write '%s'.\n", path);
+        remove(path);
+    }
+
+    free(path);
+    return ok;
+}
+
+/**
+ * Prints the chain codes of a contour
+ *
+ * @param out     The output to print to
+ * @param list    The list the contour belongs to
+ * @param contour The contour
+ */
+static void
+print_chain_codes(bitmap_output *out,
+                  const region_contour_list *list,
+                  const region_contour *contour)
+{
+    char chunk[257];
+    size_t i, len = 0;
+
+    for(i = 0; i < contour->length; i++) {
+        chunk[len++] = (char)('0' + list->codes[contour->offset + i]);
+
+        if(len == sizeof(chunk) - 1 || i + 1 == contour->length) {
+            chunk[len] = '\0';
+            bitmap_output_puts(out, chunk);
+            len = 0;
+        }
+    }
+}
+
+/**
+ * Traces and prints the outer and inner contours of the regions of a label
+ * image, as Freeman chain codes
+ *
+ * @param image   The label image, or NULL if it could not be built. It is
+ *                freed.
+ * @param options The options selected in the command line
+ * @param out     The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+report_contours(label_image *image,
+                const program_options *options,
+                bitmap_output *out)
+{
+    region_contour_list *list = NULL;
+    char line[160];
+    size_t i;
+    unsigned long region = 0;
+
+    if(image != NULL)
+        list = label_image_contours(image, options->connectivity);
+
+    if(list == NULL) {
+        fprintf(stderr, "ERROR: Can't trace the contours.\n");
+        label_image_free(image);
+        return 0;
+    }
 
-            printf("%u regies encontradas:\n", region_count);
+    if(image->region_count == 0) {
+        bitmap_output_puts(out, "Nenhuma regio encontrada.\n");
+    } else {
+        sprintf(line, "%lu regies encontradas:\n",
+                (unsigned long)image->region_count);
+        bitmap_output_puts(out, line);
+    }
+
+    for(i = 0; i < list->count; i++) {
+        const region_contour *contour = &list->contours[i];
+
+        if(!contour->hole) {
+            sprintf(line, "  %lu: contorno em (%d, %d), %lu passos", ++region,
+                    contour->x, contour->y, (unsigned long)contour->length);
+        } else {
+            sprintf(line, "     buraco em (%d, %d), %lu passos", contour->x,
+                    contour->y, (unsigned long)contour->length);
+        }
 
-            region_num = 1;
-            linked_list_foreach(regions, region_cur, region_next, next) {
-                unsigned int point_count;
-                bitmap_region *point_cur, *point_next;
+        bitmap_output_puts(out, line);
+        if(contour->length != 0) {
+            bitmap_output_puts(out, ": ");
+            print_chain_codes(out, list, contour);
+        }
+        bitmap_output_puts(out, "\n");
+    }
 
-                point_count = 0;
-                linked_list_foreach(region_cur->region, point_cur, point_next, next) {
-                    point_count++;
-                }
+    region_contour_list_free(list);
+    label_image_free(image);
 
-                printf("  %u: %u pontos\n", region_num, point_count);
-                region_num++;
+    return 1;
+}
+
+/**
+ * Finds the regions of a bitmap by labeling a tiled copy of it
+ *
+ * @param map     The bitmap to use
+ * @param options The options selected in the command line
+ *
+ * @returns The list of regions, or NULL on error
+ */
+static bitmap_region_list*
+find_tiled_regions(const bitmap *map,
+                   const program_options *options)
+{
+    bitmap_tiled *tiled;
+    label_image *image = NULL;
+    bitmap_region_list *regions = NULL;
+
+    tiled = bitmap_tiled_from_bitmap(map);
+    if(tiled != NULL) {
+        image = bitmap_tiled_label(tiled, options->connectivity,
+                                   options->threads);
+        bitmap_tiled_free(tiled);
+    }
+
+    if(image != NULL) {
+        regions = label_image_regions(image);
+        label_image_free(image);
+    }
+
+    return regions;
+}
+
+/**
+ * Finds the regions of a bitmap
+ *
+ * @param map     The bitmap to use. It may be modified.
+ * @param options The options selected in the command line
+ *
+ * @returns The list of regions, or NULL on error
+ */
+static bitmap_region_list*
+find_regions(bitmap *map,
+             const program_options *options)
+{
+    #if DEBUG_PRINT_READ_BITMAP
+    {
+        int x, y;
+
+        for(y = 0; y < map->height; y++) {
+            for(x = 0; x < map->width; x++) {
+                printf("%u ", (unsigned int)bitmap_getbit(map, x, y));
             }
-            
+            printf("\n");
+        }
+    }
+    #endif
+
+    /* Regions left out by the query are never built */
+    if(options->filtered && options->mode != MODE_FEATURES
+       && options->mode != MODE_CONTOURS)
+    {
+        return bitmap_query_run_regions(map, options->connectivity,
+                                        &options->query);
+    }
+
+    switch(options->mode) {
+    case MODE_POINTS:
+        return bitmap_find_all_regions_parallel(map, options->connectivity,
+                                                options->threads);
+    case MODE_RUNS:
+    case MODE_STREAM:
+    case MODE_FEATURES:
+    case MODE_CONTOURS:
+    case MODE_VOLUME:
+    case MODE_MAPPED:
+        /* Only standard input can be streamed: already read bitmaps are
+           labeled by runs instead */
+        return bitmap_find_all_run_regions(map, options->connectivity);
+    case MODE_TILED:
+        return find_tiled_regions(map, options);
+    }
+
+    return NULL;
+}
+
+/**
+ * Prints the regions found in a matrix and writes their masks and label map,
+ * if asked to, leaving the list of regions untouched
+ *
+ * @param width   Width of the matrix
+ * @param height  Height of the matrix
+ * @param regions The list of regions, or NULL if none could be found
+ * @param options The options selected in the command line
+ * @param matrix  Position of the matrix in the input, starting from 1
+ * @param out     The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+report_region_list(int width,
+                   int height,
+                   const bitmap_region_list *regions,
+                   const program_options *options,
+                   unsigned long matrix,
+                   bitmap_output *out)
+{
+    int ok = (regions != NULL);
+
+    print_regions(out, width, height, regions);
+
+    if(ok && options->mask_prefix != NULL) {
+        ok = write_masks(options->mask_prefix, matrix, width, height,
+                         regions);
+    }
+
+    if(ok && options->label_prefix != NULL) {
+        ok = write_label_map(options->label_prefix, options->label_format,
+                             matrix, width, height, regions);
+    }
+
+    return ok;
+}
+
+/**
+ * Prints the regions found in a matrix and writes their masks and label map,
+ * if asked to
+ *
+ * @param width   Width of the matrix
+ * @param height  Height of the matrix
+ * @param regions The list of regions, or NULL if none could be found. It is
+ *                freed.
+ * @param options The options selected in the command line
+ * @param matrix  Position of the matrix in the input, starting from 1
+ * @param out     The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+report_regions(int width,
+               int height,
+               bitmap_region_list *regions,
+               const program_options *options,
+               unsigned long matrix,
+               bitmap_output *out)
+{
+    int ok = report_region_list(width, height, regions, options, matrix, out);
+
+    bitmap_region_list_free(regions);
+
+    return ok;
+}
+
+/**
+ * Finds and prints the regions, or their features, of a bitmap
+ *
+ * @param map     The bitmap to use. It may be modified.
+ * @param options The options selected in the command line
+ * @param matrix  Position of the matrix in the input, starting from 1
+ * @param out     The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+process_bitmap(bitmap *map,
+               const program_options *options,
+               unsigned long matrix,
+               bitmap_output *out)
+{
+    if(options->mode == MODE_FEATURES) {
+        return report_features(map, map->width, map->height,
+                               bitmap_source_row_runs, map, options, out);
+    }
+
+    if(options->mode == MODE_CONTOURS) {
+        return report_contours(bitmap_label(map, options->connectivity,
+                                            options->threads),
+                               options, out);
+    }
+
+    return report_regions(map->width, map->height,
+                          find_regions(map, options), options, matrix, out);
+}
+
+/**
+ * Labels a binary PBM image out of core, writing its labels to a raw label
+ * file named after the label map prefix, and prints the number of regions
+ *
+ * @param image   The image to use
+ * @param options The options selected in the command line
+ * @param matrix  Position of the file in the command line, starting from 1
+ * @param out     The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+label_mapped(const pbm_image *image,
+             const program_options *options,
+             unsigned long matrix,
+             bitmap_output *out)
+{
+    region_label region_count;
+    char *path, line[64];
+    int ok;
+
+    /* Room for a number of up to 20 digits and the extension */
+    path = malloc(strlen(options->label_prefix) + 32);
+    if(path == NULL)
+        return 0;
+
+    sprintf(path, "%s%lu.%s", options->label_prefix, matrix,
+            bitmap_output_extension(BITMAP_OUTPUT_BINARY));
+
+    ok = pbm_label_mapped(image, options->connectivity, PBM_MAPPED_TILE_SIZE,
+                          path, &region_count);
+    if(ok) {
+        if(region_count == 0) {
+            bitmap_output_puts(out, "Nenhuma regio encontrada.\n");
+        } else {
+            sprintf(line, "%lu regies encontradas.\n",
+                    (unsigned long)region_count);
+            bitmap_output_puts(out, line);
+        }
+    }
+
+    free(path);
+    return ok;
+}
+
+/**
+ * Finds and prints the regions of a PBM file. Binary (P4) files are labeled
+ * straight from memory, plain (P1) ones are read first.
+ *
+ * @param path    Path to the file
+ * @param options The options selected in the command line
+ * @param matrix  Position of the file in the command line, starting from 1
+ * @param out     The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+process_pbm_file(const char *path,
+                 const program_options *options,
+                 unsigned long matrix,
+                 bitmap_output *out)
+{
+    char magic[2];
+    FILE *file;
+    int ok;
+
+    file = fopen(path, "rb");
+    if(file == NULL) {
+        fprintf(stderr, "ERROR: Can't open '%s'.\n", path);
+        return 0;
+    }
+
+    if(fread(magic, 1, 2, file) != 2 || magic[0] != 'P'
+       || (magic[1] != '1' && magic[1] != '4'))
+    {
+        fprintf(stderr, "ERROR: '%s' is not a PBM image.\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    if(magic[1] == '4') {
+        pbm_image *image;
+
+        fclose(file);
+
+        image = pbm_map(path);
+        if(image == NULL)
+            return 0;
+
+        if(options->mode == MODE_MAPPED) {
+            ok = label_mapped(image, options, matrix, out);
+        } else if(options->mode == MODE_FEATURES) {
+            ok = report_features(image, image->width, image->height,
+                                 pbm_row_runs, NULL, options, out);
+        } else if(options->mode == MODE_CONTOURS) {
+            bitmap_region_list *regions;
+
+            regions = pbm_find_all_regions(image, options->connectivity);
+            ok = report_contours(label_image_from_regions(regions,
+                                                          image->width,
+                                                          image->height),
+                                 options, out);
             bitmap_region_list_free(regions);
+        } else if(options->filtered) {
+            ok = report_regions(image->width, image->height,
+                                bitmap_query_source_run_regions(
+                                    image, image->width, image->height,
+                                    pbm_row_runs, options->connectivity,
+                                    &options->query),
+                                options, matrix, out);
         } else {
+            ok = report_regions(image->width, image->height,
+                                pbm_find_all_regions(image,
+                                                     options->connectivity),
+                                options, matrix, out);
+        }
+
+        pbm_unmap(image);
+    } else if(options->mode == MODE_MAPPED) {
+        fprintf(stderr, "ERROR: '%s' is not a binary PBM (P4) image.\n",
+                path);
+        fclose(file);
+        ok = 0;
+    } else {
+        bitmap_reader *reader;
+        bitmap *map = NULL;
+
+        rewind(file);
+
+        reader = bitmap_reader_new(file);
+        if(reader != NULL)
+            map = bitmap_reader_read_p1(reader);
+
+        bitmap_reader_free(reader);
+        fclose(file);
+
+        if(map == NULL)
+            return 0;
+
+        ok = process_bitmap(map, options, matrix, out);
+        bitmap_free(map);
+    }
+
+    return ok;
+}
+
+/**
+ * Prints a region as soon as bitmap_stream_regions() finds it
+ *
+ * @param features The region's features
+ * @param arg      Pointer to the number of regions printed so far
+ */
+static void
+print_stream_region(const region_features *features,
+                    void *arg)
+{
+    unsigned long *printed = arg;
+
+    printf("  %lu: %lu pontos, linhas %d-%d, colunas %d-%d\n", ++*printed,
+           (unsigned long)features->area, features->y_min, features->y_max,
+           features->x_min, features->x_max);
+}
+
+/**
+ * Reads bitmaps and prints their regions in streaming mode, until the input
+ * ends or an error happens
+ *
+ * @param options The options selected in the command line
+ */
+static void
+stream_regions(const program_options *options)
+{
+    for(;;) {
+        unsigned long printed = 0;
+        size_t region_count;
+
+        if(bitmap_stream_regions(stdin, options->connectivity,
+                                 print_stream_region, &printed,
+                                 &region_count) <= 0)
+        {
+            break;
+        }
+
+        if(region_count == 0)
             printf("Nenhuma regio encontrada.\n");
+        else
+            printf("%lu regies encontradas.\n", (unsigned long)region_count);
+    }
+}
+
+/**
+ * Reads volumes of stacked slices and prints their regions, until the input
+ * ends or an error happens
+ *
+ * @param reader  Reader of the volumes
+ * @param options The options selected in the command line
+ * @param out     The output to print to
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+volume_regions(bitmap_reader *reader,
+               const program_options *options,
+               bitmap_output *out)
+{
+    volume_labels *labels;
+    char line[80];
+    int status;
+    size_t i;
+
+    while((status = volume_read_label(reader, options->volume_connectivity,
+                                      options->threads, &labels)) > 0)
+    {
+        if(labels->region_count == 0) {
+            bitmap_output_puts(out, "Nenhuma regio encontrada.\n");
+        } else {
+            sprintf(line, "%lu regies encontradas:\n",
+                    (unsigned long)labels->region_count);
+            bitmap_output_puts(out, line);
         }
-        
+
+        for(i = 0; i < labels->region_count; i++) {
+            sprintf(line, "  %lu: %lu pontos\n", (unsigned long)(i + 1),
+                    (unsigned long)labels->sizes[i]);
+            bitmap_output_puts(out, line);
+        }
+
+        volume_labels_free(labels);
+        bitmap_output_flush(out);
+    }
+
+    return status == 0;
+}
+
+/** A matrix going through the batch pipeline */
+typedef struct {
+    /** The matrix */
+    bitmap *map;
+    /** Position of the matrix in the input, starting from 1 */
+    unsigned long matrix;
+    /** Output of the matrix, kept in memory until its turn to be printed */
+    bitmap_output *out;
+    /** Whether the matrix was processed successfully */
+    int ok;
+} batch_job;
+
+/** State of the batch pipeline */
+typedef struct {
+    /** Reader of the matrices */
+    bitmap_reader *reader;
+    /** The options selected in the command line */
+    const program_options *options;
+    /** Number of matrices read so far */
+    unsigned long matrix;
+    /** Set when reading fails. Only the reading thread writes it. */
+    int read_failed;
+    /** Exit status of the program. Only the consuming thread writes it. */
+    int status;
+} batch_state;
+
+/**
+ * Reads the next matrix of the batch, in the pipeline's reading thread
+ *
+ * @param arg Pointer to the batch_state
+ *
+ * @returns The new batch_job, or NULL at the end of the input
+ */
+static void*
+batch_read(void *arg)
+{
+    batch_state *state = arg;
+    batch_job *job;
+    bitmap *map;
+
+    map = bitmap_reader_read(state->reader);
+    if(map == NULL)
+        return NULL;
+
+    job = malloc(sizeof(*job));
+    if(job == NULL) {
+        fprintf(stderr, "ERROR: Out of memory.\n");
         bitmap_free(map);
+        state->read_failed = 1;
+        return NULL;
+    }
+
+    job->map = map;
+    job->matrix = ++state->matrix;
+    job->out = NULL;
+    job->ok = 0;
+
+    return job;
+}
+
+/**
+ * Finds the regions of a matrix of the batch, printing them to memory
+ *
+ * @param arg  Pointer to the batch_state
+ * @param item Pointer to the batch_job
+ */
+static void
+batch_process(void *arg,
+              void *item)
+{
+    batch_state *state = arg;
+    batch_job *job = item;
+
+    job->out = bitmap_output_new(NULL);
+    if(job->out != NULL) {
+        job->ok = process_bitmap(job->map, state->options, job->matrix,
+                                 job->out) && job->out->ok;
     }
 
-    return 0;
+    bitmap_free(job->map);
+    job->map = NULL;
+}
+
+/**
+ * Prints the regions of a matrix of the batch, in input order
+ *
+ * @param arg  Pointer to the batch_state
+ * @param item Pointer to the batch_job
+ */
+static void
+batch_write(void *arg,
+            void *item)
+{
+    batch_state *state = arg;
+    batch_job *job = item;
+
+    if(job->out != NULL)
+        fwrite(job->out->buffer, 1, job->out->len, stdout);
+
+    if(!job->ok)
+        state->status = 1;
+
+    bitmap_output_free(job->out);
+    free(job);
 }
 
+/**
+ * Reads matrices and prints their regions, labeling multiple matrices at once
+ * while the next ones are read. The output is the same as labeling them one
+ * after the other.
+ *
+ * @param reader  Reader of the matrices
+ * @param options The options selected in the command line
+ *
+ * @returns 1 on success, 0 on errors
+ */
+static int
+batch_regions(bitmap_reader *reader,
+              const program_options *options)
+{
+    batch_state state;
+
+    state.reader = reader;
+    state.options = options;
+    state.matrix = 0;
+    state.read_failed = 0;
+    state.status = 0;
+
+    /* A few matrices per thread keep all of them busy when matrices take
+       uneven times, without holding many in memory */
+    parallel_pipeline(batch_read, batch_process, batch_write, &state,
+                      options->batch_threads, 4 * options->batch_threads);
+
+    return state.status == 0 && !state.read_failed;
+}
+
+/**
+ * Prints the command line usage
+ *
+ * @param program_name Name the program was invoked with
+ */
+static void
+print_usage(const char *program_name)
+{
+    fprintf(stderr,
+            "Usage: %s [--runs | --stream | --features | --tiled | --contours\n"
+            "          | --volume | --mapped] [--connectivity 4|8|6|18|26]\n"
+            "          [--threads N] [--batch N] [--min-area N] [--top K]\n"
+            "          [--max-count N] [--masks PREFIX] [--label-map PREFIX]\n"
+            "          [--label-format text|pgm|pam|bin] [FILE.pbm...]\n"
+            "\n"
+            "Reads matrices from the standard input, or PBM images (P1 or P4)\n"
+            "from the files given.\n"
+            "\n",
+            program_name);
+    fprintf(stderr,
+            "  --runs         label regions by runs of points instead of by\n"
+            "                 single points (faster for long horizontal runs)\n"
+            "  --stream       label regions while reading each matrix, row by\n"
+            "                 row, printing each one as soon as it ends; uses\n"
+            "                 memory proportional to the width only\n"
+            "  --features     print the area, perimeter, bounding box, centroid,\n"
+            "                 second-order moments and number of holes of each\n"
+            "                 region, and the Euler number of the matrix\n");
+    fprintf(stderr,
+            "  --tiled        label regions on a copy of the matrix stored in\n"
+            "                 64x64 tiles, one tile at a time (faster for large\n"
+            "                 matrices, uses --threads)\n"
+            "  --contours     print the outer contour and the contours of the\n"
+            "                 holes of each region, as their first point and\n"
+            "                 Freeman chain codes (0 right, 2 up, 4 left, 6 down)\n");
+    fprintf(stderr,
+            "  --volume       read volumes from the standard input: a line with\n"
+            "                 the depth, height and width, followed by the\n"
+            "                 points of each slice in turn; slices are labeled\n"
+            "                 with up to --threads threads and merged\n");
+    fprintf(stderr,
+            "  --mapped       label binary PBM (P4) files too large for memory\n"
+            "                 out of core, tile by tile, straight from and into\n"
+            "                 mapped files; only prints the number of regions\n"
+            "                 and writes the labels as raw labels (bin) to the\n"
+            "                 --label-map files, which it requires\n");
+    fprintf(stderr,
+            "  --connectivity 4|8|6|18|26\n"
+            "                 whether diagonal neighbours belong to the same\n"
+            "                 region (8) or not (4, the default); for volumes,\n"
+            "                 6 (4), 18 or 26 (8) neighbours\n"
+            "  --threads N    label each matrix with up to N threads; 0 uses\n"
+            "                 all processors (default: 1)\n"
+            "  --batch N      label up to N matrices at once with separate\n"
+            "                 threads, while the next ones are read; 0 uses all\n"
+            "                 processors (not with --stream)\n");
+    fprintf(stderr,
+            "  --min-area N   only list the regions of at least N points\n"
+            "  --top K        only list the K largest regions, largest first\n"
+            "  --max-count N  list at most N regions, the first ones found (or\n"
+            "                 the largest ones, with --top); regions left out\n"
+            "                 by these are never built (not with --features,\n"
+            "                 --contours, --stream, --volume or --mapped)\n");
+    fprintf(stderr,
+            "  --masks PREFIX write the mask of each region as a binary PBM\n"
+            "                 file, named PREFIX<matrix>-<region>.pbm (not\n"
+            "                 with --features)\n");
+    fprintf(stderr,
+            "  --label-map PREFIX\n"
+            "                 write the labels of the regions of each matrix to\n"
+            "                 a file named PREFIX<matrix>.<format> (not with\n"
+            "                 --features)\n"
+            "  --label-format text|pgm|pam|bin\n"
+            "                 format of the label maps: text with a name per\n"
+            "                 region (a-z, aa, ab...), binary PGM or PAM image,\n"
+            "                 or raw labels (default: pgm)\n");
+}
+
+/** Main program entry point */
+int main(int argc, char **argv) {
+    program_options options;
+    unsigned long matrix = 0;
+    bitmap_reader *reader;
+    bitmap_output *out;
+    regions_ctx *ctx = NULL;
+    int i, status = 0;
+
+    options.mode = MODE_POINTS;
+    options.connectivity = BITMAP_CONNECTIVITY_4;
+    options.volume_connectivity = VOLUME_CONNECTIVITY_6;
+    options.threads = 1;
+    options.batch_threads = 0;
+    options.mask_prefix = NULL;
+    options.label_prefix = NULL;
+    options.label_format = BITMAP_OUTPUT_PGM;
+    options.filtered = 0;
+    options.query.min_area = 0;
+    options.query.top_k = 0;
+    options.query.max_count = 0;
+
+    for(i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if(strcmp(argv[i], "--runs") == 0) {
+            options.mode = MODE_RUNS;
+        } else if(strcmp(argv[i], "--stream") == 0) {
+            options.mode = MODE_STREAM;
+        } else if(strcmp(argv[i], "--features") == 0) {
+            options.mode = MODE_FEATURES;
+        } else if(strcmp(argv[i], "--tiled") == 0) {
+            options.mode = MODE_TILED;
+        } else if(strcmp(argv[i], "--contours") == 0) {
+            options.mode = MODE_CONTOURS;
+        } else if(strcmp(argv[i], "--volume") == 0) {
+            options.mode = MODE_VOLUME;
+        } else if(strcmp(argv[i], "--mapped") == 0) {
+            options.mode = MODE_MAPPED;
+        } else if(strcmp(argv[i], "--connectivity") == 0 && i + 1 < argc) {
+            /* Each bitmap connectivity stands for the volume one with the
+               same neighbours in a slice, and the other way around */
+            const char *connectivity = argv[++i];
+
+            if(strcmp(connectivity, "4") == 0
+               || strcmp(connectivity, "6") == 0)
+            {
+                options.connectivity = BITMAP_CONNECTIVITY_4;
+                options.volume_connectivity = VOLUME_CONNECTIVITY_6;
+            } else if(strcmp(connectivity, "8") == 0
+                      || strcmp(connectivity, "26") == 0)
+            {
+                options.connectivity = BITMAP_CONNECTIVITY_8;
+                options.volume_connectivity = VOLUME_CONNECTIVITY_26;
+            } else if(strcmp(connectivity, "18") == 0) {
+                options.connectivity = BITMAP_CONNECTIVITY_8;
+                options.volume_connectivity = VOLUME_CONNECTIVITY_18;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+            if(options.threads == 0)
+                options.threads = parallel_cpu_count();
+        } else if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            options.batch_threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+            if(options.batch_threads == 0)
+                options.batch_threads = parallel_cpu_count();
+        } else if(strcmp(argv[i], "--min-area") == 0 && i + 1 < argc) {
+            options.query.min_area = strtoul(argv[++i], NULL, 10);
+            options.filtered = 1;
+        } else if(strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            options.query.top_k = strtoul(argv[++i], NULL, 10);
+            options.filtered = 1;
+        } else if(strcmp(argv[i], "--max-count") == 0 && i + 1 < argc) {
+            options.query.max_count = strtoul(argv[++i], NULL, 10);
+            options.filtered = 1;
+        } else if(strcmp(argv[i], "--masks") == 0 && i + 1 < argc) {
+            options.mask_prefix = argv[++i];
+        } else if(strcmp(argv[i], "--label-map") == 0 && i + 1 < argc) {
+            options.label_prefix = argv[++i];
+        } else if(strcmp(argv[i], "--label-format") == 0 && i + 1 < argc) {
+            const char *format = argv[++i];
+
+            if(strcmp(format, "text") == 0) {
+                options.label_format = BITMAP_OUTPUT_TEXT;
+            } else if(strcmp(format, "pgm") == 0) {
+                options.label_format = BITMAP_OUTPUT_PGM;
+            } else if(strcmp(format, "pam") == 0) {
+                options.label_format = BITMAP_OUTPUT_PAM;
+            } else if(strcmp(format, "bin") == 0) {
+                options.label_format = BITMAP_OUTPUT_BINARY;
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* Out-of-core labeling only writes label files, of binary PBM files */
+    if(options.mode == MODE_MAPPED
+       && (options.label_prefix == NULL || i == argc))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if(options.mode == MODE_STREAM) {
+        stream_regions(&options);
+        return 0;
+    }
+
+    out = bitmap_output_new(stdout);
+    if(out == NULL)
+        return 1;
+
+    /* The remaining arguments are PBM files */
+    if(i < argc) {
+        for(; i < argc; i++) {
+            if(!process_pbm_file(argv[i], &options, ++matrix, out))
+                status = 1;
+
+            bitmap_output_flush(out);
+        }
+
+        return !bitmap_output_free(out) || status;
+    }
+
+    reader = bitmap_reader_new(stdin);
+    if(reader == NULL) {
+        bitmap_output_free(out);
+        return 1;
+    }
+
+    if(options.mode == MODE_VOLUME) {
+        status = !volume_regions(reader, &options, out);
+        bitmap_reader_free(reader);
+
+        return !bitmap_output_free(out) || status;
+    }
+
+    if(options.batch_threads > 0) {
+        bitmap_output_free(out);
+        status = !batch_regions(reader, &options);
+        bitmap_reader_free(reader);
+
+        return status;
+    }
+
+    /* Labeling by runs reuses the same memory for every matrix */
+    if(options.mode == MODE_RUNS && !options.filtered) {
+        ctx = regions_ctx_new();
+        if(ctx == NULL) {
+            bitmap_reader_free(reader);
+            bitmap_output_free(out);
+            return 1;
+        }
+    }
+
+    /**
+     *Keep consuming input indefinitely: only stop when a matrix of width or
+     * height 0 is found
+     */
+    for(;;) {
+        bitmap* map;
+        int ok;
+
+        map = bitmap_reader_read(reader);
+        if(map == NULL)
+            break;
+
+        if(ctx != NULL) {
+            ok = report_region_list(map->width, map->height,
+                                    regions_ctx_find(ctx, map,
+                                                     options.connectivity),
+                                    &options, ++matrix, out);
+        } else {
+            ok = process_bitmap(map, &options, ++matrix, out);
+        }
+
+        if(!ok)
+            status = 1;
+
+        bitmap_output_flush(out);
+        bitmap_free(map);
+    }
+
+    regions_ctx_free(ctx);
+    bitmap_reader_free(reader);
+
+    return !bitmap_output_free(out) || status;
+}
@@ -0,0 +1,411 @@
+/** @file parallel.c
+ *
+ * Minimal helpers for running independent tasks on multiple threads
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifdef HAVE_PTHREADS
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+
+#include "parallel.h"
+
+#ifdef HAVE_PTHREADS
+
+/** State shared by the threads running a batch of tasks */
+typedef struct {
+    parallel_task task;
+    void *arg;
+    size_t count;
+    /** Index of the next task to be picked */
+    size_t next;
+    pthread_mutex_t lock;
+} parallel_batch;
+
+/**
+ * @internal
+ *
+ * Thread body: keeps running pending tasks until none are left
+ *
+ * @param arg Pointer to the parallel_batch
+ */
+static void*
+parallel_worker__(void *arg)
+{
+    parallel_batch *batch = arg;
+
+    for(;;) {
+        size_t index;
+
+        pthread_mutex_lock(&batch->lock);
+        index = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+
+        if(index >= batch->count)
+            break;
+
+        batch->task(batch->arg, index);
+    }
+
+    return NULL;
+}
+
+int
+parallel_run(parallel_task task,
+             void *arg,
+             size_t count,
+             unsigned int threads)
+{
+    parallel_batch batch;
+    pthread_t *workers;
+    unsigned int i, started = 0;
+
+    if(threads > count)
+        threads = count;
+
+    if(threads <= 1) {
+        for(i = 0; i < count; i++)
+            task(arg, i);
+
+        return 1;
+    }
+
+    batch.task = task;
+    batch.arg = arg;
+    batch.count = count;
+    batch.next = 0;
+    pthread_mutex_init(&batch.lock, NULL);
+
+    /* The calling thread works too, so one less thread is started */
+    workers = malloc((threads - 1) * sizeof(*workers));
+    if(workers != NULL) {
+        for(started = 0; started < threads - 1; started++) {
+            if(pthread_create(&workers[started], NULL, parallel_worker__,
+                              &batch) != 0)
+            {
+                break;
+            }
+        }
+    }
+
+    parallel_worker__(&batch);
+
+    for(i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    free(workers);
+    pthread_mutex_destroy(&batch.lock);
+
+    return workers != NULL && started == threads - 1;
+}
+
+/** State shared by the threads running a pipeline */
+typedef struct {
+    parallel_source source;
+    parallel_stage process;
+    parallel_stage consume;
+    void *arg;
+    /** Ring of depth items, item n being in slot n % depth */
+    void **items;
+    /** Whether the item in each slot has been processed */
+    unsigned char *processed;
+    size_t depth;
+    /** Number of items produced */
+    size_t produced;
+    /** Number of the next item to be processed */
+    size_t next;
+    /** Number of items consumed */
+    size_t consumed;
+    /** Whether the source has run out of items */
+    int finished;
+    pthread_mutex_t lock;
+    /** Signaled when a slot is freed for the source */
+    pthread_cond_t can_produce;
+    /** Signaled when an item is produced, or the source runs out */
+    pthread_cond_t can_process;
+    /** Signaled when an item is processed, or the source runs out */
+    pthread_cond_t can_consume;
+} parallel_pipeline_state;
+
+/**
+ * @internal
+ *
+ * Source thread body: produces items until the source runs out
+ *
+ * @param arg Pointer to the parallel_pipeline_state
+ */
+static void*
+parallel_source__(void *arg)
+{
+    parallel_pipeline_state *state = arg;
+
+    for(;;) {
+        void *item;
+
+        pthread_mutex_lock(&state->lock);
+        while(state->produced - state->consumed == state->depth)
+            pthread_cond_wait(&state->can_produce, &state->lock);
+        pthread_mutex_unlock(&state->lock);
+
+        item = state->source(state->arg);
+
+        pthread_mutex_lock(&state->lock);
+
+        if(item == NULL) {
+            state->finished = 1;
+        } else {
+            state->items[state->produced % state->depth] = item;
+            state->processed[state->produced % state->depth] = 0;
+            state->produced++;
+        }
+
+        pthread_cond_broadcast(&state->can_process);
+        pthread_cond_signal(&state->can_consume);
+        pthread_mutex_unlock(&state->lock);
+
+        if(item == NULL)
+            break;
+    }
+
+    return NULL;
+}
+
+/**
+ * @internal
+ *
+ * Processes an item, with the lock held, and marks it as processed
+ */
+static void
+parallel_pipeline_process__(parallel_pipeline_state *state,
+                            size_t n)
+{
+    void *item = state->items[n % state->depth];
+
+    pthread_mutex_unlock(&state->lock);
+    state->process(state->arg, item);
+    pthread_mutex_lock(&state->lock);
+
+    state->processed[n % state->depth] = 1;
+
+    /* Only the next item to be consumed is waited for */
+    if(n == state->consumed)
+        pthread_cond_signal(&state->can_consume);
+}
+
+/**
+ * @internal
+ *
+ * Processing thread body: processes items as they are produced, until the
+ * source runs out
+ *
+ * @param arg Pointer to the parallel_pipeline_state
+ */
+static void*
+parallel_pipeline_worker__(void *arg)
+{
+    parallel_pipeline_state *state = arg;
+
+    pthread_mutex_lock(&state->lock);
+
+    for(;;) {
+        while(state->next == state->produced && !state->finished)
+            pthread_cond_wait(&state->can_process, &state->lock);
+
+        if(state->next == state->produced)
+            break;
+
+        parallel_pipeline_process__(state, state->next++);
+    }
+
+    pthread_mutex_unlock(&state->lock);
+
+    return NULL;
+}
+
+int
+parallel_pipeline(parallel_source source,
+                  parallel_stage process,
+                  parallel_stage consume,
+                  void *arg,
+                  unsigned int threads,
+                  size_t depth)
+{
+    parallel_pipeline_state state;
+    pthread_t reader, *workers = NULL;
+    unsigned int i, started = 0;
+    int ok;
+
+    if(depth == 0)
+        depth = 1;
+
+    state.source = source;
+    state.process = process;
+    state.consume = consume;
+    state.arg = arg;
+    state.depth = depth;
+    state.produced = state.next = state.consumed = 0;
+    state.finished = 0;
+    state.items = malloc(depth * sizeof(*state.items));
+    state.processed = malloc(depth);
+
+    if(state.items == NULL || state.processed == NULL) {
+        free(state.items);
+        free(state.processed);
+        state.items = NULL;
+        ok = 0;
+    } else {
+        pthread_mutex_init(&state.lock, NULL);
+        pthread_cond_init(&state.can_produce, NULL);
+        pthread_cond_init(&state.can_process, NULL);
+        pthread_cond_init(&state.can_consume, NULL);
+
+        ok = pthread_create(&reader, NULL, parallel_source__, &state) == 0;
+    }
+
+    if(!ok) {
+        void *item;
+
+        while((item = source(arg)) != NULL) {
+            process(arg, item);
+            consume(arg, item);
+        }
+
+        if(state.items != NULL) {
+            pthread_mutex_destroy(&state.lock);
+            pthread_cond_destroy(&state.can_produce);
+            pthread_cond_destroy(&state.can_process);
+            pthread_cond_destroy(&state.can_consume);
+            free(state.items);
+            free(state.processed);
+        }
+
+        return 0;
+    }
+
+    /* The calling thread processes items too, so one less thread is
+       started */
+    if(threads > 1) {
+        workers = malloc((threads - 1) * sizeof(*workers));
+        if(workers != NULL) {
+            for(started = 0; started < threads - 1; started++) {
+                if(pthread_create(&workers[started], NULL,
+                                  parallel_pipeline_worker__, &state) != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        ok = workers != NULL && started == threads - 1;
+    }
+
+    pthread_mutex_lock(&state.lock);
+
+    for(;;) {
+        size_t n = state.consumed;
+        void *item;
+
+        if(n == state.produced) {
+            if(state.finished)
+                break;
+
+            pthread_cond_wait(&state.can_consume, &state.lock);
+            continue;
+        }
+
+        /* Don't wait for an item no thread has picked up yet */
+        if(n == state.next)
+            parallel_pipeline_process__(&state, state.next++);
+
+        if(!state.processed[n % depth]) {
+            pthread_cond_wait(&state.can_consume, &state.lock);
+            continue;
+        }
+
+        item = state.items[n % depth];
+
+        pthread_mutex_unlock(&state.lock);
+        consume(arg, item);
+        pthread_mutex_lock(&state.lock);
+
+        state.consumed++;
+        pthread_cond_signal(&state.can_produce);
+    }
+
+    pthread_mutex_unlock(&state.lock);
+
+    pthread_join(reader, NULL);
+    for(i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    free(workers);
+    free(state.items);
+    free(state.processed);
+    pthread_mutex_destroy(&state.lock);
+    pthread_cond_destroy(&state.can_produce);
+    pthread_cond_destroy(&state.can_process);
+    pthread_cond_destroy(&state.can_consume);
+
+    return ok;
+}
+
+unsigned int
+parallel_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (unsigned int)count : 1;
+}
+
+#else /* HAVE_PTHREADS */
+
+int
+parallel_run(parallel_task task,
+             void *arg,
+             size_t count,
+             unsigned int threads)
+{
+    size_t i;
+
+    (void)threads;
+
+    for(i = 0; i < count; i++)
+        task(arg, i);
+
+    return 1;
+}
+
+int
+parallel_pipeline(parallel_source source,
+                  parallel_stage process,
+                  parallel_stage consume,
+                  void *arg,
+                  unsigned int threads,
+                  size_t depth)
+{
+    void *item;
+
+    (void)threads;
+    (void)depth;
+
+    while((item = source(arg)) != NULL) {
+        process(arg, item);
+        consume(arg, item);
+    }
+
+    return 1;
+}
+
+unsigned int
+parallel_cpu_count(void)
+{
+    return 1;
+}
+
+#endif /* HAVE_PTHREADS */
@@ -0,0 +1,103 @@
+/** @file parallel.h
+ *
+ * Minimal helpers for running independent tasks on multiple threads
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+/**
+ * Function run for each task
+ *
+ * @param arg   The argument given to parallel_run()
+ * @param index 0-based index of the task
+ */
+typedef void (*parallel_task)(void *arg,
+                              size_t index);
+
+/**
+ * Runs tasks 0 to count - 1, spreading them over up to a number of threads,
+ * and waits for all of them to finish. Threads pick the next pending task as
+ * soon as they are done with one, so tasks of uneven cost balance out.
+ *
+ * Without thread support (HAVE_PTHREADS not defined) the tasks run in order
+ * on the calling thread.
+ *
+ * @param task    Function to run for each task
+ * @param arg     Argument passed to every call of the function
+ * @param count   Number of tasks
+ * @param threads Maximum number of threads to use, including the calling one
+ *
+ * @returns 1 on success, 0 if the threads could not be started. The tasks
+ *          have all run in both cases.
+ */
+int
+parallel_run(parallel_task task,
+             void *arg,
+             size_t count,
+             unsigned int threads);
+
+/**
+ * Function producing the items of a pipeline, one per call
+ *
+ * @param arg The argument given to parallel_pipeline()
+ *
+ * @returns The next item, or NULL when there are no more
+ */
+typedef void* (*parallel_source)(void *arg);
+
+/**
+ * Function run on each item of a pipeline
+ *
+ * @param arg  The argument given to parallel_pipeline()
+ * @param item The item
+ */
+typedef void (*parallel_stage)(void *arg,
+                               void *item);
+
+/**
+ * Runs a three-stage pipeline: items are produced one at a time by a source,
+ * processed on multiple threads, and then consumed in the order they were
+ * produced.
+ *
+ * The source runs on a thread of its own, and may get up to depth items
+ * ahead of the consumer, which runs on the calling thread. Items are
+ * processed on up to a number of threads, the calling one included: when the
+ * next item to be consumed is still waiting to be processed, the calling
+ * thread processes it itself.
+ *
+ * Without thread support (HAVE_PTHREADS not defined) each item is produced,
+ * processed and consumed in turn on the calling thread.
+ *
+ * @param source  Function producing the items
+ * @param process Function processing each item. Calls may run concurrently.
+ * @param consume Function consuming each item, in order
+ * @param arg     Argument passed to every call of the functions
+ * @param threads Maximum number of threads to process items with
+ * @param depth   Maximum number of items produced but not yet consumed
+ *
+ * @returns 1 on success, 0 if the threads could not be started. All items
+ *          have been produced, processed and consumed in both cases.
+ */
+int
+parallel_pipeline(parallel_source source,
+                  parallel_stage process,
+                  parallel_stage consume,
+                  void *arg,
+                  unsigned int threads,
+                  size_t depth);
+
+/**
+ * Retrieves the number of processors available
+ *
+ * @returns The number of processors, at least 1
+ */
+unsigned int
+parallel_cpu_count(void);
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,154 @@
+/** @file region_features.c
+ *
+ * Per-region shape features, accumulated run by run during labeling
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include "bitmap.h"
+#include "region_features.h"
+
+/**
+ * @internal
+ *
+ * Sum of the squares of 0 to n, for n >= -1
+ */
+static double
+region_features_sum_squares__(double n)
+{
+    return n * (n + 1) * (2 * n + 1) / 6;
+}
+
+void
+region_features_init(region_features *features,
+                     const bitmap_run *run)
+{
+    features->first_x = run->x_start;
+    features->first_y = run->y;
+    features->x_min = features->x_max = run->x_start;
+    features->y_min = features->y_max = run->y;
+    features->area = 0;
+    features->perimeter = 0;
+    features->euler = 0;
+    features->sum_x = features->sum_y = 0;
+    features->sum_xx = features->sum_yy = features->sum_xy = 0;
+
+    region_features_add_run(features, run);
+}
+
+void
+region_features_add_run(region_features *features,
+                        const bitmap_run *run)
+{
+    double n = run->x_end - run->x_start,
+           y = run->y,
+           sum_x;
+
+    if(run->y < features->first_y
+       || (run->y == features->first_y && run->x_start < features->first_x))
+    {
+        features->first_x = run->x_start;
+        features->first_y = run->y;
+    }
+
+    if(run->x_start < features->x_min)
+        features->x_min = run->x_start;
+    if(run->x_end - 1 > features->x_max)
+        features->x_max = run->x_end - 1;
+    if(run->y < features->y_min)
+        features->y_min = run->y;
+    if(run->y > features->y_max)
+        features->y_max = run->y;
+
+    /* The sums over a run have closed forms, so the cost doesn't depend on
+       its length */
+    sum_x = n * (run->x_start + run->x_end - 1) / 2;
+
+    features->area += run->x_end - run->x_start;
+    features->sum_x += sum_x;
+    features->sum_y += n * y;
+    features->sum_xx += region_features_sum_squares__(run->x_end - 1)
+                        - region_features_sum_squares__(run->x_start - 1);
+    features->sum_yy += n * y * y;
+    features->sum_xy += sum_x * y;
+
+    /* Both ends, and the top and bottom of every point. Sides shared with
+       other runs are taken back by region_features_add_contact(). */
+    features->perimeter += 2 + 2 * (run->x_end - run->x_start);
+
+    /* Runs and the contacts between them form a graph with the same holes as
+       the region, one per independent cycle */
+    features->euler++;
+}
+
+void
+region_features_add_contact(region_features *features,
+                            size_t length)
+{
+    /* The perimeter may wrap around if the contact is accounted for before
+       the runs themselves, but unsigned arithmetic makes the final sum right
+       regardless */
+    features->perimeter -= 2 * length;
+    features->euler--;
+}
+
+void
+region_features_merge(region_features *dest,
+                      const region_features *src)
+{
+    if(src->first_y < dest->first_y
+       || (src->first_y == dest->first_y && src->first_x < dest->first_x))
+    {
+        dest->first_x = src->first_x;
+        dest->first_y = src->first_y;
+    }
+
+    if(src->x_min < dest->x_min)
+        dest->x_min = src->x_min;
+    if(src->x_max > dest->x_max)
+        dest->x_max = src->x_max;
+    if(src->y_min < dest->y_min)
+        dest->y_min = src->y_min;
+    if(src->y_max > dest->y_max)
+        dest->y_max = src->y_max;
+
+    dest->area += src->area;
+    dest->perimeter += src->perimeter;
+    dest->euler += src->euler;
+    dest->sum_x += src->sum_x;
+    dest->sum_y += src->sum_y;
+    dest->sum_xx += src->sum_xx;
+    dest->sum_yy += src->sum_yy;
+    dest->sum_xy += src->sum_xy;
+}
+
+size_t
+region_features_holes(const region_features *features)
+{
+    return (size_t)(1 - features->euler);
+}
+
+void
+region_features_centroid(const region_features *features,
+                         double *x,
+                         double *y)
+{
+    *x = features->sum_x / features->area;
+    *y = features->sum_y / features->area;
+}
+
+void
+region_features_moments(const region_features *features,
+                        double *mu20,
+                        double *mu02,
+                        double *mu11)
+{
+    double x, y;
+
+    region_features_centroid(features, &x, &y);
+
+    *mu20 = features->sum_xx / features->area - x * x;
+    *mu02 = features->sum_yy / features->area - y * y;
+    *mu11 = features->sum_xy / features->area - x * y;
+}
@@ -0,0 +1,140 @@
+/** @file region_features.h
+ *
+ * Per-region shape features, accumulated run by run during labeling
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef REGION_FEATURES_H
+#define REGION_FEATURES_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+
+/**
+ * Features of a region. Everything is kept as sums over the region's points,
+ * so the features of two parts of a region can simply be added together.
+ */
+typedef struct {
+    /** x-axis coordinate of the region's first point in row-major order */
+    int first_x;
+    /** y-axis coordinate of the region's first point in row-major order */
+    int first_y;
+    /** Smallest x-axis coordinate of the region's points */
+    int x_min;
+    /** Largest x-axis coordinate of the region's points */
+    int x_max;
+    /** Smallest y-axis coordinate of the region's points */
+    int y_min;
+    /** Largest y-axis coordinate of the region's points */
+    int y_max;
+    /** Number of points in the region */
+    size_t area;
+    /**
+     * Number of sides of the region's points that don't touch another point
+     * of the region, counting the sides around holes
+     */
+    size_t perimeter;
+    /**
+     * Number of runs minus the number of pairs of runs touching each other,
+     * which is the Euler number of the region: 1 minus its number of holes
+     */
+    long euler;
+    /** Sum of the x-axis coordinates of the points */
+    double sum_x;
+    /** Sum of the y-axis coordinates of the points */
+    double sum_y;
+    /** Sum of the squares of the x-axis coordinates of the points */
+    double sum_xx;
+    /** Sum of the squares of the y-axis coordinates of the points */
+    double sum_yy;
+    /** Sum of the products of both coordinates of the points */
+    double sum_xy;
+} region_features;
+
+/**
+ * Sets the features of a region to those of a single run
+ *
+ * @param features The features to set
+ * @param run      The run
+ */
+void
+region_features_init(region_features *features,
+                     const bitmap_run *run);
+
+/**
+ * Adds a run to the features of a region. The run must not touch any other
+ * run already added: see region_features_add_contact().
+ *
+ * @param features The features to update
+ * @param run      The run to add
+ */
+void
+region_features_add_run(region_features *features,
+                        const bitmap_run *run);
+
+/**
+ * Accounts for two runs of a region in consecutive rows touching each other,
+ * which removes the sides they share from the perimeter. Must be called once
+ * for every such pair, including runs touching only diagonally.
+ *
+ * @param features The features to update
+ * @param length   Number of points over which the runs touch, 0 if they only
+ *                 touch diagonally
+ */
+void
+region_features_add_contact(region_features *features,
+                            size_t length);
+
+/**
+ * Adds the features of a part of a region to those of another part
+ *
+ * @param dest The features to update
+ * @param src  The features to add
+ */
+void
+region_features_merge(region_features *dest,
+                      const region_features *src);
+
+/**
+ * Computes the number of holes of a region: the connected regions of unset
+ * points, or of points of other regions, that it surrounds. Holes are
+ * 8-connected if the region is 4-connected, and 4-connected otherwise.
+ *
+ * @param features The region's features
+ *
+ * @returns The number of holes
+ */
+size_t
+region_features_holes(const region_features *features);
+
+/**
+ * Computes the centroid of a region
+ *
+ * @param features The region's features
+ * @param x        Receives the x-axis coordinate of the centroid
+ * @param y        Receives the y-axis coordinate of the centroid
+ */
+void
+region_features_centroid(const region_features *features,
+                         double *x,
+                         double *y);
+
+/**
+ * Computes the second-order central moments of a region, normalized by its
+ * area: the variances of the coordinates and their covariance
+ *
+ * @param features The region's features
+ * @param mu20     Receives the variance of the x-axis coordinates
+ * @param mu02     Receives the variance of the y-axis coordinates
+ * @param mu11     Receives the covariance of the coordinates
+ */
+void
+region_features_moments(const region_features *features,
+                        double *mu20,
+                        double *mu02,
+                        double *mu11);
+
+#endif /* REGION_FEATURES_H */
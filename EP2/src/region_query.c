@@ -0,0 +1,249 @@
+/** @file region_query.c
+ *
+ * Queries for the regions of a bitmap that pass a size filter, or the
+ * largest ones, without building the regions left out
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+
+#include "bitmap.h"
+#include "bitmap_runs.h"
+#include "region_query.h"
+
+/**
+ * @internal
+ *
+ * Whether region a ranks below region b: it is smaller, or as large and found
+ * later
+ */
+#define region_query_below__(areas, a, b) \
+    ((areas)[a] < (areas)[b] || ((areas)[a] == (areas)[b] && (a) > (b)))
+
+/**
+ * @internal
+ *
+ * Moves the region at a position of a heap down until no region below it
+ * ranks lower. The lowest ranked region of the heap is at its top.
+ */
+static void
+region_query_sift_down__(region_label *heap,
+                         size_t count,
+                         size_t pos,
+                         const size_t *areas)
+{
+    for(;;) {
+        size_t low = pos,
+               child = 2 * pos + 1;
+
+        if(child < count && region_query_below__(areas, heap[child],
+                                                 heap[low]))
+        {
+            low = child;
+        }
+        if(child + 1 < count && region_query_below__(areas, heap[child + 1],
+                                                     heap[low]))
+        {
+            low = child + 1;
+        }
+
+        if(low == pos)
+            break;
+
+        {
+            region_label swap = heap[pos];
+            heap[pos] = heap[low];
+            heap[low] = swap;
+        }
+
+        pos = low;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Picks the regions a query keeps, in the order they are to be listed
+ *
+ * @param areas        Area of each region, the one with label l at l
+ * @param region_count Number of regions
+ * @param query        Which regions to keep
+ * @param kept         Array of room for at least min(top_k, region_count)
+ *                     labels, receiving the labels of the regions kept
+ *
+ * @returns The number of regions kept
+ */
+static size_t
+region_query_select__(const size_t *areas,
+                      region_label region_count,
+                      const region_query *query,
+                      region_label *kept)
+{
+    size_t count = 0, i;
+    region_label label;
+
+    if(query->top_k == 0) {
+        for(label = 1; label <= region_count; label++) {
+            if(query->max_count != 0 && count == query->max_count)
+                break;
+
+            if(areas[label] >= query->min_area)
+                kept[count++] = label;
+        }
+
+        return count;
+    }
+
+    /* Keep the top_k largest regions seen so far in a heap, with the
+       smallest of them on top, to be replaced by any larger one */
+    for(label = 1; label <= region_count; label++) {
+        if(areas[label] < query->min_area)
+            continue;
+
+        if(count < query->top_k) {
+            size_t pos = count++;
+
+            kept[pos] = label;
+            while(pos > 0
+                  && region_query_below__(areas, kept[pos],
+                                          kept[(pos - 1) / 2]))
+            {
+                region_label swap = kept[pos];
+                kept[pos] = kept[(pos - 1) / 2];
+                kept[(pos - 1) / 2] = swap;
+
+                pos = (pos - 1) / 2;
+            }
+        } else if(region_query_below__(areas, kept[0], label)) {
+            kept[0] = label;
+            region_query_sift_down__(kept, count, 0, areas);
+        }
+    }
+
+    /* Taking the smallest off the top, one at a time, and placing each
+       after the ones left leaves the largest first */
+    for(i = count; i > 1; i--) {
+        region_label swap = kept[0];
+        kept[0] = kept[i - 1];
+        kept[i - 1] = swap;
+
+        region_query_sift_down__(kept, i - 1, 0, areas);
+    }
+
+    if(query->max_count != 0 && count > query->max_count)
+        count = query->max_count;
+
+    return count;
+}
+
+bitmap_region_list*
+bitmap_query_run_regions(const bitmap *map,
+                         bitmap_connectivity connectivity,
+                         const region_query *query)
+{
+    if(map == NULL || map->data == NULL)
+        return NULL;
+
+    return bitmap_query_source_run_regions(map, map->width, map->height,
+                                           bitmap_source_row_runs,
+                                           connectivity, query);
+}
+
+bitmap_region_list*
+bitmap_query_source_run_regions(const void *source,
+                                int width,
+                                int height,
+                                bitmap_row_runs_func row_runs,
+                                bitmap_connectivity connectivity,
+                                const region_query *query)
+{
+    bitmap_run_scan scan;
+    bitmap_region_list *result = NULL;
+    region_label *kept = NULL, *slots = NULL;
+    size_t *areas = NULL, *offsets = NULL;
+    size_t kept_count, kept_runs = 0, kept_capacity, i;
+    region_label region_count;
+
+    (void)width;
+
+    if(source == NULL || query == NULL || !bitmap_run_scan_init(&scan, 0))
+        return NULL;
+
+    if(!bitmap_run_scan_source(&scan, source, height, row_runs, connectivity,
+                               &region_count))
+    {
+        goto error;
+    }
+
+    kept_capacity = region_count;
+    if(query->top_k != 0 && query->top_k < kept_capacity)
+        kept_capacity = query->top_k;
+
+    areas = calloc((size_t)region_count + 1, sizeof(*areas));
+    kept = malloc((kept_capacity + 1) * sizeof(*kept));
+    slots = calloc((size_t)region_count + 1, sizeof(*slots));
+    if(areas == NULL || kept == NULL || slots == NULL)
+        goto error;
+
+    for(i = 0; i < scan.run_count; i++)
+        areas[bitmap_run_scan_region(&scan, i)] += scan.runs[i].x_end
+                                                   - scan.runs[i].x_start;
+
+    kept_count = region_query_select__(areas, region_count, query, kept);
+
+    /* Position of each region kept in the list, starting from 1 */
+    for(i = 0; i < kept_count; i++)
+        slots[kept[i]] = (region_label)(i + 1);
+
+    offsets = calloc(kept_count + 1, sizeof(*offsets));
+    if(offsets == NULL)
+        goto error;
+
+    for(i = 0; i < scan.run_count; i++) {
+        region_label slot = slots[bitmap_run_scan_region(&scan, i)];
+
+        if(slot != 0) {
+            offsets[slot]++;
+            kept_runs++;
+        }
+    }
+
+    result = bitmap_region_list_alloc(kept_count, kept_runs);
+    if(result == NULL)
+        goto error;
+
+    for(i = 0; i < kept_count; i++) {
+        result->regions[i].runs = result->runs + offsets[i];
+        result->regions[i].run_count = offsets[i + 1];
+        result->regions[i].area = areas[kept[i]];
+        offsets[i + 1] += offsets[i];
+    }
+
+    /* Only the runs of the regions kept are copied */
+    for(i = 0; i < scan.run_count; i++) {
+        region_label slot = slots[bitmap_run_scan_region(&scan, i)];
+
+        if(slot != 0)
+            result->runs[offsets[slot - 1]++] = scan.runs[i];
+    }
+
+    free(offsets);
+    free(slots);
+    free(kept);
+    free(areas);
+    bitmap_run_scan_free(&scan);
+
+    return result;
+
+error:
+    bitmap_region_list_free(result);
+    free(offsets);
+    free(slots);
+    free(kept);
+    free(areas);
+    bitmap_run_scan_free(&scan);
+
+    return NULL;
+}
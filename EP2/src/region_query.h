@@ -0,0 +1,78 @@
+/** @file region_query.h
+ *
+ * Queries for the regions of a bitmap that pass a size filter, or the
+ * largest ones, without building the regions left out
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef REGION_QUERY_H
+#define REGION_QUERY_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+#include "bitmap_runs.h"
+
+/** Which regions of a bitmap a query keeps */
+typedef struct {
+    /** Smallest number of points of the regions kept. 0 keeps all of them. */
+    size_t min_area;
+    /**
+     * If not 0, only this many of the largest regions are kept, the largest
+     * first. Regions of the same size are kept in the order they were found.
+     */
+    size_t top_k;
+    /**
+     * If not 0, at most this many regions are kept: the first ones found, or
+     * the largest ones with top_k
+     */
+    size_t max_count;
+} region_query;
+
+/**
+ * Retrieves the connected regions of a bitmap that a query keeps.
+ *
+ * Regions are labeled by runs with the same scan as
+ * bitmap_find_all_run_regions(), and their areas added up from their runs.
+ * Only the regions kept are built afterwards, so small specks of noise never
+ * reach the list. The largest regions are picked with a heap of at most
+ * top_k regions.
+ *
+ * Without top_k, regions are ordered as in bitmap_find_all_regions().
+ *
+ * @param map          The bitmap to use. It is not modified.
+ * @param connectivity Connectivity of the regions
+ * @param query        Which regions to keep
+ *
+ * @returns The list of the regions kept, or NULL on error
+ */
+bitmap_region_list*
+bitmap_query_run_regions(const bitmap *map,
+                         bitmap_connectivity connectivity,
+                         const region_query *query);
+
+/**
+ * Retrieves the connected regions that a query keeps of any source of points
+ * that can produce runs one row at a time, in the same way as
+ * bitmap_query_run_regions(). Rows are asked for once each, in order.
+ *
+ * @param source       The source of points, passed on to row_runs
+ * @param width        Width of the source
+ * @param height       Height of the source
+ * @param row_runs     Function producing the runs of each row of the source
+ * @param connectivity Connectivity of the regions
+ * @param query        Which regions to keep
+ *
+ * @returns The list of the regions kept, or NULL on error
+ */
+bitmap_region_list*
+bitmap_query_source_run_regions(const void *source,
+                                int width,
+                                int height,
+                                bitmap_row_runs_func row_runs,
+                                bitmap_connectivity connectivity,
+                                const region_query *query);
+
+#endif /* REGION_QUERY_H */
@@ -0,0 +1,140 @@
+/** @file regions_ctx.c
+ *
+ * Reusable labeling context, for labeling many bitmaps one after the other
+ * without allocating memory for each of them
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+
+#include "bitmap.h"
+#include "bitmap_runs.h"
+#include "union_find.h"
+#include "regions_ctx.h"
+
+regions_ctx*
+regions_ctx_new(void)
+{
+    regions_ctx *ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL)
+        return NULL;
+
+    if(!bitmap_run_scan_init(&ctx->scan, 0)) {
+        free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+void
+regions_ctx_free(regions_ctx *ctx)
+{
+    if(ctx != NULL) {
+        bitmap_run_scan_free(&ctx->scan);
+        free(ctx->offsets);
+        free(ctx->list.regions);
+        free(ctx->list.runs);
+        free(ctx);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Grows an array of a context to hold at least a number of elements, at
+ * least doubling it so that growing it one bitmap at a time stays cheap
+ *
+ * @param array    The array, or NULL if it has no room yet
+ * @param capacity Pointer to the number of elements it has room for
+ * @param needed   Number of elements it needs room for
+ * @param size     Size of each element
+ *
+ * @returns The array, moved if it had to grow, or NULL on memory allocation
+ *          failure, in which case the array is left untouched
+ */
+static void*
+regions_ctx_reserve__(void *array,
+                      size_t *capacity,
+                      size_t needed,
+                      size_t size)
+{
+    size_t new_capacity;
+    void *new_array;
+
+    if(array != NULL && needed <= *capacity)
+        return array;
+
+    new_capacity = (*capacity != 0) ? *capacity * 2 : 64;
+    if(new_capacity < needed)
+        new_capacity = needed;
+
+    new_array = realloc(array, new_capacity * size);
+    if(new_array != NULL)
+        *capacity = new_capacity;
+
+    return new_array;
+}
+
+const bitmap_region_list*
+regions_ctx_find(regions_ctx *ctx,
+                 const bitmap *map,
+                 bitmap_connectivity connectivity)
+{
+    if(map == NULL || map->data == NULL)
+        return NULL;
+
+    return regions_ctx_find_source(ctx, map, map->width, map->height,
+                                   bitmap_source_row_runs, connectivity);
+}
+
+const bitmap_region_list*
+regions_ctx_find_source(regions_ctx *ctx,
+                        const void *source,
+                        int width,
+                        int height,
+                        bitmap_row_runs_func row_runs,
+                        bitmap_connectivity connectivity)
+{
+    bitmap_region_list *list;
+    void *grown;
+    region_label region_count;
+
+    (void)width;
+
+    if(ctx == NULL || source == NULL)
+        return NULL;
+
+    if(!bitmap_run_scan_source(&ctx->scan, source, height, row_runs,
+                               connectivity, &region_count))
+    {
+        return NULL;
+    }
+
+    list = &ctx->list;
+
+    grown = regions_ctx_reserve__(list->regions, &ctx->region_capacity,
+                                  region_count, sizeof(*list->regions));
+    if(grown == NULL)
+        return NULL;
+    list->regions = grown;
+
+    grown = regions_ctx_reserve__(list->runs, &ctx->list_run_capacity,
+                                  ctx->scan.run_count, sizeof(*list->runs));
+    if(grown == NULL)
+        return NULL;
+    list->runs = grown;
+
+    grown = regions_ctx_reserve__(ctx->offsets, &ctx->offset_capacity,
+                                  (size_t)region_count + 1,
+                                  sizeof(*ctx->offsets));
+    if(grown == NULL)
+        return NULL;
+    ctx->offsets = grown;
+
+    bitmap_run_scan_regions(&ctx->scan, region_count, list, ctx->offsets);
+
+    return list;
+}
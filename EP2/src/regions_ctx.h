@@ -0,0 +1,98 @@
+/** @file regions_ctx.h
+ *
+ * Reusable labeling context, for labeling many bitmaps one after the other
+ * without allocating memory for each of them
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef REGIONS_CTX_H
+#define REGIONS_CTX_H
+
+#include <stddef.h>
+
+#include "bitmap.h"
+#include "bitmap_runs.h"
+#include "union_find.h"
+
+/**
+ * Labeling context: the scratch memory run-based labeling needs, and the
+ * regions found in the last bitmap labeled.
+ *
+ * Every array only ever grows, to fit the largest bitmap labeled so far, so
+ * once a context has labeled a bitmap, labeling another one with no more
+ * runs or regions doesn't allocate any memory.
+ */
+typedef struct {
+    /** Runs of the last bitmap labeled, and their regions */
+    bitmap_run_scan scan;
+    /** Position of the next run of each region, while grouping the runs */
+    size_t *offsets;
+    /** Number of positions the offsets array has room for */
+    size_t offset_capacity;
+    /** The regions found in the last bitmap labeled */
+    bitmap_region_list list;
+    /** Number of regions the list has room for */
+    size_t region_capacity;
+    /** Number of runs the list has room for */
+    size_t list_run_capacity;
+} regions_ctx;
+
+/**
+ * Creates a new labeling context, with no memory reserved yet
+ *
+ * @returns The new context, or NULL on memory allocation failure
+ */
+regions_ctx*
+regions_ctx_new(void);
+
+/**
+ * Frees a labeling context and all of its memory, including the regions
+ * it found
+ *
+ * @param ctx A context to free
+ */
+void
+regions_ctx_free(regions_ctx *ctx);
+
+/**
+ * Retrieves all the connected regions of a bitmap, in the same way as
+ * bitmap_find_all_run_regions(), but in the memory of a context.
+ *
+ * @param ctx          The context to use
+ * @param map          The bitmap to use. It is not modified.
+ * @param connectivity Connectivity of the regions
+ *
+ * @returns The list of regions, owned by the context and valid until it
+ *          labels something else or is freed, or NULL on error
+ */
+const bitmap_region_list*
+regions_ctx_find(regions_ctx *ctx,
+                 const bitmap *map,
+                 bitmap_connectivity connectivity);
+
+/**
+ * Retrieves all the connected regions of any source of points that can
+ * produce runs one row at a time, in the same way as
+ * bitmap_find_all_source_run_regions(), but in the memory of a context.
+ *
+ * @param ctx          The context to use
+ * @param source       The source of points, passed on to row_runs
+ * @param width        Width of the source
+ * @param height       Height of the source
+ * @param row_runs     Function producing the runs of each row of the source
+ * @param connectivity Connectivity of the regions
+ *
+ * @returns The list of regions, owned by the context and valid until it
+ *          labels something else or is freed, or NULL on error
+ */
+const bitmap_region_list*
+regions_ctx_find_source(regions_ctx *ctx,
+                        const void *source,
+                        int width,
+                        int height,
+                        bitmap_row_runs_func row_runs,
+                        bitmap_connectivity connectivity);
+
+#endif /* REGIONS_CTX_H */
@@ -0,0 +1,129 @@
+/** @file union_find.c
+ *
+ * Flat-array union-find (disjoint set forest) over region labels
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#include <stdlib.h>
+
+#include "union_find.h"
+
+int
+union_find_init(union_find *uf,
+                region_label capacity)
+{
+    if(uf == NULL)
+        return 0;
+
+    if(capacity < 2)
+        capacity = 2;
+
+    uf->parent = malloc(capacity * sizeof(*uf->parent));
+    if(uf->parent == NULL)
+        return 0;
+
+    uf->parent[0] = 0;
+    uf->count = 1;
+    uf->capacity = capacity;
+
+    return 1;
+}
+
+void
+union_find_free(union_find *uf)
+{
+    if(uf != NULL) {
+        free(uf->parent);
+
+        uf->parent = NULL;
+        uf->count = uf->capacity = 0;
+    }
+}
+
+void
+union_find_clear(union_find *uf)
+{
+    uf->count = 1;
+}
+
+region_label
+union_find_make_set(union_find *uf)
+{
+    region_label label;
+
+    if(uf->count == uf->capacity) {
+        region_label new_capacity = uf->capacity * 2;
+        region_label *new_parent;
+
+        /* Labels are unsigned: running out of them wraps around */
+        if(new_capacity <= uf->capacity)
+            return 0;
+
+        new_parent = realloc(uf->parent, new_capacity * sizeof(*new_parent));
+        if(new_parent == NULL)
+            return 0;
+
+        uf->parent = new_parent;
+        uf->capacity = new_capacity;
+    }
+
+    label = uf->count++;
+    uf->parent[label] = label;
+
+    return label;
+}
+
+region_label
+union_find_find(union_find *uf,
+                region_label label)
+{
+    region_label root = label, next;
+
+    while(uf->parent[root] != root)
+        root = uf->parent[root];
+
+    /* Point every label on the way directly at the root */
+    while(uf->parent[label] != root) {
+        next = uf->parent[label];
+        uf->parent[label] = root;
+        label = next;
+    }
+
+    return root;
+}
+
+region_label
+union_find_union(union_find *uf,
+                 region_label a,
+                 region_label b)
+{
+    a = union_find_find(uf, a);
+    b = union_find_find(uf, b);
+
+    if(a < b) {
+        uf->parent[b] = a;
+        return a;
+    }
+
+    uf->parent[a] = b;
+    return b;
+}
+
+region_label
+union_find_flatten(union_find *uf)
+{
+    region_label label, sets = 0;
+
+    /* Parents always come before their children, so by the time a label is
+       visited its parent already holds a final label. */
+    for(label = 1; label < uf->count; label++) {
+        if(uf->parent[label] == label)
+            uf->parent[label] = ++sets;
+        else
+            uf->parent[label] = uf->parent[uf->parent[label]];
+    }
+
+    return sets;
+}
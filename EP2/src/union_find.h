@@ -0,0 +1,113 @@
+/** @file union_find.h
+ *
+ * Flat-array union-find (disjoint set forest) over region labels
+ *
+ * @author Daniel Miranda (No. USP: 7577406) <danielkza2@gmail.com>
+ *         Exerccio-Programa 2 - MAC0122 - IME-USP - 2011
+ */
+
+#ifndef UNION_FIND_H
+#define UNION_FIND_H
+
+#include <stddef.h>
+
+/** Type of a region label. Label 0 is reserved for the background. */
+typedef unsigned int region_label;
+
+/**
+ * Disjoint set forest stored as a single array of parents. A label is the
+ * root of its set when it is its own parent.
+ *
+ * Sets are always merged under the smaller of the two roots, so the root of
+ * a set is its smallest label and parent[i] <= i holds for every label.
+ */
+typedef struct {
+    /** Parent of each label. parent[0] is the background. */
+    region_label *parent;
+    /** Number of labels in use, including the background */
+    region_label count;
+    /** Number of labels the parent array has room for */
+    region_label capacity;
+} union_find;
+
+/**
+ * Initializes an empty union-find, holding only the background label
+ *
+ * @param uf       The union-find to initialize
+ * @param capacity Number of labels to reserve room for. The array grows as
+ *                 needed past it.
+ *
+ * @returns 1 on success, 0 on memory allocation failure
+ */
+int
+union_find_init(union_find *uf,
+                region_label capacity);
+
+/**
+ * Frees the memory used by a union-find
+ *
+ * @param uf The union-find to free
+ */
+void
+union_find_free(union_find *uf);
+
+/**
+ * Removes every label from a union-find, keeping its memory for reuse
+ *
+ * @param uf The union-find to clear
+ */
+void
+union_find_clear(union_find *uf);
+
+/**
+ * Creates a new singleton set
+ *
+ * @param uf The union-find to use
+ *
+ * @returns The new label, or 0 on memory allocation failure
+ */
+region_label
+union_find_make_set(union_find *uf);
+
+/**
+ * Finds the root of the set containing a label, compressing the path to it
+ *
+ * @param uf    The union-find to use
+ * @param label A label in use
+ *
+ * @returns The root label
+ */
+region_label
+union_find_find(union_find *uf,
+                region_label label);
+
+/**
+ * Merges the sets containing two labels
+ *
+ * @param uf The union-find to use
+ * @param a  A label in use
+ * @param b  Another label in use
+ *
+ * @returns The root of the merged set, the smaller of both roots
+ */
+region_label
+union_find_union(union_find *uf,
+                 region_label a,
+                 region_label b);
+
+/**
+ * Replaces every parent by a final, consecutive label starting at 1 for its
+ * set. Final labels are given out in the order of the sets' roots, so the set
+ * whose smallest label is lowest gets label 1.
+ *
+ * After this call parent[label] holds the final label of any label, and the
+ * union-find must not be used for further unions.
+ *
+ * @param uf The union-find to use
+ *
+ * @returns The number of sets, not counting the background
+ */
+region_label
+union_find_flatten(union_find *uf);
+
+#endif /* UNION_FIND_H */